@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "tas_semaphore.h"
+
+#define THREADS 10
+#define TIMES 5000
+#define POOL 8
+
+struct args
+{
+    semaphore *sem;
+    int want;
+};
+
+// Bulk version of up_down_atomicity: one signal_n and one wait_n instead of 5000 each
+void *up_down(void *arg)
+{
+    struct args *args = (struct args*)arg;
+    semaphore_signal_n(args->sem, TIMES);
+    semaphore_wait_n(args->sem, TIMES);
+    return NULL;
+}
+
+// Threads needing different amounts of a small pool; partial acquires would deadlock here
+void *reserve(void *arg)
+{
+    struct args *args = (struct args*)arg;
+    for(int i = 0; i < TIMES; i++)
+    {
+        semaphore_wait_n(args->sem, args->want);
+        semaphore_signal_n(args->sem, args->want);
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    semaphore sem;
+    pthread_t threads[THREADS];
+    struct args args[THREADS];
+
+    semaphore_init(&sem, 0);
+    for(int i = 0; i < THREADS; i++)
+    {
+        args[i].sem = &sem;
+        pthread_create(&threads[i], NULL, up_down, (void*)&args[i]);
+    }
+    for(int i = 0; i < THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    if(semaphore_try_wait_n(&sem, 1))
+    {
+        fprintf(stderr, "semaphore_batch_up_down: permits left over\n");
+        return 1;
+    }
+
+    semaphore_init(&sem, POOL);
+    for(int i = 0; i < THREADS; i++)
+    {
+        args[i].sem = &sem;
+        args[i].want = 1 + i % POOL;
+        pthread_create(&threads[i], NULL, reserve, (void*)&args[i]);
+    }
+    for(int i = 0; i < THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // the whole pool must be back, and not a permit more
+    if(!semaphore_try_wait_n(&sem, POOL) || semaphore_try_wait_n(&sem, 1))
+    {
+        fprintf(stderr, "semaphore_batch_pool: wrong number of permits\n");
+        return 1;
+    }
+    printf("good\n");
+    return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * async_wait_bench.c
+ *
+ * Waiting on many semaphores at once: one blocked thread per semaphore versus a single
+ * event-loop thread using the async waiters.
+ *
+ * 'signalers' threads signal the 'sems' semaphores round-robin, 'signals' permits in total.
+ * Every permit is consumed exactly once by the waiting side, which is checked at the end.
+ * One CSV row is printed per method:
+ *
+ *   method,sems,signalers,signals,waiting_threads,seconds,signals_per_sec
+ *
+ * Methods:
+ *   threads   one thread per semaphore, blocking in semaphore_wait
+ *   epoll     one thread, one eventfd waiter per semaphore, all in one epoll set
+ *   callback  no waiting thread at all: each completion callback re-arms its waiter
+ *
+ * Build: gcc -O2 -pthread -I../task2 async_wait_bench.c ../task2/tl_semaphore.c
+ *            ../common/async_wait.c ../common/wait_policy.c -o async_wait_bench
+ * Usage: async_wait_bench [sems=256] [signalers=2] [signals=1000000]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "tl_semaphore.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum { M_THREADS, M_EPOLL, M_CALLBACK, M_COUNT } method_t;
+
+static const char* method_names[M_COUNT] = { "threads", "epoll", "callback" };
+
+typedef struct {
+    semaphore sem;
+    async_waiter waiter;
+    long quota;                 // permits this semaphore receives in total
+} target;
+
+static target* g_targets;
+static int g_sems;
+static int g_signalers;
+static long g_signals;
+static atomic_long g_consumed;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Signaler 'id' signals semaphores id, id + signalers, ... over and over
+static void* signaler(void* arg) {
+    long id = (long)arg;
+    long mine = g_signals / g_signalers + (id < g_signals % g_signalers);
+    int s = (int)(id % g_sems);
+    for (long i = 0; i < mine; i++) {
+        semaphore_signal(&g_targets[s].sem);
+        s = (s + g_signalers) % g_sems;
+    }
+    return NULL;
+}
+
+static void* blocking_waiter(void* arg) {
+    target* t = arg;
+    for (long i = 0; i < t->quota; i++) {
+        semaphore_wait(&t->sem);
+    }
+    atomic_fetch_add(&g_consumed, t->quota);
+    return NULL;
+}
+
+// Takes every permit that is available right away and leaves the waiter queued
+static long rearm(target* t) {
+    long taken = 0;
+    while (semaphore_wait_async(&t->sem, &t->waiter, 1) == 1) {
+        taken++;
+    }
+    return taken;
+}
+
+static void on_permit(void* arg) {
+    target* t = arg;
+    atomic_fetch_add(&g_consumed, 1 + rearm(t));
+}
+
+// The event loop: waits for any eventfd, consumes its completion and re-arms it
+static void* epoll_loop(void* arg) {
+    int epfd = *(int*)arg;
+    struct epoll_event events[64];
+    while (atomic_load(&g_consumed) < g_signals) {
+        int n = epoll_wait(epfd, events, 64, 100);
+        for (int i = 0; i < n; i++) {
+            target* t = events[i].data.ptr;
+            if (async_waiter_consume(&t->waiter)) {
+                atomic_fetch_add(&g_consumed, 1 + rearm(t));
+            }
+        }
+    }
+    return NULL;
+}
+
+static void run(method_t method) {
+    g_targets = malloc(sizeof(target) * g_sems);
+    pthread_t* waiters = malloc(sizeof(pthread_t) * g_sems);
+    pthread_t* signalers = malloc(sizeof(pthread_t) * g_signalers);
+    if (g_targets == NULL || waiters == NULL || signalers == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the benchmark\n");
+        exit(1);
+    }
+    atomic_store(&g_consumed, 0);
+
+    int epfd = -1;
+    if (method == M_EPOLL && (epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        perror("epoll_create1");
+        exit(1);
+    }
+    for (int s = 0; s < g_sems; s++) {
+        target* t = &g_targets[s];
+        semaphore_init(&t->sem, 0);
+        t->quota = 0;
+        if (method == M_EPOLL) {
+            int fd = async_waiter_init_eventfd(&t->waiter);
+            struct epoll_event ev = { .events = EPOLLIN, .data.ptr = t };
+            if (fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+                perror("eventfd");
+                exit(1);
+            }
+        } else {
+            async_waiter_init_callback(&t->waiter, method == M_CALLBACK ? on_permit : NULL, t);
+        }
+    }
+    // Replay the signalers' round-robin to know how many permits each semaphore gets
+    for (long id = 0; id < g_signalers; id++) {
+        long mine = g_signals / g_signalers + (id < g_signals % g_signalers);
+        int s = (int)(id % g_sems);
+        for (long i = 0; i < mine; i++) {
+            g_targets[s].quota++;
+            s = (s + g_signalers) % g_sems;
+        }
+    }
+
+    double start = now_sec();
+    int waiting_threads = 0;
+    if (method == M_THREADS) {
+        for (int s = 0; s < g_sems; s++) {
+            if (pthread_create(&waiters[s], NULL, blocking_waiter, &g_targets[s]) != 0) {
+                fprintf(stderr, "Error creating waiter thread %d\n", s);
+                exit(1);
+            }
+        }
+        waiting_threads = g_sems;
+    } else {
+        for (int s = 0; s < g_sems; s++) {
+            atomic_fetch_add(&g_consumed, rearm(&g_targets[s]));
+        }
+        if (method == M_EPOLL) {
+            if (pthread_create(&waiters[0], NULL, epoll_loop, &epfd) != 0) {
+                fprintf(stderr, "Error creating the event loop thread\n");
+                exit(1);
+            }
+            waiting_threads = 1;
+        }
+    }
+    for (long id = 0; id < g_signalers; id++) {
+        if (pthread_create(&signalers[id], NULL, signaler, (void*)id) != 0) {
+            fprintf(stderr, "Error creating signaler thread %ld\n", id);
+            exit(1);
+        }
+    }
+    for (int id = 0; id < g_signalers; id++) {
+        pthread_join(signalers[id], NULL);
+    }
+    for (int w = 0; w < waiting_threads; w++) {
+        pthread_join(waiters[w], NULL);
+    }
+    double elapsed = now_sec() - start;
+
+    // Every permit must have been consumed, and none may be left behind
+    long leftover = 0;
+    for (int s = 0; s < g_sems; s++) {
+        target* t = &g_targets[s];
+        if (method != M_THREADS && !semaphore_cancel_async(&t->sem, &t->waiter)) {
+            leftover++;
+        }
+        leftover += atomic_load(&t->sem.value);
+        async_waiter_destroy(&t->waiter);
+    }
+    if (atomic_load(&g_consumed) != g_signals || leftover != 0) {
+        fprintf(stderr, "%s: consumed %ld of %ld permits, %ld left over\n", method_names[method],
+                atomic_load(&g_consumed), g_signals, leftover);
+        exit(1);
+    }
+
+    printf("%s,%d,%d,%ld,%d,%.3f,%.0f\n", method_names[method], g_sems, g_signalers, g_signals,
+           waiting_threads, elapsed, g_signals / elapsed);
+    fflush(stdout);
+
+    if (epfd >= 0) {
+        close(epfd);
+    }
+    free(g_targets);
+    free(waiters);
+    free(signalers);
+}
+
+int main(int argc, char* argv[]) {
+    g_sems = argc > 1 ? atoi(argv[1]) : 256;
+    g_signalers = argc > 2 ? atoi(argv[2]) : 2;
+    g_signals = argc > 3 ? atol(argv[3]) : 1000000;
+    if (g_sems <= 0 || g_signalers <= 0 || g_signals <= 0) {
+        fprintf(stderr, "Usage: %s [sems=256] [signalers=2] [signals=1000000]\n", argv[0]);
+        return 1;
+    }
+
+    printf("method,sems,signalers,signals,waiting_threads,seconds,signals_per_sec\n");
+    for (int m = 0; m < M_COUNT; m++) {
+        run((method_t)m);
+    }
+    return 0;
+}
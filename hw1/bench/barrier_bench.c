@@ -0,0 +1,155 @@
+/*
+ * barrier_bench.c
+ *
+ * Per-phase latency benchmark for the task3 barriers.
+ *
+ * For every thread count (2, 4, 8, ... up to the maximum) each barrier runs a fixed number of
+ * back-to-back phases and the average wall-clock time per phase is reported as CSV:
+ *
+ *   barrier,threads,phases,ns_per_phase
+ *
+ * The "cv_broadcast" row is the improvised barrier built from condition_variable_broadcast that
+ * the sense-reversing and dissemination barriers are meant to replace.
+ *
+ * Build: gcc -O2 -pthread -I../task3 barrier_bench.c ../task3/barrier.c ../task3/cond_var.c \
+ *            ../common/wait_policy.c ../common/async_wait.c -o barrier_bench
+ * Usage: barrier_bench [max_threads=128] [phases=1000]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "barrier.h"
+#include "cond_var.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef enum { BENCH_CV_BROADCAST, BENCH_SENSE, BENCH_DISSEMINATION } barrier_kind;
+
+static const char* kind_names[] = { "cv_broadcast", "sense", "dissemination" };
+
+// Improvised barrier: generation counter protected by a ticket lock plus a broadcast
+typedef struct {
+    ticket_lock lock;
+    condition_variable cv;
+    int arrived;
+    int generation;
+    int parties;
+} cv_barrier;
+
+static cv_barrier g_cv_barrier;
+static sense_barrier g_sense_barrier;
+static dissemination_barrier g_diss_barrier;
+static countdown_latch g_start_latch;
+static int g_phases;
+static double g_start_ns;
+
+struct args {
+    barrier_kind kind;
+    int id;
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void cv_barrier_wait(cv_barrier* b) {
+    ticketlock_acquire(&b->lock);
+    int gen = b->generation;
+    if (++b->arrived == b->parties) {
+        b->arrived = 0;
+        b->generation++;
+        condition_variable_broadcast(&b->cv);
+    } else {
+        while (gen == b->generation) {
+            condition_variable_wait(&b->cv, &b->lock);
+        }
+    }
+    ticketlock_release(&b->lock);
+}
+
+static void* worker(void* arg) {
+    struct args* a = (struct args*)arg;
+
+    countdown_latch_count_down(&g_start_latch);
+    countdown_latch_wait(&g_start_latch);
+    if (a->id == 0) {
+        g_start_ns = now_ns(); // thread creation is not part of the measured phases
+    }
+
+    for (int i = 0; i < g_phases; i++) {
+        switch (a->kind) {
+        case BENCH_CV_BROADCAST:
+            cv_barrier_wait(&g_cv_barrier);
+            break;
+        case BENCH_SENSE:
+            sense_barrier_wait(&g_sense_barrier);
+            break;
+        case BENCH_DISSEMINATION:
+            dissemination_barrier_wait(&g_diss_barrier, a->id);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void run(barrier_kind kind, int threads) {
+    pthread_t* tids = malloc(sizeof(pthread_t) * threads);
+    struct args* args = malloc(sizeof(struct args) * threads);
+    if (tids == NULL || args == NULL) {
+        fprintf(stderr, "Failed to allocate memory for benchmark threads\n");
+        exit(1);
+    }
+
+    ticketlock_init(&g_cv_barrier.lock);
+    condition_variable_init(&g_cv_barrier.cv);
+    g_cv_barrier.arrived = 0;
+    g_cv_barrier.generation = 0;
+    g_cv_barrier.parties = threads;
+    sense_barrier_init(&g_sense_barrier, threads);
+    if (dissemination_barrier_init(&g_diss_barrier, threads) != 0) {
+        fprintf(stderr, "Failed to allocate dissemination barrier\n");
+        exit(1);
+    }
+    countdown_latch_init(&g_start_latch, threads);
+
+    for (int i = 0; i < threads; i++) {
+        args[i].kind = kind;
+        args[i].id = i;
+        if (pthread_create(&tids[i], NULL, worker, &args[i]) != 0) {
+            fprintf(stderr, "Error creating benchmark thread %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = now_ns() - g_start_ns;
+
+    printf("%s,%d,%d,%.1f\n", kind_names[kind], threads, g_phases, elapsed / g_phases);
+
+    dissemination_barrier_destroy(&g_diss_barrier);
+    free(tids);
+    free(args);
+}
+
+int main(int argc, char* argv[]) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 128;
+    g_phases = argc > 2 ? atoi(argv[2]) : 1000;
+
+    if (max_threads < 2 || g_phases <= 0) {
+        fprintf(stderr, "usage: barrier_bench [max_threads>=2] [phases>0]\n");
+        exit(1);
+    }
+
+    printf("barrier,threads,phases,ns_per_phase\n");
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+        run(BENCH_CV_BROADCAST, threads);
+        run(BENCH_SENSE, threads);
+        run(BENCH_DISSEMINATION, threads);
+    }
+    return 0;
+}
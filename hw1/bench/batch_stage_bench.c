@@ -0,0 +1,89 @@
+/*
+ * batch_stage_bench.c
+ *
+ * Per-item CPU cost of the consumer processing stage, without any locking or I/O.
+ *
+ * Compares the original per-item path (scalar '% 6' plus snprintf) with the batch stage
+ * (SIMD predicate plus bulk formatting) on the same random values and reports CSV:
+ *
+ *   stage,isa,batch,items,ns_per_item
+ *
+ * Build: gcc -O2 -I../task6 batch_stage_bench.c ../task6/batch_stage.c -o batch_stage_bench
+ * Usage: batch_stage_bench [items=10000000] [batch=256, at most items]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "batch_stage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_NUM 1000000
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    long items = argc > 1 ? atol(argv[1]) : 10000000;
+    int batch = argc > 2 ? atoi(argv[2]) : 256;
+
+    if (items <= 0 || batch <= 0 || items < batch) {
+        fprintf(stderr, "usage: batch_stage_bench [items>0] [batch>0, at most items]\n");
+        exit(1);
+    }
+
+    int* values = malloc(sizeof(int) * batch);
+    unsigned char* divisible = malloc(batch);
+    char* text = malloc((size_t)batch * BATCH_LINE_MAX);
+    if (values == NULL || divisible == NULL || text == NULL) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        exit(1);
+    }
+    srand(1);
+    for (int i = 0; i < batch; i++) {
+        values[i] = rand() % MAX_NUM;
+    }
+
+    unsigned long id = 140737351321344ul; // a typical pthread_self() value
+    size_t sink = 0;
+    long rounds = items / batch;
+
+    // original consumer path: one predicate and one snprintf per item
+    double start = now_ns();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < batch; i++) {
+            char buffer[100];
+            int n = snprintf(buffer, sizeof(buffer),
+                "Consumer %lu checked %d. Is it divisible by 6? %s",
+                id, values[i], (values[i] % 6 == 0) ? "True" : "False");
+            sink += (size_t)n + (unsigned char)buffer[n - 1];
+        }
+    }
+    double scalar_ns = (now_ns() - start) / (rounds * batch);
+    printf("stage,isa,batch,items,ns_per_item\n");
+    printf("snprintf,scalar,1,%ld,%.2f\n", rounds * batch, scalar_ns);
+
+    // batch stage
+    start = now_ns();
+    for (long r = 0; r < rounds; r++) {
+        batch_check_div6(values, divisible, batch);
+        sink += batch_format(text, id, values, divisible, batch);
+    }
+    double batch_ns = (now_ns() - start) / (rounds * batch);
+    printf("batch,%s,%d,%ld,%.2f\n", batch_stage_isa(), batch, rounds * batch, batch_ns);
+
+    // keep the compiler from discarding the work
+    if (sink == 0) {
+        printf("\n");
+    }
+
+    free(values);
+    free(divisible);
+    free(text);
+    return 0;
+}
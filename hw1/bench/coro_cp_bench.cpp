@@ -0,0 +1,177 @@
+/*
+ * coro_cp_bench.cpp
+ *
+ * The cp_pattern workload as OS threads versus as coroutines on a small pool.
+ *
+ * 'producers' producers push the numbers 0 .. items-1 through one hw1::channel to
+ * 'consumers' consumers, which count the numbers divisible by 6, as cp_pattern's consumers
+ * do. A counting semaphore of 'slots' permits bounds the channel, so producers wait as
+ * well. Counts and sums are checked, and one CSV row is printed per method:
+ *
+ *   method,producers,consumers,threads,items,seconds,items_per_sec
+ *
+ * Methods:
+ *   threads     one OS thread per producer and consumer, blocking waits
+ *               (skipped above 8192 threads)
+ *   coroutines  one coroutine per producer and consumer on 'threads' pool workers,
+ *               waiting with co_await
+ *
+ * Build: gcc -O2 -c ../task3/cond_var.c ../task2/tl_semaphore.c ../task6/executor.c
+ *            ../task6/ws_deque.c ../common/wait_policy.c ../common/async_wait.c -I../task3
+ *        g++ -std=c++23 -O2 -pthread -I../task3 coro_cp_bench.cpp *.o -o coro_cp_bench
+ * Usage: coro_cp_bench [producers=100] [consumers=100] [items=1000000] [threads=4] [slots=4096]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "../cpp/coro.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <latch>
+#include <thread>
+#include <vector>
+
+#define MAX_OS_THREADS 8192
+
+static long g_items;
+
+struct totals {
+    std::atomic<long> consumed{0};
+    std::atomic<long> divisible{0};
+    std::atomic<long> sum{0};
+};
+
+// Producer 'id' of 'n' pushes every n-th number starting at id
+template <class Chan, class Sem>
+static void produce_blocking(Chan& ch, Sem& slots, int id, int n, std::latch& done) {
+    for (long v = id; v < g_items; v += n) {
+        slots.acquire();
+        ch.push(v);
+    }
+    done.count_down();
+}
+
+template <class Chan, class Sem>
+static void consume_blocking(Chan& ch, Sem& slots, totals& t, std::latch& done) {
+    long consumed = 0, divisible = 0, sum = 0;
+    while (auto v = ch.pop_blocking()) {
+        slots.release();
+        consumed++;
+        divisible += *v % 6 == 0;
+        sum += *v;
+    }
+    t.consumed += consumed;
+    t.divisible += divisible;
+    t.sum += sum;
+    done.count_down();
+}
+
+template <class Chan, class Sem, class Exec>
+static hw1::detached produce(Chan& ch, Sem& slots, Exec& exec, int id, int n, std::latch& done) {
+    co_await hw1::schedule(exec);
+    for (long v = id; v < g_items; v += n) {
+        co_await hw1::async_acquire(slots, exec);
+        ch.push(v);
+    }
+    done.count_down();
+}
+
+template <class Chan, class Sem, class Exec>
+static hw1::detached consume(Chan& ch, Sem& slots, Exec& exec, totals& t, std::latch& done) {
+    co_await hw1::schedule(exec);
+    long consumed = 0, divisible = 0, sum = 0;
+    while (auto v = co_await ch.pop()) {
+        slots.release();
+        consumed++;
+        divisible += *v % 6 == 0;
+        sum += *v;
+    }
+    t.consumed += consumed;
+    t.divisible += divisible;
+    t.sum += sum;
+    done.count_down();
+}
+
+static void report(const char* method, int producers, int consumers, int threads,
+                   double seconds, const totals& t) {
+    long divisible = (g_items + 5) / 6;
+    long sum = g_items * (g_items - 1) / 2;
+    if (t.consumed != g_items || t.divisible != divisible || t.sum != sum) {
+        std::fprintf(stderr, "%s: consumed %ld of %ld items, %ld divisible (expected %ld)\n",
+                     method, t.consumed.load(), g_items, t.divisible.load(), divisible);
+        std::exit(1);
+    }
+    std::printf("%s,%d,%d,%d,%ld,%.3f,%.0f\n", method, producers, consumers, threads, g_items,
+                seconds, g_items / seconds);
+    std::fflush(stdout);
+}
+
+static void run_threads(int producers, int consumers, int slot_count) {
+    if (producers + consumers > MAX_OS_THREADS) {
+        std::fprintf(stderr, "threads: skipped, more than %d threads\n", MAX_OS_THREADS);
+        return;
+    }
+    hw1::inline_executor exec;
+    hw1::channel<long, hw1::inline_executor> ch(exec);
+    hw1::counting_semaphore<> slots(slot_count);
+    std::latch produced(producers), consumed(consumers);
+    totals t;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int c = 0; c < consumers; c++) {
+        workers.emplace_back([&] { consume_blocking(ch, slots, t, consumed); });
+    }
+    for (int p = 0; p < producers; p++) {
+        workers.emplace_back([&, p] { produce_blocking(ch, slots, p, producers, produced); });
+    }
+    produced.wait();
+    ch.close();
+    consumed.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& w : workers) {
+        w.join();
+    }
+    report("threads", producers, consumers, producers + consumers, seconds, t);
+}
+
+static void run_coroutines(int producers, int consumers, int threads, int slot_count) {
+    hw1::thread_pool_executor exec(threads);
+    hw1::channel<long, hw1::thread_pool_executor> ch(exec);
+    hw1::counting_semaphore<> slots(slot_count);
+    std::latch produced(producers), consumed(consumers);
+    totals t;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < consumers; c++) {
+        consume(ch, slots, exec, t, consumed);
+    }
+    for (int p = 0; p < producers; p++) {
+        produce(ch, slots, exec, p, producers, produced);
+    }
+    produced.wait();
+    ch.close();
+    consumed.wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    exec.wait_idle();   // the last coroutines may still be finishing on the workers
+    report("coroutines", producers, consumers, threads, seconds, t);
+}
+
+int main(int argc, char* argv[]) {
+    int producers = argc > 1 ? std::atoi(argv[1]) : 100;
+    int consumers = argc > 2 ? std::atoi(argv[2]) : 100;
+    g_items = argc > 3 ? std::atol(argv[3]) : 1000000;
+    int threads = argc > 4 ? std::atoi(argv[4]) : 4;
+    int slots = argc > 5 ? std::atoi(argv[5]) : 4096;
+    if (producers <= 0 || consumers <= 0 || g_items <= 0 || threads <= 0 || slots <= 0) {
+        std::fprintf(stderr, "Usage: %s [producers=100] [consumers=100] [items=1000000] [threads=4] [slots=4096]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    std::printf("method,producers,consumers,threads,items,seconds,items_per_sec\n");
+    run_threads(producers, consumers, slots);
+    run_coroutines(producers, consumers, threads, slots);
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * cpp_locks_bench.cpp
+ *
+ * The C++ wrappers of cpp/locks.hpp against the standard library, through the standard
+ * RAII types only (std::scoped_lock, std::shared_lock, std::condition_variable_any).
+ *
+ * Every thread runs a fixed number of critical sections that bump a shared counter; the
+ * average cost per operation is reported as CSV:
+ *
+ *   lock,threads,ops,ns_per_op
+ *
+ * A short producer-consumer handoff through std::condition_variable_any and through
+ * hw1::condition_variable checks that waiting works with the wrappers.
+ *
+ * Build: gcc -O2 -c ../task3/cond_var.c ../task3/mcs_lock.c ../task4/rw_lock.c
+ *            ../task2/tl_semaphore.c ../common/wait_policy.c ../common/async_wait.c -I../task3
+ *        g++ -std=c++23 -O2 -pthread -I../task3 cpp_locks_bench.cpp *.o -o cpp_locks_bench
+ * Usage: cpp_locks_bench [max_threads=8] [ops_per_thread=200000]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "../cpp/locks.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+static int g_ops;
+
+template <class Mutex>
+static void run_exclusive(const char* name, int threads) {
+    Mutex m;
+    long counter = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < g_ops; i++) {
+                std::scoped_lock guard(m);
+                counter++;
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    long ops = (long)threads * g_ops;
+    if (counter != ops) {
+        std::fprintf(stderr, "%s: lost updates (%ld of %ld)\n", name, counter, ops);
+        std::exit(1);
+    }
+    std::printf("%s,%d,%ld,%.1f\n", name, threads, ops, ns / ops);
+    std::fflush(stdout);
+}
+
+// 1 write per 16 operations, the rest read under std::shared_lock
+template <class SharedMutex>
+static void run_shared(const char* name, int threads) {
+    SharedMutex m;
+    long counter = 0;
+    std::atomic<long> reads{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            long seen = 0;
+            for (int i = 0; i < g_ops; i++) {
+                if (i % 16 == 0) {
+                    std::scoped_lock guard(m);
+                    counter++;
+                } else {
+                    std::shared_lock guard(m);
+                    seen += counter >= 0;
+                }
+            }
+            reads += seen;
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    long ops = (long)threads * g_ops;
+    if (counter + reads != ops) {
+        std::fprintf(stderr, "%s: wrong operation count\n", name);
+        std::exit(1);
+    }
+    std::printf("%s,%d,%ld,%.1f\n", name, threads, ops, ns / ops);
+    std::fflush(stdout);
+}
+
+// Passes 'items' values from one producer to one consumer through a one-slot buffer
+template <class Mutex, class CondVar>
+static void check_handoff(const char* name, int items) {
+    Mutex m;
+    CondVar cv;
+    int slot = -1;
+    long sum = 0;
+    std::thread consumer([&] {
+        for (int i = 0; i < items; i++) {
+            std::unique_lock lock(m);
+            cv.wait(lock, [&] { return slot >= 0; });
+            sum += slot;
+            slot = -1;
+            cv.notify_all();
+        }
+    });
+    for (int i = 0; i < items; i++) {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return slot < 0; });
+        slot = i;
+        cv.notify_all();
+    }
+    consumer.join();
+    if (sum != (long)items * (items - 1) / 2) {
+        std::fprintf(stderr, "%s: handoff lost values\n", name);
+        std::exit(1);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : 8;
+    g_ops = argc > 2 ? std::atoi(argv[2]) : 200000;
+    if (max_threads <= 0 || g_ops <= 0) {
+        std::fprintf(stderr, "Usage: %s [max_threads=8] [ops_per_thread=200000]\n", argv[0]);
+        return 1;
+    }
+
+    check_handoff<hw1::mutex<hw1::mcs>, std::condition_variable_any>("mcs+condition_variable_any", 10000);
+    check_handoff<hw1::mutex<hw1::ticket>, hw1::condition_variable<>>("ticket+hw1::condition_variable", 10000);
+
+    std::printf("lock,threads,ops,ns_per_op\n");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        run_exclusive<std::mutex>("std::mutex", threads);
+        run_exclusive<hw1::mutex<hw1::ticket>>("ticket", threads);
+        run_exclusive<hw1::mutex<hw1::ticket, hw1::wait_yield>>("ticket<yield>", threads);
+        run_exclusive<hw1::mutex<hw1::mcs>>("mcs", threads);
+        run_exclusive<hw1::mutex<hw1::binary_semaphore>>("binary_semaphore", threads);
+        run_shared<std::shared_mutex>("std::shared_mutex", threads);
+        run_shared<hw1::shared_mutex<>>("rwlock", threads);
+    }
+    return 0;
+}
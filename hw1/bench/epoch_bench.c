@@ -0,0 +1,208 @@
+/*
+ * epoch_bench.c
+ *
+ * Read-mostly lookups: read-write lock versus epoch-based reclamation.
+ *
+ * A small routing table is replaced as a whole by one writer thread, copy and pointer swap,
+ * while reader threads perform a fixed number of lookups each. With 'rwlock' every lookup
+ * takes the read side and the writer frees the old table under the write side. With 'epoch'
+ * lookups only enter and leave an epoch and the writer hands the old table to epoch_retire.
+ * Freed tables are poisoned first, with a version none of their routes match, so a lookup
+ * in reclaimed memory is caught. Reports CSV:
+ *
+ *   method,readers,lookups,ns_per_lookup,updates
+ *
+ * Build: gcc -O2 -pthread -I../task3 -I../task4 -I../task5 epoch_bench.c ../task3/cond_var.c
+ *            ../task4/rw_lock.c ../task5/epoch.c ../common/wait_policy.c ../common/async_wait.c
+ *            -o epoch_bench
+ * Usage: epoch_bench [max_readers=16] [lookups_per_reader=1000000]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "rw_lock.h"
+#include "epoch.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ROUTES 256   // power of two
+#define POISON_VERSION -1L  // written over freed tables; real versions are positive
+#define POISON_ROUTE   -2L  // ... and never equal to POISON_VERSION, so lookups fail
+
+typedef enum { M_RWLOCK, M_EPOCH, M_COUNT } method_t;
+
+static const char* method_names[M_COUNT] = { "rwlock", "epoch" };
+
+// Every route of a table carries the table's version, so a torn or freed table is visible
+typedef struct {
+    long version;
+    long routes[ROUTES];
+} table;
+
+static _Atomic(table*) g_table;
+static rwlock g_lock;
+
+static method_t g_method;
+static int g_lookups;
+static atomic_int g_readers_left;
+static atomic_long g_failures;
+
+struct args {
+    int id;
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static table* table_new(long version) {
+    table* t = malloc(sizeof(table));
+    if (t == NULL) {
+        fprintf(stderr, "Failed to allocate memory for a table\n");
+        exit(1);
+    }
+    t->version = version;
+    for (int i = 0; i < ROUTES; i++) {
+        t->routes[i] = version;
+    }
+    return t;
+}
+
+static void table_free(void* ptr) {
+    volatile table* t = (volatile table*)ptr;  // keeps the stores ahead of free()
+    t->version = POISON_VERSION;
+    for (int i = 0; i < ROUTES; i++) {
+        t->routes[i] = POISON_ROUTE;
+    }
+    free(ptr);
+}
+
+static int lookup(int key) {
+    table* t = atomic_load_explicit(&g_table, memory_order_acquire);
+    return t->routes[key] == t->version;
+}
+
+static void* reader(void* arg) {
+    struct args* a = (struct args*)arg;
+    unsigned int seed = 4321u + a->id;
+    long failures = 0;
+
+    if (g_method == M_EPOCH) {
+        epoch_register();
+    }
+    for (int i = 0; i < g_lookups; i++) {
+        int key = rand_r(&seed) & (ROUTES - 1);
+        if (g_method == M_RWLOCK) {
+            rwlock_acquire_read(&g_lock);
+            failures += !lookup(key);
+            rwlock_release_read(&g_lock);
+        } else {
+            epoch_enter();
+            failures += !lookup(key);
+            epoch_exit();
+        }
+    }
+    if (g_method == M_EPOCH) {
+        epoch_unregister();
+    }
+    atomic_fetch_add(&g_failures, failures);
+    atomic_fetch_sub(&g_readers_left, 1);
+    return NULL;
+}
+
+// Replaces the table until the readers are done and stores the number of updates
+static void* writer(void* arg) {
+    long* updates = (long*)arg;
+    long version = 1;
+
+    if (g_method == M_EPOCH) {
+        epoch_register();
+    }
+    while (atomic_load(&g_readers_left) > 0) {
+        table* next = table_new(++version);
+        if (g_method == M_RWLOCK) {
+            rwlock_acquire_write(&g_lock);
+            table* old = atomic_exchange(&g_table, next);
+            table_free(old);
+            rwlock_release_write(&g_lock);
+        } else {
+            table* old = atomic_exchange(&g_table, next);
+            epoch_retire(old, table_free);
+        }
+        sched_yield();
+    }
+    if (g_method == M_EPOCH) {
+        epoch_unregister();
+    }
+    *updates = version - 1;
+    return NULL;
+}
+
+static void run(method_t method, int readers) {
+    pthread_t* tids = malloc(sizeof(pthread_t) * readers);
+    struct args* args = malloc(sizeof(struct args) * readers);
+    if (tids == NULL || args == NULL) {
+        fprintf(stderr, "Failed to allocate memory for benchmark threads\n");
+        exit(1);
+    }
+
+    g_method = method;
+    rwlock_init(&g_lock);
+    atomic_store(&g_table, table_new(1));
+    atomic_store(&g_readers_left, readers);
+    atomic_store(&g_failures, 0);
+
+    pthread_t writer_tid;
+    long updates = 0;
+    double start = now_ns();
+    if (pthread_create(&writer_tid, NULL, writer, &updates) != 0) {
+        fprintf(stderr, "Error creating writer thread\n");
+        exit(1);
+    }
+    for (int i = 0; i < readers; i++) {
+        args[i].id = i;
+        if (pthread_create(&tids[i], NULL, reader, &args[i]) != 0) {
+            fprintf(stderr, "Error creating reader thread %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < readers; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = now_ns() - start;
+    pthread_join(writer_tid, NULL);
+
+    long lookups = (long)readers * g_lookups;
+    if (atomic_load(&g_failures) != 0) {
+        fprintf(stderr, "%s: %ld lookups saw a torn or freed table\n", method_names[method], atomic_load(&g_failures));
+        exit(1);
+    }
+    printf("%s,%d,%ld,%.1f,%ld\n", method_names[method], readers, lookups, elapsed / lookups, updates);
+    fflush(stdout);
+
+    table_free(atomic_load(&g_table));
+    free(tids);
+    free(args);
+}
+
+int main(int argc, char* argv[]) {
+    int max_readers = argc > 1 ? atoi(argv[1]) : 16;
+    g_lookups = argc > 2 ? atoi(argv[2]) : 1000000;
+    if (max_readers <= 0 || max_readers >= MAX_THREADS || g_lookups <= 0) {
+        fprintf(stderr, "Usage: %s [max_readers=16] [lookups_per_reader=1000000]\n", argv[0]);
+        return 1;
+    }
+
+    printf("method,readers,lookups,ns_per_lookup,updates\n");
+    for (int readers = 1; readers <= max_readers; readers *= 2) {
+        for (int m = 0; m < M_COUNT; m++) {
+            run((method_t)m, readers);
+        }
+    }
+    return 0;
+}
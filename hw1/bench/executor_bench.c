@@ -0,0 +1,123 @@
+/*
+ * executor_bench.c
+ *
+ * Cost of running a job on fresh threads versus on a long-lived executor.
+ *
+ * A "job" is a round of small independent tasks, like one call of start_consumers_producers
+ * starting its threads. Each round runs 'tasks' tasks and waits for all of them, and the
+ * average time per round is reported as CSV:
+ *
+ *   method,workers,tasks,rounds,us_per_round,ns_per_task
+ *
+ * Methods:
+ *   pthread_create    one thread per task, created and joined every round
+ *   executor_fixed    submit + future wait on a pool of 'workers' threads
+ *   executor_elastic  the same with a pool that grows from 1 to 'workers'
+ *
+ * Build: gcc -O2 -pthread -I../task6 executor_bench.c ../task6/executor.c ../task6/ws_deque.c
+ *            ../common/wait_policy.c -o executor_bench
+ * Usage: executor_bench [workers=4] [tasks=64] [rounds=200] [work=1000]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "executor.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef enum { M_PTHREAD, M_FIXED, M_ELASTIC, M_COUNT } method_t;
+
+static const char* method_names[M_COUNT] = { "pthread_create", "executor_fixed", "executor_elastic" };
+
+static int g_work;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// A few microseconds of arithmetic; returns a value derived from 'arg' for checking
+static void* task(void* arg) {
+    uintptr_t x = (uintptr_t)arg;
+    volatile uintptr_t sink = 0;
+    for (int i = 0; i < g_work; i++) {
+        sink += x * i;
+    }
+    (void)sink;
+    return (void*)(x * 2);
+}
+
+static void run(method_t method, int workers, int tasks, int rounds) {
+    pthread_t* tids = malloc(sizeof(pthread_t) * tasks);
+    executor_future** futures = malloc(sizeof(executor_future*) * tasks);
+    if (tids == NULL || futures == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the benchmark\n");
+        exit(1);
+    }
+
+    executor ex;
+    if (method != M_PTHREAD && executor_init(&ex, method == M_FIXED ? workers : 1, workers) != 0) {
+        fprintf(stderr, "Failed to initialize the executor\n");
+        exit(1);
+    }
+
+    double start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        uintptr_t sum = 0;
+        for (int i = 0; i < tasks; i++) {
+            if (method == M_PTHREAD) {
+                if (pthread_create(&tids[i], NULL, task, (void*)(uintptr_t)i) != 0) {
+                    fprintf(stderr, "Error creating task thread %d\n", i);
+                    exit(1);
+                }
+            } else {
+                futures[i] = executor_submit(&ex, task, (void*)(uintptr_t)i);
+            }
+        }
+        for (int i = 0; i < tasks; i++) {
+            void* result;
+            if (method == M_PTHREAD) {
+                pthread_join(tids[i], &result);
+            } else {
+                result = executor_future_wait(futures[i]);
+                executor_future_release(futures[i]);
+            }
+            sum += (uintptr_t)result;
+        }
+        if (sum != (uintptr_t)tasks * (tasks - 1)) {
+            fprintf(stderr, "%s: wrong task results\n", method_names[method]);
+            exit(1);
+        }
+    }
+    double elapsed = now_ns() - start;
+
+    printf("%s,%d,%d,%d,%.1f,%.1f\n", method_names[method], method == M_PTHREAD ? tasks : workers,
+           tasks, rounds, elapsed / rounds / 1e3, elapsed / ((double)rounds * tasks));
+    fflush(stdout);
+
+    if (method != M_PTHREAD) {
+        executor_destroy(&ex);
+    }
+    free(tids);
+    free(futures);
+}
+
+int main(int argc, char* argv[]) {
+    int workers = argc > 1 ? atoi(argv[1]) : 4;
+    int tasks = argc > 2 ? atoi(argv[2]) : 64;
+    int rounds = argc > 3 ? atoi(argv[3]) : 200;
+    g_work = argc > 4 ? atoi(argv[4]) : 1000;
+    if (workers <= 0 || tasks <= 0 || rounds <= 0 || g_work < 0) {
+        fprintf(stderr, "Usage: %s [workers=4] [tasks=64] [rounds=200] [work=1000]\n", argv[0]);
+        return 1;
+    }
+
+    printf("method,workers,tasks,rounds,us_per_round,ns_per_task\n");
+    for (int m = 0; m < M_COUNT; m++) {
+        run((method_t)m, workers, tasks, rounds);
+    }
+    return 0;
+}
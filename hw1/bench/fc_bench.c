@@ -0,0 +1,166 @@
+/*
+ * fc_bench.c
+ *
+ * Flat combining versus per-operation locking on a tiny shared structure.
+ *
+ * The structure mimics cp_pattern's producer critical section: flip a bit in a seen[]
+ * array, append the number to a small ring and bump a counter. Every thread performs a fixed
+ * number of such operations through one of the methods below and the average cost per
+ * operation is reported as CSV:
+ *
+ *   method,threads,ops,ns_per_op,ops_per_handoff
+ *
+ * ops_per_handoff is how many operations ran per lock acquisition: 1 for the locks, the
+ * average combining batch for flat_combining.
+ *
+ * Methods: ticket_lock, mcs_lock, pthread_mutex, flat_combining
+ *
+ * Build: gcc -O2 -pthread -I../task3 -I../task6 fc_bench.c ../task3/cond_var.c
+ *            ../task3/mcs_lock.c ../task6/flat_combining.c ../common/wait_policy.c
+ *            ../common/async_wait.c -o fc_bench
+ * Usage: fc_bench [max_threads=16] [ops_per_thread=200000]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "cond_var.h"
+#include "mcs_lock.h"
+#include "flat_combining.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SEEN_SIZE 1000000
+#define RING_SIZE 1024   // power of two
+
+typedef enum { M_TICKET, M_MCS, M_MUTEX, M_FC, M_COUNT } method_t;
+
+static const char* method_names[M_COUNT] = { "ticket_lock", "mcs_lock", "pthread_mutex", "flat_combining" };
+
+// The protected structure
+static char seen[SEEN_SIZE];
+static int ring[RING_SIZE];
+static long ring_tail;
+static long count;
+
+static ticket_lock g_ticket;
+static mcs_lock g_mcs;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static fc_executor g_fc;
+
+static method_t g_method;
+static int g_ops;
+
+struct args {
+    int id;
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// The critical section itself, identical for every method
+static intptr_t apply(void* state, int op, intptr_t arg) {
+    (void)state;
+    (void)op;
+    int num = (int)arg;
+    seen[num] ^= 1;
+    ring[ring_tail++ & (RING_SIZE - 1)] = num;
+    count++;
+    return 0;
+}
+
+static void* worker(void* arg) {
+    struct args* a = (struct args*)arg;
+    unsigned int seed = 1234u + a->id;
+    mcs_node node;
+
+    for (int i = 0; i < g_ops; i++) {
+        int num = rand_r(&seed) % SEEN_SIZE;
+        switch (g_method) {
+        case M_TICKET:
+            ticketlock_acquire(&g_ticket);
+            apply(NULL, 0, num);
+            ticketlock_release(&g_ticket);
+            break;
+        case M_MCS:
+            mcs_lock_acquire(&g_mcs, &node);
+            apply(NULL, 0, num);
+            mcs_lock_release(&g_mcs, &node);
+            break;
+        case M_MUTEX:
+            pthread_mutex_lock(&g_mutex);
+            apply(NULL, 0, num);
+            pthread_mutex_unlock(&g_mutex);
+            break;
+        default:
+            fc_execute(&g_fc, a->id, 0, num);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void run(method_t method, int threads) {
+    pthread_t* tids = malloc(sizeof(pthread_t) * threads);
+    struct args* args = malloc(sizeof(struct args) * threads);
+    if (tids == NULL || args == NULL) {
+        fprintf(stderr, "Failed to allocate memory for benchmark threads\n");
+        exit(1);
+    }
+
+    g_method = method;
+    count = 0;
+    ticketlock_init(&g_ticket);
+    mcs_lock_init(&g_mcs);
+    if (fc_init(&g_fc, threads, apply, NULL) != 0) {
+        fprintf(stderr, "Failed to allocate combining slots\n");
+        exit(1);
+    }
+
+    double start = now_ns();
+    for (int i = 0; i < threads; i++) {
+        args[i].id = i;
+        if (pthread_create(&tids[i], NULL, worker, &args[i]) != 0) {
+            fprintf(stderr, "Error creating benchmark thread %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = now_ns() - start;
+
+    long ops = (long)threads * g_ops;
+    if (count != ops) {
+        fprintf(stderr, "%s: lost updates (%ld of %ld)\n", method_names[method], count, ops);
+        exit(1);
+    }
+    double per_handoff = method == M_FC && g_fc.sessions > 0 ? (double)g_fc.combined / g_fc.sessions : 1.0;
+    printf("%s,%d,%ld,%.1f,%.2f\n", method_names[method], threads, ops, elapsed / ops, per_handoff);
+    fflush(stdout);
+
+    fc_destroy(&g_fc);
+    free(tids);
+    free(args);
+}
+
+int main(int argc, char* argv[]) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 16;
+    g_ops = argc > 2 ? atoi(argv[2]) : 200000;
+    if (max_threads <= 0 || g_ops <= 0) {
+        fprintf(stderr, "Usage: %s [max_threads=16] [ops_per_thread=200000]\n", argv[0]);
+        return 1;
+    }
+
+    printf("method,threads,ops,ns_per_op,ops_per_handoff\n");
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        for (int m = 0; m < M_COUNT; m++) {
+            run((method_t)m, threads);
+        }
+    }
+    return 0;
+}
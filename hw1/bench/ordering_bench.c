@@ -0,0 +1,208 @@
+/*
+ * ordering_bench.c
+ *
+ * Cost of the primitives' fast paths with the acquire/release orderings of mem_order.h
+ * versus all sequentially consistent ones.
+ *
+ * The same source is built twice, once with -DFORCE_SEQ_CST, and each binary reports its
+ * ordering in the first column. Every primitive is timed over 'iters' acquire/release pairs
+ * by one thread (the uncontended fast path) and by 'threads' threads hammering the same
+ * instance, under the yield policy (wakers skip the park handshake) and the park policy
+ * (wakers fence and look for sleepers). One CSV line per run:
+ *
+ *   ordering,policy,primitive,threads,ops,ns_per_op,ops_per_sec
+ *
+ * Primitives:
+ *   ticket_lock, mcs_lock                  plain mutual exclusion
+ *   tas_semaphore, tl_semaphore            binary semaphore used as a mutex
+ *   rwlock_read, rwlock_write              only readers, only writers
+ *   sense_barrier                          one wait per op, all threads are parties
+ *
+ * Build: gcc -O2 -pthread ordering_bench.c ../task3/cond_var.c ../task3/mcs_lock.c
+ *            ../task3/barrier.c ../task4/rw_lock.c ../common/wait_policy.c
+ *            ../common/async_wait.c -I../task3 -o ordering_bench
+ *        the same with -DFORCE_SEQ_CST -o ordering_bench_seq_cst
+ * Usage: ordering_bench [-t threads=4] [-n iters=1000000] [-p primitive]
+ *        (ordering_bench; ordering_bench_seq_cst | tail -n +2) > ordering.csv
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "../common/sem_variants.h"
+#include "../task3/barrier.h"
+#include "../task3/mcs_lock.h"
+#include "../task4/rw_lock.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    P_TICKET_LOCK,
+    P_MCS_LOCK,
+    P_TAS_SEMAPHORE,
+    P_TL_SEMAPHORE,
+    P_RWLOCK_READ,
+    P_RWLOCK_WRITE,
+    P_SENSE_BARRIER,
+    P_COUNT
+} primitive;
+
+static const char* primitive_names[P_COUNT] = {
+    "ticket_lock", "mcs_lock", "tas_semaphore", "tl_semaphore",
+    "rwlock_read", "rwlock_write", "sense_barrier",
+};
+
+static const char* policy_names[] = { "yield", "park" };
+
+static primitive g_prim;
+static long g_iters;
+static volatile long g_shared;   // touched inside every critical section
+
+static ticket_lock g_ticket;
+static mcs_lock g_mcs;
+static tas_semaphore g_tas;
+static tl_semaphore g_tl;
+static rwlock g_rw;
+static sense_barrier g_barrier;
+
+static void* worker(void* arg) {
+    (void)arg;
+    mcs_node node;
+    for (long i = 0; i < g_iters; i++) {
+        switch (g_prim) {
+        case P_TICKET_LOCK:
+            ticketlock_acquire(&g_ticket);
+            g_shared++;
+            ticketlock_release(&g_ticket);
+            break;
+        case P_MCS_LOCK:
+            mcs_lock_acquire(&g_mcs, &node);
+            g_shared++;
+            mcs_lock_release(&g_mcs, &node);
+            break;
+        case P_TAS_SEMAPHORE:
+            tas_semaphore_wait(&g_tas);
+            g_shared++;
+            tas_semaphore_signal(&g_tas);
+            break;
+        case P_TL_SEMAPHORE:
+            tl_semaphore_wait(&g_tl);
+            g_shared++;
+            tl_semaphore_signal(&g_tl);
+            break;
+        case P_RWLOCK_READ:
+            rwlock_acquire_read(&g_rw);
+            (void)g_shared;
+            rwlock_release_read(&g_rw);
+            break;
+        case P_RWLOCK_WRITE:
+            rwlock_acquire_write(&g_rw);
+            g_shared++;
+            rwlock_release_write(&g_rw);
+            break;
+        case P_SENSE_BARRIER:
+            sense_barrier_wait(&g_barrier);
+            break;
+        default:
+            break;
+        }
+    }
+    return NULL;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Initializes every primitive after the policy is set, so they all pick it up
+static void run(const char* policy_name, primitive prim, int threads) {
+    wait_policy policy = *wait_policy_global();
+    wait_policy_parse(&policy, policy_name);
+    wait_policy_set_global(&policy);
+    ticketlock_init(&g_ticket);
+    mcs_lock_init(&g_mcs);
+    tas_semaphore_init(&g_tas, 1);
+    tl_semaphore_init(&g_tl, 1);
+    rwlock_init(&g_rw);
+    sense_barrier_init(&g_barrier, threads);
+    g_prim = prim;
+
+    pthread_t* tids = malloc(sizeof(pthread_t) * threads);
+    if (tids == NULL) {
+        fprintf(stderr, "Failed to allocate memory for benchmark threads\n");
+        exit(1);
+    }
+    double start = now_sec();
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, worker, NULL) != 0) {
+            fprintf(stderr, "Error creating benchmark thread %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double seconds = now_sec() - start;
+    free(tids);
+
+    long ops = g_iters * threads;
+    printf("%s,%s,%s,%d,%ld,%.2f,%.0f\n", ORDER_NAME, policy_name, primitive_names[prim],
+           threads, ops, seconds * 1e9 / ops, ops / seconds);
+    fflush(stdout);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: ordering_bench [-t threads] [-n iters] [-p primitive]\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 4;
+    int only = -1;
+    g_iters = 1000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:p:")) != -1) {
+        switch (opt) {
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'n':
+            g_iters = atol(optarg);
+            break;
+        case 'p':
+            for (int p = 0; p < P_COUNT; p++) {
+                if (strcmp(optarg, primitive_names[p]) == 0) {
+                    only = p;
+                }
+            }
+            if (only < 0) {
+                usage();
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    if (threads < 1 || g_iters < 1) {
+        usage();
+    }
+
+    printf("ordering,policy,primitive,threads,ops,ns_per_op,ops_per_sec\n");
+    for (int pol = 0; pol < 2; pol++) {
+        for (int p = 0; p < P_COUNT; p++) {
+            if (only >= 0 && p != only) {
+                continue;
+            }
+            run(policy_names[pol], p, 1);
+            if (threads > 1) {
+                run(policy_names[pol], p, threads);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * pipeline_bench.c
+ *
+ * cp_pattern's divisibility checker expressed as a three-stage pipeline:
+ *
+ *   generate  unique random numbers in [0, 1000000), like the producers
+ *   check     divisibility by 6 with the vectorized batch stage
+ *   emit      one "Consumer ... checked ..." line per number, written to /dev/null,
+ *             and a tally of the divisible ones
+ *
+ * Every number must reach emit exactly once and 166667 of them must be divisible, otherwise
+ * the run fails. Prints the per-stage counters of pipeline_print_stats as CSV.
+ *
+ * Build: gcc -O2 -pthread -I../task6 pipeline_bench.c ../task6/pipeline.c ../task6/batch_stage.c
+ *            ../task3/cond_var.c ../common/sharded_counter.c ../common/wait_policy.c
+ *            ../common/async_wait.c -o pipeline_bench
+ * Usage: pipeline_bench [generate_threads=2] [check_threads=2] [batch=64, at most 4096] [capacity=4096]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "pipeline.h"
+#include "batch_stage.h"
+#include <stdlib.h>
+
+#define MAX_NUM 1000000
+#define DIVISIBLE_COUNT (MAX_NUM / 6 + 1)
+#define DRAWS_PER_ITEM 4   // random draws per output slot before a partial batch is handed on
+#define MAX_BATCH 4096     // largest batch, sizes the per-thread scratch of check and emit
+
+static atomic_char seen[MAX_NUM];
+static sharded_counter produced;
+static atomic_int next_seed = 1;
+
+static long emitted = 0;
+static long divisible_total = 0;
+static FILE* sink;
+
+static int generate(void* ctx, const intptr_t* in, int count, intptr_t* out, int out_cap) {
+    (void)ctx;
+    (void)in;
+    (void)count;
+    static __thread unsigned int seed = 0;
+    if (seed == 0) {
+        seed = 1234u * atomic_fetch_add(&next_seed, 1);
+    }
+
+    int n = 0;
+    for (int draws = 0; n < out_cap && draws < out_cap * DRAWS_PER_ITEM; draws++) {
+        if (sharded_counter_reached(&produced)) {
+            break;
+        }
+        int num = rand_r(&seed) % MAX_NUM;
+        if (!atomic_exchange_explicit(&seen[num], 1, memory_order_relaxed)) {
+            out[n++] = num;
+            sharded_counter_add(&produced, 1);
+        }
+    }
+    return n == 0 && sharded_counter_reached(&produced) ? PIPELINE_END : n;
+}
+
+// Packs each number with its verdict in the low bit
+static int check(void* ctx, const intptr_t* in, int count, intptr_t* out, int out_cap) {
+    (void)ctx;
+    (void)out_cap;
+    static __thread int values[MAX_BATCH];
+    static __thread unsigned char divisible[MAX_BATCH];
+    for (int i = 0; i < count; i++) {
+        values[i] = (int)in[i];
+    }
+    batch_check_div6(values, divisible, count);
+    for (int i = 0; i < count; i++) {
+        out[i] = ((intptr_t)values[i] << 1) | divisible[i];
+    }
+    return count;
+}
+
+// 'ctx' is the line buffer, sized for one batch; emit runs on one thread
+static int emit(void* ctx, const intptr_t* in, int count, intptr_t* out, int out_cap) {
+    char* text = (char*)ctx;
+    (void)out;
+    (void)out_cap;
+    static __thread int values[MAX_BATCH];
+    static __thread unsigned char divisible[MAX_BATCH];
+    for (int i = 0; i < count; i++) {
+        values[i] = (int)(in[i] >> 1);
+        divisible[i] = in[i] & 1;
+        divisible_total += divisible[i];
+    }
+    size_t len = batch_format(text, (unsigned long)pthread_self(), values, divisible, count);
+    fwrite(text, 1, len, sink);
+    emitted += count;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int generate_threads = argc > 1 ? atoi(argv[1]) : 2;
+    int check_threads = argc > 2 ? atoi(argv[2]) : 2;
+    int batch = argc > 3 ? atoi(argv[3]) : 64;
+    int capacity = argc > 4 ? atoi(argv[4]) : 4096;
+    if (generate_threads <= 0 || check_threads <= 0 || batch <= 0 || batch > MAX_BATCH || capacity <= 0) {
+        fprintf(stderr, "Usage: %s [generate_threads=2] [check_threads=2] [batch=64] [capacity=4096]\n", argv[0]);
+        return 1;
+    }
+
+    sink = fopen("/dev/null", "w");
+    char* text = malloc((size_t)batch * BATCH_LINE_MAX);
+    if (sink == NULL || text == NULL || sharded_counter_init(&produced, 0) != 0) {
+        fprintf(stderr, "Failed to set up the benchmark\n");
+        return 1;
+    }
+    sharded_counter_set_threshold(&produced, MAX_NUM);
+
+    pipeline p;
+    pipeline_init(&p, capacity);
+    pipeline_add_stage(&p, "generate", generate, NULL, generate_threads, batch);
+    pipeline_add_stage(&p, "check", check, NULL, check_threads, batch);
+    pipeline_add_stage(&p, "emit", emit, text, 1, batch);
+    if (pipeline_start(&p) != 0) {
+        fprintf(stderr, "Failed to start the pipeline\n");
+        return 1;
+    }
+    pipeline_wait(&p);
+
+    if (emitted != MAX_NUM || divisible_total != DIVISIBLE_COUNT) {
+        fprintf(stderr, "Wrong result: %ld numbers emitted, %ld divisible by 6\n", emitted, divisible_total);
+        return 1;
+    }
+    pipeline_print_stats(&p, stdout);
+
+    pipeline_destroy(&p);
+    sharded_counter_destroy(&produced);
+    free(text);
+    fclose(sink);
+    return 0;
+}
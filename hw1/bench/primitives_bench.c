@@ -0,0 +1,428 @@
+/*
+ * primitives_bench.c
+ *
+ * Contention sweep over every synchronization primitive in the project, with the
+ * matching pthread primitive as a baseline.
+ *
+ * Each run starts T threads that repeatedly acquire the primitive, spin for the configured
+ * critical-section length, release it and spin again outside. The time each acquire takes is
+ * recorded, and the run reports one CSV line with throughput and acquire-latency percentiles:
+ *
+ *   primitive,threads,cs_iters,read_pct,ops,ops_per_sec,p50_ns,p99_ns,p999_ns
+ *
+ * Primitives:
+ *   tas_semaphore, tl_semaphore, sem_t        binary semaphore used as a mutex
+ *   ticket_lock, pthread_mutex                plain mutual exclusion
+ *   cohort_lock                               NUMA-aware ticket lock (same workload as ticket_lock)
+ *   condition_variable, pthread_cond          monitor: wait on a cv until a 'busy' flag clears
+ *   rwlock, pthread_rwlock                    read with probability read_pct, write otherwise
+ *   tls, pthread_key                          get_tls_data, set_tls_data with probability 100-read_pct
+ *
+ * Build: gcc -O2 -pthread primitives_bench.c ../task3/cond_var.c ../task3/cohort_lock.c
+ *            ../task4/rw_lock.c ../task5/local_storage.c ../common/wait_policy.c
+ *            ../common/topology.c ../common/async_wait.c -I../task3 -o primitives_bench
+ * Usage: primitives_bench [-t max_threads] [-c cs_iters] [-o outside_iters] [-r read_pct]
+ *                         [-d duration_ms] [-p primitive]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "../common/sem_variants.h"
+#include "../task3/cond_var.h"
+#include "../task3/cohort_lock.h"
+#include "../task4/rw_lock.h"
+#include "../task5/local_storage.h"
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SAMPLES_PER_THREAD (1 << 18)
+
+typedef enum {
+    P_TAS_SEMAPHORE,
+    P_TL_SEMAPHORE,
+    P_SEM_T,
+    P_TICKET_LOCK,
+    P_PTHREAD_MUTEX,
+    P_COHORT_LOCK,
+    P_CONDITION_VARIABLE,
+    P_PTHREAD_COND,
+    P_RWLOCK,
+    P_PTHREAD_RWLOCK,
+    P_TLS,
+    P_PTHREAD_KEY,
+    P_COUNT
+} primitive_t;
+
+static const char* primitive_names[P_COUNT] = {
+    "tas_semaphore", "tl_semaphore", "sem_t",
+    "ticket_lock", "pthread_mutex", "cohort_lock",
+    "condition_variable", "pthread_cond",
+    "rwlock", "pthread_rwlock",
+    "tls", "pthread_key",
+};
+
+// Benchmark configuration
+static int max_threads = 8;
+static int cs_iters = 100;
+static int outside_iters = 100;
+static int read_pct = 90;
+static int duration_ms = 200;
+
+// Primitive instances shared by all threads of a run
+static tas_semaphore g_tas;
+static tl_semaphore g_tl;
+static sem_t g_sem;
+static ticket_lock g_ticket;
+static pthread_mutex_t g_mutex;
+static cohort_lock g_cohort;
+static condition_variable g_cv;
+static pthread_cond_t g_cond;
+static int g_busy;
+static rwlock g_rwlock;
+static pthread_rwlock_t g_prwlock;
+static pthread_key_t g_key;
+
+static atomic_int g_stop;
+static atomic_int g_ready;
+static volatile unsigned long g_shared; // touched inside the critical section
+
+typedef struct {
+    primitive_t prim;
+    unsigned int seed;
+    long ops;
+    int nsamples;
+    uint32_t* samples;
+} worker_t;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void busy(int iters) {
+    for (volatile int i = 0; i < iters; i++) {
+    }
+}
+
+/*
+ * One acquire/critical-section/release round. Returns the acquire latency in ns.
+ */
+static uint64_t one_op(worker_t* w) {
+    int read = (int)(rand_r(&w->seed) % 100) < read_pct;
+    uint64_t start = now_ns();
+    uint64_t acquired;
+
+    switch (w->prim) {
+    case P_TAS_SEMAPHORE:
+        tas_semaphore_wait(&g_tas);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        tas_semaphore_signal(&g_tas);
+        break;
+    case P_TL_SEMAPHORE:
+        tl_semaphore_wait(&g_tl);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        tl_semaphore_signal(&g_tl);
+        break;
+    case P_SEM_T:
+        sem_wait(&g_sem);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        sem_post(&g_sem);
+        break;
+    case P_TICKET_LOCK:
+        ticketlock_acquire(&g_ticket);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        ticketlock_release(&g_ticket);
+        break;
+    case P_PTHREAD_MUTEX:
+        pthread_mutex_lock(&g_mutex);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        pthread_mutex_unlock(&g_mutex);
+        break;
+    case P_COHORT_LOCK:
+        cohort_lock_acquire(&g_cohort);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        cohort_lock_release(&g_cohort);
+        break;
+    case P_CONDITION_VARIABLE:
+        ticketlock_acquire(&g_ticket);
+        while (g_busy) {
+            condition_variable_wait(&g_cv, &g_ticket);
+        }
+        g_busy = 1;
+        ticketlock_release(&g_ticket);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        ticketlock_acquire(&g_ticket);
+        g_busy = 0;
+        condition_variable_signal(&g_cv);
+        ticketlock_release(&g_ticket);
+        break;
+    case P_PTHREAD_COND:
+        pthread_mutex_lock(&g_mutex);
+        while (g_busy) {
+            pthread_cond_wait(&g_cond, &g_mutex);
+        }
+        g_busy = 1;
+        pthread_mutex_unlock(&g_mutex);
+        acquired = now_ns();
+        g_shared++;
+        busy(cs_iters);
+        pthread_mutex_lock(&g_mutex);
+        g_busy = 0;
+        pthread_cond_signal(&g_cond);
+        pthread_mutex_unlock(&g_mutex);
+        break;
+    case P_RWLOCK:
+        if (read) {
+            rwlock_acquire_read(&g_rwlock);
+            acquired = now_ns();
+            busy(cs_iters);
+            rwlock_release_read(&g_rwlock);
+        } else {
+            rwlock_acquire_write(&g_rwlock);
+            acquired = now_ns();
+            g_shared++;
+            busy(cs_iters);
+            rwlock_release_write(&g_rwlock);
+        }
+        break;
+    case P_PTHREAD_RWLOCK:
+        if (read) {
+            pthread_rwlock_rdlock(&g_prwlock);
+            acquired = now_ns();
+            busy(cs_iters);
+            pthread_rwlock_unlock(&g_prwlock);
+        } else {
+            pthread_rwlock_wrlock(&g_prwlock);
+            acquired = now_ns();
+            g_shared++;
+            busy(cs_iters);
+            pthread_rwlock_unlock(&g_prwlock);
+        }
+        break;
+    case P_TLS:
+        if (read) {
+            g_shared += (uintptr_t)get_tls_data();
+        } else {
+            set_tls_data(w);
+        }
+        acquired = now_ns();
+        busy(cs_iters);
+        break;
+    case P_PTHREAD_KEY:
+    default:
+        if (read) {
+            g_shared += (uintptr_t)pthread_getspecific(g_key);
+        } else {
+            pthread_setspecific(g_key, w);
+        }
+        acquired = now_ns();
+        busy(cs_iters);
+        break;
+    }
+    return acquired - start;
+}
+
+static void* worker(void* arg) {
+    worker_t* w = (worker_t*)arg;
+
+    if (w->prim == P_TLS) {
+        tls_thread_alloc();
+        set_tls_data(w);
+    }
+
+    atomic_fetch_add(&g_ready, 1);
+    while (atomic_load(&g_ready) > 0) {
+        sched_yield(); // wait for the starting gun
+    }
+
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        uint64_t lat = one_op(w);
+        if (w->nsamples < MAX_SAMPLES_PER_THREAD) {
+            w->samples[w->nsamples++] = lat > UINT32_MAX ? UINT32_MAX : (uint32_t)lat;
+        }
+        w->ops++;
+        busy(outside_iters);
+    }
+
+    if (w->prim == P_TLS) {
+        tls_thread_free();
+    }
+    return NULL;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void init_primitives(void) {
+    tas_semaphore_init(&g_tas, 1);
+    tl_semaphore_init(&g_tl, 1);
+    sem_init(&g_sem, 0, 1);
+    ticketlock_init(&g_ticket);
+    pthread_mutex_init(&g_mutex, NULL);
+    if (cohort_lock_init(&g_cohort, 0) != 0) {
+        fprintf(stderr, "Failed to allocate cohort lock\n");
+        exit(1);
+    }
+    condition_variable_init(&g_cv);
+    pthread_cond_init(&g_cond, NULL);
+    g_busy = 0;
+    rwlock_init(&g_rwlock);
+    pthread_rwlock_init(&g_prwlock, NULL);
+    init_storage();
+}
+
+static void run(primitive_t prim, int threads) {
+    pthread_t* tids = malloc(sizeof(pthread_t) * threads);
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+    if (tids == NULL || workers == NULL) {
+        fprintf(stderr, "Failed to allocate memory for benchmark threads\n");
+        exit(1);
+    }
+
+    init_primitives();
+    atomic_store(&g_stop, 0);
+    atomic_store(&g_ready, 0);
+
+    for (int i = 0; i < threads; i++) {
+        workers[i].prim = prim;
+        workers[i].seed = 12345u + i;
+        workers[i].samples = malloc(sizeof(uint32_t) * MAX_SAMPLES_PER_THREAD);
+        if (workers[i].samples == NULL) {
+            fprintf(stderr, "Failed to allocate latency samples\n");
+            exit(1);
+        }
+        if (pthread_create(&tids[i], NULL, worker, &workers[i]) != 0) {
+            fprintf(stderr, "Error creating benchmark thread %d\n", i);
+            exit(1);
+        }
+    }
+
+    while (atomic_load(&g_ready) < threads) {
+        sched_yield();
+    }
+    uint64_t start = now_ns();
+    atomic_store(&g_ready, 0);
+    usleep((useconds_t)duration_ms * 1000);
+    atomic_store(&g_stop, 1);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    long ops = 0;
+    long nsamples = 0;
+    for (int i = 0; i < threads; i++) {
+        ops += workers[i].ops;
+        nsamples += workers[i].nsamples;
+    }
+    uint32_t* all = malloc(sizeof(uint32_t) * (nsamples ? nsamples : 1));
+    if (all == NULL) {
+        fprintf(stderr, "Failed to allocate latency samples\n");
+        exit(1);
+    }
+    long k = 0;
+    for (int i = 0; i < threads; i++) {
+        memcpy(all + k, workers[i].samples, sizeof(uint32_t) * workers[i].nsamples);
+        k += workers[i].nsamples;
+        free(workers[i].samples);
+    }
+    qsort(all, nsamples, sizeof(uint32_t), cmp_u32);
+
+    uint32_t p50 = nsamples ? all[(long)(nsamples * 0.50)] : 0;
+    uint32_t p99 = nsamples ? all[(long)(nsamples * 0.99)] : 0;
+    uint32_t p999 = nsamples ? all[(long)(nsamples * 0.999)] : 0;
+
+    printf("%s,%d,%d,%d,%ld,%.0f,%u,%u,%u\n", primitive_names[prim], threads, cs_iters,
+           read_pct, ops, ops / elapsed, p50, p99, p999);
+    fflush(stdout);
+
+    sem_destroy(&g_sem);
+    pthread_mutex_destroy(&g_mutex);
+    cohort_lock_destroy(&g_cohort);
+    pthread_cond_destroy(&g_cond);
+    pthread_rwlock_destroy(&g_prwlock);
+    free(all);
+    free(tids);
+    free(workers);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: primitives_bench [-t max_threads] [-c cs_iters] [-o outside_iters] "
+                    "[-r read_pct] [-d duration_ms] [-p primitive]\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    int only = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:c:o:r:d:p:")) != -1) {
+        switch (opt) {
+        case 't': max_threads = atoi(optarg); break;
+        case 'c': cs_iters = atoi(optarg); break;
+        case 'o': outside_iters = atoi(optarg); break;
+        case 'r': read_pct = atoi(optarg); break;
+        case 'd': duration_ms = atoi(optarg); break;
+        case 'p':
+            for (int i = 0; i < P_COUNT; i++) {
+                if (strcmp(optarg, primitive_names[i]) == 0) {
+                    only = i;
+                }
+            }
+            if (only < 0) {
+                usage();
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    // the TLS table only has MAX_THREADS slots
+    if (max_threads <= 0 || max_threads > MAX_THREADS || cs_iters < 0 || outside_iters < 0 ||
+        read_pct < 0 || read_pct > 100 || duration_ms <= 0) {
+        usage();
+    }
+
+    pthread_key_create(&g_key, NULL);
+
+    printf("primitive,threads,cs_iters,read_pct,ops,ops_per_sec,p50_ns,p99_ns,p999_ns\n");
+    for (int p = 0; p < P_COUNT; p++) {
+        if (only >= 0 && p != only) {
+            continue;
+        }
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            run((primitive_t)p, threads);
+            if (threads < max_threads && threads * 2 > max_threads) {
+                run((primitive_t)p, max_threads); // always include N itself
+            }
+        }
+    }
+
+    pthread_key_delete(g_key);
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * reactive_bench.c
+ *
+ * Phased workload for the reactive lock: the load alternates between one thread (no
+ * contention) and 'threads' threads hammering the lock, and every method keeps a single lock
+ * instance across all phases, so the reactive lock has to notice each change on its own.
+ *
+ * In every phase the active threads repeatedly acquire the lock, spin 'cs_iters' pause
+ * iterations inside, release it and spin 'outside_iters' outside, for 'duration_ms'.
+ * One CSV line per method and phase; 'mode' is the reactive lock's mode at the end of the
+ * phase and 'switches' its mode changes so far:
+ *
+ *   method,phase,load,threads,ops,ns_per_op,mode,switches
+ *
+ * Methods:
+ *   tas          reactive lock pinned to TAS mode
+ *   queue        reactive lock pinned to QUEUE mode
+ *   ticket_lock  the plain ticket lock, for reference
+ *   reactive     reactive lock switching on its own
+ *
+ * Build: gcc -O2 -pthread -I../task3 reactive_bench.c ../task3/reactive_lock.c
+ *            ../task3/cond_var.c ../common/wait_policy.c ../common/async_wait.c -o reactive_bench
+ * Usage: reactive_bench [-t threads=8] [-p phases=6] [-d duration_ms=300] [-c cs_iters=50]
+ *                       [-o outside_iters=0]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "../task3/reactive_lock.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    M_TAS,
+    M_QUEUE,
+    M_TICKET_LOCK,
+    M_REACTIVE,
+    M_COUNT
+} method;
+
+static const char* method_names[M_COUNT] = { "tas", "queue", "ticket_lock", "reactive" };
+
+static method g_method;
+static reactive_lock g_reactive;
+static ticket_lock g_ticket;
+static int g_cs_iters;
+static int g_outside_iters;
+static atomic_int g_stop;
+static volatile long g_shared;
+
+typedef struct {
+    _Alignas(REACTIVE_CACHE_LINE) long ops;
+    pthread_t tid;
+} worker_t;
+
+static void spin(int iters) {
+    for (int i = 0; i < iters; i++) {
+        wait_cpu_relax();
+    }
+}
+
+static void* worker(void* arg) {
+    worker_t* self = (worker_t*)arg;
+    long ops = 0;
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        if (g_method == M_TICKET_LOCK) {
+            ticketlock_acquire(&g_ticket);
+            g_shared++;
+            spin(g_cs_iters);
+            ticketlock_release(&g_ticket);
+        } else {
+            reactive_lock_acquire(&g_reactive);
+            g_shared++;
+            spin(g_cs_iters);
+            reactive_lock_release(&g_reactive);
+        }
+        spin(g_outside_iters);
+        ops++;
+    }
+    self->ops = ops;
+    return NULL;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Runs one phase with 'threads' workers and reports it
+static void run_phase(int phase, int threads, int duration_ms, worker_t* workers) {
+    atomic_store(&g_stop, 0);
+    g_shared = 0;
+    double start = now_sec();
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i].tid, NULL, worker, &workers[i]) != 0) {
+            fprintf(stderr, "Error creating benchmark thread %d\n", i);
+            exit(1);
+        }
+    }
+    usleep(duration_ms * 1000);
+    atomic_store(&g_stop, 1);
+    long ops = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        ops += workers[i].ops;
+    }
+    double seconds = now_sec() - start;
+    if (g_shared != ops) {
+        fprintf(stderr, "%s: lost updates in phase %d (%ld of %ld)\n", method_names[g_method],
+                phase, (long)g_shared, ops);
+        exit(1);
+    }
+
+    const char* mode = "-";
+    long switches = 0;
+    if (g_method != M_TICKET_LOCK) {
+        mode = reactive_lock_mode(&g_reactive) == REACTIVE_TAS ? "tas" : "queue";
+        switches = g_reactive.switches;
+    }
+    printf("%s,%d,%s,%d,%ld,%.1f,%s,%ld\n", method_names[g_method], phase,
+           threads > 1 ? "high" : "low", threads, ops, ops ? seconds * 1e9 / ops : 0.0,
+           mode, switches);
+    fflush(stdout);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: reactive_bench [-t threads] [-p phases] [-d duration_ms] "
+                    "[-c cs_iters] [-o outside_iters]\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 8;
+    int phases = 6;
+    int duration_ms = 300;
+    g_cs_iters = 50;
+    g_outside_iters = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:p:d:c:o:")) != -1) {
+        switch (opt) {
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'p':
+            phases = atoi(optarg);
+            break;
+        case 'd':
+            duration_ms = atoi(optarg);
+            break;
+        case 'c':
+            g_cs_iters = atoi(optarg);
+            break;
+        case 'o':
+            g_outside_iters = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (threads < 2 || phases < 1 || duration_ms < 1 || g_cs_iters < 0 || g_outside_iters < 0) {
+        usage();
+    }
+
+    worker_t* workers = aligned_alloc(REACTIVE_CACHE_LINE, sizeof(worker_t) * threads);
+    if (workers == NULL) {
+        fprintf(stderr, "Failed to allocate memory for benchmark threads\n");
+        return 1;
+    }
+
+    printf("method,phase,load,threads,ops,ns_per_op,mode,switches\n");
+    for (int m = 0; m < M_COUNT; m++) {
+        g_method = m;
+        if (m == M_TAS) {
+            reactive_lock_init_fixed(&g_reactive, REACTIVE_TAS);
+        } else if (m == M_QUEUE) {
+            reactive_lock_init_fixed(&g_reactive, REACTIVE_QUEUE);
+        } else {
+            reactive_lock_init(&g_reactive);
+        }
+        ticketlock_init(&g_ticket);
+        for (int phase = 0; phase < phases; phase++) {
+            run_phase(phase, phase % 2 == 0 ? 1 : threads, duration_ms, workers);
+        }
+    }
+    free(workers);
+    return 0;
+}
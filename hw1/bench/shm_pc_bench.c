@@ -0,0 +1,278 @@
+/*
+ * shm_pc_bench.c
+ *
+ * Multi-process producer-consumer benchmark for the process-shared primitives.
+ *
+ * Producer and consumer processes exchange 'items' integers through one of three channels:
+ *   pipe   a single pipe, the baseline the shared-memory modes are meant to replace
+ *   sem    a ring in an shm_arena guarded by a ticket lock, with two ticket-lock semaphores
+ *          counting free slots and filled slots
+ *   cv     the same ring guarded by a ticket lock with not_empty / not_full condition variables
+ * Children attach to the arena by name, so it is mapped at a different address in every
+ * process, which is what the primitives have to cope with. Every mode checks that the sum of
+ * the consumed values matches what was produced, and one CSV row is printed per mode:
+ *
+ *   mode,producers,consumers,items,seconds,items_per_sec
+ *
+ * Build: gcc -O2 -pthread -I../task2 -I../task3 shm_pc_bench.c ../task2/tl_semaphore.c
+ *            ../task3/cond_var.c ../common/wait_policy.c ../common/shm_arena.c ../common/async_wait.c
+ *            -o shm_pc_bench
+ * Usage: shm_pc_bench [producers=2] [consumers=2] [items=1000000]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "tl_semaphore.h"
+#include "cond_var.h"
+#include "../common/shm_arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RING_CAP 1024
+#define ARENA_NAME "/shm_pc_bench"
+#define STOP -1L   // pushed once per consumer after all producers are done
+
+typedef enum { MODE_PIPE, MODE_SEM, MODE_CV } bench_mode;
+
+static const char* mode_names[] = { "pipe", "sem", "cv" };
+
+// Everything the processes share. Lives in the arena, so it holds no pointers.
+typedef struct {
+    ticket_lock lock;
+    semaphore free_slots;
+    semaphore filled_slots;
+    condition_variable not_empty;
+    condition_variable not_full;
+    int head;
+    int tail;
+    int count;
+    atomic_long sum;
+    long items[RING_CAP];
+} shared_ring;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Unlocked ring operations, the caller holds ring->lock
+static void ring_put(shared_ring* ring, long value) {
+    ring->items[ring->tail] = value;
+    ring->tail = (ring->tail + 1) % RING_CAP;
+    ring->count++;
+}
+
+static long ring_take(shared_ring* ring) {
+    long value = ring->items[ring->head];
+    ring->head = (ring->head + 1) % RING_CAP;
+    ring->count--;
+    return value;
+}
+
+static void push(shared_ring* ring, bench_mode mode, long value) {
+    if (mode == MODE_SEM) {
+        semaphore_wait(&ring->free_slots);
+        ticketlock_acquire(&ring->lock);
+        ring_put(ring, value);
+        ticketlock_release(&ring->lock);
+        semaphore_signal(&ring->filled_slots);
+    } else {
+        ticketlock_acquire(&ring->lock);
+        while (ring->count == RING_CAP) {
+            condition_variable_wait(&ring->not_full, &ring->lock);
+        }
+        ring_put(ring, value);
+        condition_variable_signal(&ring->not_empty);
+        ticketlock_release(&ring->lock);
+    }
+}
+
+static long pop(shared_ring* ring, bench_mode mode) {
+    long value;
+    if (mode == MODE_SEM) {
+        semaphore_wait(&ring->filled_slots);
+        ticketlock_acquire(&ring->lock);
+        value = ring_take(ring);
+        ticketlock_release(&ring->lock);
+        semaphore_signal(&ring->free_slots);
+    } else {
+        ticketlock_acquire(&ring->lock);
+        while (ring->count == 0) {
+            condition_variable_wait(&ring->not_empty, &ring->lock);
+        }
+        value = ring_take(ring);
+        condition_variable_signal(&ring->not_full);
+        ticketlock_release(&ring->lock);
+    }
+    return value;
+}
+
+// Maps the benchmark arena in a freshly forked child and returns the ring inside it
+static shared_ring* attach_ring(shm_arena* arena) {
+    if (shm_arena_attach(arena, ARENA_NAME) != 0) {
+        perror("shm_arena_attach");
+        exit(1);
+    }
+    return shm_arena_root(arena);
+}
+
+// Producer 'id' sends values id+1, id+1+producers, ... so all of 1..items are sent exactly once
+static void producer(bench_mode mode, int id, int producers, long items, int pipe_fd) {
+    shm_arena arena;
+    shared_ring* ring = mode == MODE_PIPE ? NULL : attach_ring(&arena);
+    for (long v = id + 1; v <= items; v += producers) {
+        if (mode == MODE_PIPE) {
+            if (write(pipe_fd, &v, sizeof(v)) != sizeof(v)) {
+                perror("write");
+                exit(1);
+            }
+        } else {
+            push(ring, mode, v);
+        }
+    }
+    exit(0);
+}
+
+static void consumer(bench_mode mode, int pipe_fd, int result_fd) {
+    shm_arena arena;
+    shared_ring* ring = mode == MODE_PIPE ? NULL : attach_ring(&arena);
+    long sum = 0;
+    long v;
+    while (1) {
+        if (mode == MODE_PIPE) {
+            // every write is one whole long, so a read never returns a partial value
+            if (read(pipe_fd, &v, sizeof(v)) != sizeof(v)) {
+                break;
+            }
+        } else if ((v = pop(ring, mode)) == STOP) {
+            break;
+        }
+        sum += v;
+    }
+    if (mode == MODE_PIPE) {
+        if (write(result_fd, &sum, sizeof(sum)) != sizeof(sum)) {
+            exit(1);
+        }
+    } else {
+        atomic_fetch_add(&ring->sum, sum);
+    }
+    exit(0);
+}
+
+static shared_ring* create_ring(shm_arena* arena) {
+    if (shm_arena_create(arena, ARENA_NAME, sizeof(shared_ring) + SHM_ARENA_ALIGN) != 0) {
+        perror("shm_arena_create");
+        exit(1);
+    }
+    shared_ring* ring = shm_arena_alloc(arena, sizeof(shared_ring));
+    ticketlock_init_shared(&ring->lock);
+    semaphore_init_shared(&ring->free_slots, RING_CAP);
+    semaphore_init_shared(&ring->filled_slots, 0);
+    condition_variable_init_shared(&ring->not_empty);
+    condition_variable_init_shared(&ring->not_full);
+    ring->head = ring->tail = ring->count = 0;
+    atomic_init(&ring->sum, 0);
+    shm_arena_set_root(arena, ring);
+    return ring;
+}
+
+static void run(bench_mode mode, int producers, int consumers, long items) {
+    shm_arena arena;
+    shared_ring* ring = NULL;
+    int data[2], results[2];
+    if (mode == MODE_PIPE) {
+        if (pipe(data) != 0 || pipe(results) != 0) {
+            perror("pipe");
+            exit(1);
+        }
+    } else {
+        ring = create_ring(&arena);
+    }
+
+    double start = now_sec();
+    pid_t* producer_pids = malloc(sizeof(pid_t) * producers);
+    for (int i = 0; i < consumers + producers; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            if (mode == MODE_PIPE) {
+                if (i < consumers) {
+                    close(data[1]);
+                    consumer(mode, data[0], results[1]);
+                }
+                close(data[0]);
+                producer(mode, i - consumers, producers, items, data[1]);
+            }
+            if (i < consumers) {
+                consumer(mode, -1, -1);
+            }
+            producer(mode, i - consumers, producers, items, -1);
+        }
+        if (i >= consumers) {
+            producer_pids[i - consumers] = pid;
+        }
+    }
+
+    for (int i = 0; i < producers; i++) {
+        waitpid(producer_pids[i], NULL, 0);
+    }
+    if (mode == MODE_PIPE) {
+        close(data[1]); // consumers see end of file once the pipe is drained
+    } else {
+        for (int i = 0; i < consumers; i++) {
+            push(ring, mode, STOP);
+        }
+    }
+    for (int i = 0; i < consumers; i++) {
+        wait(NULL);
+    }
+    double elapsed = now_sec() - start;
+
+    long sum = 0;
+    if (mode == MODE_PIPE) {
+        close(data[0]);
+        close(results[1]);
+        long part;
+        while (read(results[0], &part, sizeof(part)) == sizeof(part)) {
+            sum += part;
+        }
+        close(results[0]);
+    } else {
+        sum = atomic_load(&ring->sum);
+        shm_arena_detach(&arena);
+        shm_arena_unlink(ARENA_NAME);
+    }
+    free(producer_pids);
+
+    if (sum != items * (items + 1) / 2) {
+        fprintf(stderr, "%s: checksum mismatch (%ld)\n", mode_names[mode], sum);
+        exit(1);
+    }
+    printf("%s,%d,%d,%ld,%.3f,%.0f\n", mode_names[mode], producers, consumers, items,
+           elapsed, items / elapsed);
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    int producers = argc > 1 ? atoi(argv[1]) : 2;
+    int consumers = argc > 2 ? atoi(argv[2]) : 2;
+    long items = argc > 3 ? atol(argv[3]) : 1000000;
+    if (producers < 1 || consumers < 1 || items < 1) {
+        fprintf(stderr, "Usage: %s [producers=2] [consumers=2] [items=1000000]\n", argv[0]);
+        return 1;
+    }
+
+    printf("mode,producers,consumers,items,seconds,items_per_sec\n");
+    fflush(stdout); // children must not inherit unflushed output
+    for (int m = MODE_PIPE; m <= MODE_CV; m++) {
+        run((bench_mode)m, producers, consumers, items);
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * async_wait.c
+ *
+ * Implementation of the asynchronous waiters and their queue.
+ *
+ * A completer reads everything it needs from the waiter before marking it done: once the
+ * state is ASYNC_WAIT_DONE the owner may reuse the waiter, so afterwards only the saved
+ * callback or descriptor is touched.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "async_wait.h"
+#include "wait_policy.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+void async_waiter_init_callback(async_waiter* w, async_wait_fn fn, void* arg) {
+    w->next = NULL;
+    w->permits = 0;
+    w->fn = fn;
+    w->arg = arg;
+    w->efd = -1;
+    atomic_init(&w->state, ASYNC_WAIT_IDLE);
+}
+
+int async_waiter_init_eventfd(async_waiter* w) {
+    async_waiter_init_callback(w, NULL, NULL);
+    w->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return w->efd;
+}
+
+int async_waiter_consume(async_waiter* w) {
+    uint64_t events;
+    if (w->efd < 0) {
+        return async_waiter_done(w);
+    }
+    return read(w->efd, &events, sizeof(events)) == sizeof(events);
+}
+
+int async_waiter_done(async_waiter* w) {
+    return atomic_load_explicit(&w->state, ORDER_ACQUIRE) == ASYNC_WAIT_DONE;
+}
+
+void async_waiter_destroy(async_waiter* w) {
+    if (w->efd >= 0) {
+        close(w->efd);
+        w->efd = -1;
+    }
+}
+
+void async_waitq_init(async_waitq* q) {
+    atomic_flag_clear(&q->lock);
+    atomic_init(&q->count, 0);
+    q->head = NULL;
+    q->tail = NULL;
+}
+
+/*
+ * The lock only covers a few pointer updates, so waiting on it never parks.
+ */
+void async_waitq_lock(async_waitq* q) {
+    const wait_policy* policy = wait_policy_global();
+    wait_state ws = WAIT_STATE_INIT;
+    while (atomic_flag_test_and_set_explicit(&q->lock, ORDER_ACQUIRE)) {
+        wait_pause(policy, &ws, NULL, 0, NULL);
+    }
+}
+
+void async_waitq_unlock(async_waitq* q) {
+    atomic_flag_clear_explicit(&q->lock, ORDER_RELEASE);
+}
+
+void async_waitq_push(async_waitq* q, async_waiter* w) {
+    w->next = NULL;
+    atomic_store_explicit(&w->state, ASYNC_WAIT_PENDING, ORDER_RELAXED);
+    async_waitq_lock(q);
+    if (q->tail == NULL) {
+        q->head = w;
+    } else {
+        q->tail->next = w;
+    }
+    q->tail = w;
+    atomic_fetch_add(&q->count, 1);   // sequentially consistent: checked by signalers without the lock
+    async_waitq_unlock(q);
+}
+
+async_waiter* async_waitq_pop_locked(async_waitq* q) {
+    async_waiter* w = q->head;
+    if (w != NULL) {
+        q->head = w->next;
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+        w->next = NULL;
+        atomic_fetch_sub_explicit(&q->count, 1, ORDER_RELAXED);
+    }
+    return w;
+}
+
+int async_waitq_remove(async_waitq* q, async_waiter* w) {
+    async_waitq_lock(q);
+    async_waiter* prev = NULL;
+    async_waiter* cur = q->head;
+    while (cur != NULL && cur != w) {
+        prev = cur;
+        cur = cur->next;
+    }
+    if (cur != NULL) {
+        if (prev == NULL) {
+            q->head = cur->next;
+        } else {
+            prev->next = cur->next;
+        }
+        if (q->tail == cur) {
+            q->tail = prev;
+        }
+        atomic_fetch_sub_explicit(&q->count, 1, ORDER_RELAXED);
+        atomic_store_explicit(&w->state, ASYNC_WAIT_IDLE, ORDER_RELAXED);
+    }
+    async_waitq_unlock(q);
+    return cur != NULL;
+}
+
+void async_waiter_complete(async_waiter* w) {
+    async_wait_fn fn = w->fn;
+    void* arg = w->arg;
+    int efd = w->efd;
+    atomic_store_explicit(&w->state, ASYNC_WAIT_DONE, ORDER_RELEASE);
+    if (fn != NULL) {
+        fn(arg);
+    } else if (efd >= 0) {
+        uint64_t one = 1;
+        while (write(efd, &one, sizeof(one)) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+void async_waiter_complete_all(async_waiter* list) {
+    while (list != NULL) {
+        async_waiter* next = list->next;   // 'list' may be reused as soon as it completes
+        async_waiter_complete(list);
+        list = next;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef ASYNC_WAIT_H
+#define ASYNC_WAIT_H
+
+#include <stdatomic.h>
+
+/*
+ * Asynchronous waiters for the semaphores and the condition variable.
+ *
+ * An event-loop thread must not block in semaphore_wait or condition_variable_wait. Instead
+ * it fills an async_waiter and hands it to semaphore_wait_async or
+ * condition_variable_wait_async, which return at once. When the permits are taken on its
+ * behalf, or the signal is delivered to it, the waiter completes in one of two ways:
+ *   - callback: fn(arg) runs on the thread that completed it (a signaler), so it must be
+ *     short and must not block; typically it posts work to the loop,
+ *   - eventfd:  the waiter's eventfd becomes readable, so one epoll loop can watch any
+ *     number of semaphores and condition variables.
+ *
+ * The waiter is owned by the caller and must stay valid until its completion has been
+ * delivered, or until a cancel returned 1. A completed waiter can be armed again.
+ *
+ * Each primitive keeps its async waiters in an async_waitq, a FIFO list behind a short
+ * spinlock. Signalers only look at it when 'count' is non-zero, so primitives that never
+ * see an async waiter pay one atomic load per signal. Async waiting uses pointers and is
+ * therefore only available for process-private primitives.
+ */
+
+typedef void (*async_wait_fn)(void* arg);
+
+enum { ASYNC_WAIT_IDLE, ASYNC_WAIT_PENDING, ASYNC_WAIT_DONE };
+
+typedef struct async_waiter {
+    struct async_waiter* next;
+    int permits;                // permits requested (semaphores only)
+    async_wait_fn fn;           // NULL for eventfd waiters
+    void* arg;
+    int efd;                    // eventfd, -1 for callback waiters
+    atomic_int state;
+} async_waiter;
+
+typedef struct {
+    atomic_flag lock;
+    atomic_int count;           // waiters in the list
+    async_waiter* head;
+    async_waiter* tail;
+} async_waitq;
+
+/*
+ * Prepares 'w' to complete by calling fn(arg).
+ */
+void async_waiter_init_callback(async_waiter* w, async_wait_fn fn, void* arg);
+
+/*
+ * Prepares 'w' to complete through a new non-blocking eventfd.
+ * Returns the descriptor to add to the event loop, or -1 if it could not be created.
+ */
+int async_waiter_init_eventfd(async_waiter* w);
+
+/*
+ * Clears the eventfd after it became readable. Returns 1 if the waiter had completed, 0 if
+ * there was nothing to read.
+ */
+int async_waiter_consume(async_waiter* w);
+
+/*
+ * Returns 1 once the waiter has completed, 0 while it is still queued.
+ */
+int async_waiter_done(async_waiter* w);
+
+/*
+ * Closes the eventfd, if any. The waiter must not be queued.
+ */
+void async_waiter_destroy(async_waiter* w);
+
+/*
+ * Queue operations used by the primitives. Pop, remove and the list scans hold the queue's
+ * spinlock; completion happens after it is released, so a callback may use the primitive.
+ */
+void async_waitq_init(async_waitq* q);
+void async_waitq_lock(async_waitq* q);
+void async_waitq_unlock(async_waitq* q);
+void async_waitq_push(async_waitq* q, async_waiter* w);        // marks 'w' pending
+async_waiter* async_waitq_pop_locked(async_waitq* q);          // NULL when empty
+int async_waitq_remove(async_waitq* q, async_waiter* w);       // 1 if 'w' was still queued
+
+/*
+ * Marks 'w' done and delivers its completion.
+ */
+void async_waiter_complete(async_waiter* w);
+
+/*
+ * Completes a chain of popped waiters linked through 'next'.
+ */
+void async_waiter_complete_all(async_waiter* list);
+
+#endif // ASYNC_WAIT_H
@@ -0,0 +1,236 @@
+/*
+ * lock_stats.c
+ *
+ * Per-instance lock statistics recorded in per-thread shards (compiled only with -DLOCK_STATS).
+ *
+ * Every thread lazily allocates one shard holding a counter block for each registered
+ * instance. Only the owning thread writes its shard, so counters are updated with plain
+ * relaxed loads and stores instead of atomic read-modify-writes. Shards are linked into a
+ * global list and are never freed, so counts of exited threads still appear in dumps.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#ifdef LOCK_STATS
+
+#include "lock_stats.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Counters of one instance inside one thread's shard
+typedef struct {
+    _Atomic uint64_t acquisitions;
+    _Atomic uint64_t contended;
+    _Atomic uint64_t spins;
+    _Atomic uint64_t wait_ns;
+    _Atomic uint64_t max_wait_ns;
+    _Atomic uint64_t hold_ns;
+    uint64_t hold_start_ns;       // private to the owning thread
+} lock_counters_t;
+
+typedef struct lock_shard {
+    struct lock_shard* next;
+    lock_counters_t counters[LOCK_STATS_MAX];
+} lock_shard_t;
+
+// Registry of instances
+typedef struct {
+    const char* kind;
+    const void* obj;
+    const char* name;
+} lock_desc_t;
+
+static lock_desc_t registry[LOCK_STATS_MAX];
+static atomic_int registered = 0;
+static atomic_flag registry_lock = ATOMIC_FLAG_INIT;
+
+static _Atomic(lock_shard_t*) shards = NULL;
+static __thread lock_shard_t* my_shard = NULL;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Bumps a counter owned by the calling thread
+static inline void add(_Atomic uint64_t* c, uint64_t v) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+// Returns the calling thread's shard, allocating and publishing it on first use
+static lock_shard_t* shard(void) {
+    if (my_shard != NULL) {
+        return my_shard;
+    }
+    lock_shard_t* s = calloc(1, sizeof(lock_shard_t));
+    if (s == NULL) {
+        fprintf(stderr, "lock_stats: failed to allocate shard\n");
+        exit(1);
+    }
+    lock_shard_t* head = atomic_load(&shards);
+    do {
+        s->next = head;
+    } while (!atomic_compare_exchange_weak(&shards, &head, s));
+    my_shard = s;
+    return s;
+}
+
+/*
+ * lock_stats_register
+ *
+ * Initialization is not a hot path, so a linear search under a spinlock is fine.
+ */
+int lock_stats_register(const char* kind, const void* obj) {
+    while (atomic_flag_test_and_set(&registry_lock)) {
+        // spin
+    }
+    int n = atomic_load(&registered);
+    int id = -1;
+    for (int i = 0; i < n; i++) {
+        if (registry[i].obj == obj && strcmp(registry[i].kind, kind) == 0) {
+            id = i;
+            break;
+        }
+    }
+    if (id == -1 && n < LOCK_STATS_MAX) {
+        registry[n].kind = kind;
+        registry[n].obj = obj;
+        registry[n].name = NULL;
+        id = n;
+        atomic_store(&registered, n + 1);
+    }
+    atomic_flag_clear(&registry_lock);
+    return id;
+}
+
+void lock_stats_set_name(const void* obj, const char* name) {
+    int n = atomic_load(&registered);
+    for (int i = 0; i < n; i++) {
+        if (registry[i].obj == obj) {
+            registry[i].name = name;
+        }
+    }
+}
+
+lock_stats_wait lock_stats_wait_begin(void) {
+    lock_stats_wait w = { now_ns(), 0 };
+    return w;
+}
+
+/*
+ * lock_stats_acquired
+ *
+ * Records one acquisition, its wait time and whether the caller had to spin.
+ */
+void lock_stats_acquired(int id, const lock_stats_wait* wait) {
+    if (id < 0) {
+        return;
+    }
+    uint64_t now = now_ns();
+    uint64_t waited = now - wait->start_ns;
+    lock_counters_t* c = &shard()->counters[id];
+
+    add(&c->acquisitions, 1);
+    if (wait->spins > 0) {
+        add(&c->contended, 1);
+        add(&c->spins, (uint64_t)wait->spins);
+    }
+    add(&c->wait_ns, waited);
+    if (waited > atomic_load_explicit(&c->max_wait_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&c->max_wait_ns, waited, memory_order_relaxed);
+    }
+    c->hold_start_ns = now;
+}
+
+/*
+ * lock_stats_released
+ *
+ * Adds the time since this thread's last acquisition of the instance to its hold time.
+ */
+void lock_stats_released(int id) {
+    if (id < 0) {
+        return;
+    }
+    lock_counters_t* c = &shard()->counters[id];
+    if (c->hold_start_ns != 0) {
+        add(&c->hold_ns, now_ns() - c->hold_start_ns);
+        c->hold_start_ns = 0;
+    }
+}
+
+void lock_stats_reset(void) {
+    for (lock_shard_t* s = atomic_load(&shards); s != NULL; s = s->next) {
+        for (int i = 0; i < LOCK_STATS_MAX; i++) {
+            lock_counters_t* c = &s->counters[i];
+            atomic_store_explicit(&c->acquisitions, 0, memory_order_relaxed);
+            atomic_store_explicit(&c->contended, 0, memory_order_relaxed);
+            atomic_store_explicit(&c->spins, 0, memory_order_relaxed);
+            atomic_store_explicit(&c->wait_ns, 0, memory_order_relaxed);
+            atomic_store_explicit(&c->max_wait_ns, 0, memory_order_relaxed);
+            atomic_store_explicit(&c->hold_ns, 0, memory_order_relaxed);
+        }
+    }
+}
+
+/*
+ * lock_stats_dump
+ *
+ * Sums every shard per instance and prints instances with at least one acquisition.
+ */
+void lock_stats_dump(FILE* out, int format) {
+    int n = atomic_load(&registered);
+    int first = 1;
+
+    if (format == LOCK_STATS_JSON) {
+        fprintf(out, "[");
+    } else {
+        fprintf(out, "%-20s %-18s %-16s %12s %12s %14s %16s %14s %16s\n",
+                "kind", "instance", "name", "acquisitions", "contended", "spins",
+                "wait_total_ns", "wait_max_ns", "hold_total_ns");
+    }
+
+    for (int i = 0; i < n; i++) {
+        uint64_t acq = 0, cont = 0, spins = 0, wait = 0, max_wait = 0, hold = 0;
+        for (lock_shard_t* s = atomic_load(&shards); s != NULL; s = s->next) {
+            lock_counters_t* c = &s->counters[i];
+            acq += atomic_load_explicit(&c->acquisitions, memory_order_relaxed);
+            cont += atomic_load_explicit(&c->contended, memory_order_relaxed);
+            spins += atomic_load_explicit(&c->spins, memory_order_relaxed);
+            wait += atomic_load_explicit(&c->wait_ns, memory_order_relaxed);
+            hold += atomic_load_explicit(&c->hold_ns, memory_order_relaxed);
+            uint64_t m = atomic_load_explicit(&c->max_wait_ns, memory_order_relaxed);
+            if (m > max_wait) {
+                max_wait = m;
+            }
+        }
+        if (acq == 0) {
+            continue;
+        }
+
+        const char* name = registry[i].name ? registry[i].name : "";
+        if (format == LOCK_STATS_JSON) {
+            fprintf(out, "%s\n  {\"kind\": \"%s\", \"instance\": \"%p\", \"name\": \"%s\", "
+                         "\"acquisitions\": %llu, \"contended\": %llu, \"spins\": %llu, "
+                         "\"wait_total_ns\": %llu, \"wait_max_ns\": %llu, \"hold_total_ns\": %llu}",
+                    first ? "" : ",", registry[i].kind, registry[i].obj, name,
+                    (unsigned long long)acq, (unsigned long long)cont, (unsigned long long)spins,
+                    (unsigned long long)wait, (unsigned long long)max_wait, (unsigned long long)hold);
+        } else {
+            fprintf(out, "%-20s %-18p %-16s %12llu %12llu %14llu %16llu %14llu %16llu\n",
+                    registry[i].kind, registry[i].obj, name,
+                    (unsigned long long)acq, (unsigned long long)cont, (unsigned long long)spins,
+                    (unsigned long long)wait, (unsigned long long)max_wait, (unsigned long long)hold);
+        }
+        first = 0;
+    }
+
+    if (format == LOCK_STATS_JSON) {
+        fprintf(out, "\n]\n");
+    }
+}
+
+#endif // LOCK_STATS
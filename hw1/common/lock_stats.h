@@ -0,0 +1,92 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include <stdio.h>
+
+/*
+ * Compile-time lock contention instrumentation.
+ *
+ * Build with -DLOCK_STATS (and link common/lock_stats.c) to record, for every instance of
+ * ticket_lock, both semaphores, condition_variable and rwlock:
+ *   acquisitions, contended acquisitions, spin/yield iterations,
+ *   total and maximum wait time, total hold time.
+ * Without LOCK_STATS every hook below expands to nothing and the API functions are no-ops,
+ * so the primitives compile to exactly the same code as before.
+ *
+ * Counters live in per-thread shards and are only summed when dumped, so recording never
+ * writes to a cache line shared with another thread.
+ *
+ * The registry is per process. Process-shared instances are attributed correctly in the
+ * process that initialized them and in children forked after that, not in processes that
+ * attach to the shared memory independently.
+ */
+
+#define LOCK_STATS_TEXT 0
+#define LOCK_STATS_JSON 1
+
+#ifndef LOCK_STATS_MAX
+#define LOCK_STATS_MAX 1024   // instances that can be tracked per process
+#endif
+
+#ifdef LOCK_STATS
+
+#include <stdint.h>
+
+/*
+ * State of one in-progress acquire, kept on the caller's stack.
+ */
+typedef struct {
+    uint64_t start_ns;
+    long spins;
+} lock_stats_wait;
+
+/*
+ * Registers an instance and returns its id (re-initializing the same object reuses its id).
+ * Returns -1 once LOCK_STATS_MAX instances are registered; such instances are not tracked.
+ */
+int lock_stats_register(const char* kind, const void* obj);
+
+lock_stats_wait lock_stats_wait_begin(void);
+void lock_stats_acquired(int id, const lock_stats_wait* wait);
+void lock_stats_released(int id);
+
+/*
+ * Gives a registered instance a human readable name used by lock_stats_dump.
+ */
+void lock_stats_set_name(const void* obj, const char* name);
+
+/*
+ * Writes the summed statistics of every instance that was acquired at least once,
+ * as a text table (LOCK_STATS_TEXT) or a JSON array (LOCK_STATS_JSON).
+ */
+void lock_stats_dump(FILE* out, int format);
+
+/*
+ * Zeroes every counter. Intended for quiescent points (between benchmark phases).
+ */
+void lock_stats_reset(void);
+
+// Hooks used inside the primitives
+#define LOCK_STATS_FIELD              int stats_id;
+#define LOCK_STATS_INIT(obj, kind)    ((obj)->stats_id = lock_stats_register((kind), (obj)))
+#define LOCK_STATS_BEGIN(st)          lock_stats_wait st = lock_stats_wait_begin()
+#define LOCK_STATS_SPIN(st)           ((st).spins++)
+#define LOCK_STATS_ACQUIRED(obj, st)  lock_stats_acquired((obj)->stats_id, &(st))
+#define LOCK_STATS_RELEASED(obj)      lock_stats_released((obj)->stats_id)
+
+#else // !LOCK_STATS
+
+static inline void lock_stats_set_name(const void* obj, const char* name) { (void)obj; (void)name; }
+static inline void lock_stats_dump(FILE* out, int format) { (void)out; (void)format; }
+static inline void lock_stats_reset(void) {}
+
+#define LOCK_STATS_FIELD
+#define LOCK_STATS_INIT(obj, kind)    ((void)0)
+#define LOCK_STATS_BEGIN(st)          ((void)0)
+#define LOCK_STATS_SPIN(st)           ((void)0)
+#define LOCK_STATS_ACQUIRED(obj, st)  ((void)0)
+#define LOCK_STATS_RELEASED(obj)      ((void)0)
+
+#endif // LOCK_STATS
+
+#endif // LOCK_STATS_H
@@ -0,0 +1,220 @@
+/*
+ * lock_trace.c
+ *
+ * Per-thread lock event rings and the Chrome trace_event exporter.
+ *
+ * Every thread lazily allocates a ring of LOCK_TRACE_RING events and links it into a global
+ * list. Appending is a slot write followed by a release store of the ring head, no atomic
+ * read-modify-write and nothing shared with other threads. Rings are never freed, so events
+ * of exited threads are still exported.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "lock_trace.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_OPEN 64   // locks a thread can be waiting on or holding at the same time
+
+static const char* kind_names[] = { "ticket_lock", "rwlock_read", "rwlock_write", "condition_variable" };
+
+// An interval that has started but not ended yet while converting one thread's events
+typedef struct {
+    uint64_t obj;
+    uint16_t kind;
+    uint64_t wait_ts;   // 0 if not waiting
+    uint64_t hold_ts;   // 0 if not holding
+} open_interval;
+
+static void emit(FILE* out, int* first, const char* phase, uint16_t kind, uint64_t obj,
+                 uint32_t tid, uint64_t start, uint64_t end) {
+    fprintf(out, "%s\n  {\"name\": \"%s %s@0x%llx\", \"cat\": \"%s\", \"ph\": \"X\", "
+                 "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %u}",
+            *first ? "" : ",", phase, kind_names[kind], (unsigned long long)obj,
+            phase, start / 1000.0, (end - start) / 1000.0, tid);
+    *first = 0;
+}
+
+/*
+ * lock_trace_events_to_chrome
+ *
+ * Walks each thread's events in order, pairing WAIT with the following ACQUIRED and
+ * ACQUIRED with the following RELEASED of the same object. Pairs become "wait ..." and
+ * "hold ..." complete events. An ACQUIRED with no WAIT before it, as the try paths record,
+ * still opens a hold. Events whose partner was overwritten in the ring are dropped.
+ */
+void lock_trace_events_to_chrome(const lock_trace_event* events, long count, FILE* out) {
+    open_interval open[MAX_OPEN];
+    int nopen = 0;
+    uint32_t cur_tid = 0;
+    int first = 1;
+
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+    for (long i = 0; i < count; i++) {
+        const lock_trace_event* e = &events[i];
+        if (e->tid != cur_tid) {
+            // new thread: forget unfinished intervals of the previous one, name the track
+            cur_tid = e->tid;
+            nopen = 0;
+            fprintf(out, "%s\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                         "\"args\": {\"name\": \"thread %u\"}}", first ? "" : ",", cur_tid, cur_tid);
+            first = 0;
+        }
+        if (e->kind >= sizeof(kind_names) / sizeof(kind_names[0])) {
+            continue;
+        }
+
+        int k = nopen - 1;
+        while (k >= 0 && !(open[k].obj == e->obj && open[k].kind == e->kind)) {
+            k--;
+        }
+
+        switch (e->type) {
+        case LOCK_TRACE_WAIT:
+            if (k < 0) {
+                if (nopen == MAX_OPEN) {
+                    break;
+                }
+                k = nopen++;
+                open[k].obj = e->obj;
+                open[k].kind = e->kind;
+                open[k].hold_ts = 0;
+            }
+            open[k].wait_ts = e->ts_ns;
+            break;
+        case LOCK_TRACE_ACQUIRED:
+            // try paths acquire without a WAIT: no wait interval, but the hold still counts
+            if (k < 0 && e->kind != LOCK_TRACE_CONDVAR && nopen < MAX_OPEN) {
+                k = nopen++;
+                open[k].obj = e->obj;
+                open[k].kind = e->kind;
+                open[k].wait_ts = 0;
+                open[k].hold_ts = e->ts_ns;
+                break;
+            }
+            if (k < 0 || open[k].wait_ts == 0) {
+                break;
+            }
+            emit(out, &first, "wait", e->kind, e->obj, e->tid, open[k].wait_ts, e->ts_ns);
+            open[k].wait_ts = 0;
+            if (e->kind == LOCK_TRACE_CONDVAR) {
+                open[k] = open[--nopen]; // being woken ends the cv interval
+            } else {
+                open[k].hold_ts = e->ts_ns;
+            }
+            break;
+        case LOCK_TRACE_RELEASED:
+            if (k < 0 || open[k].hold_ts == 0) {
+                break;
+            }
+            emit(out, &first, "hold", e->kind, e->obj, e->tid, open[k].hold_ts, e->ts_ns);
+            open[k] = open[--nopen];
+            break;
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+}
+
+#ifdef LOCK_TRACE
+
+typedef struct lock_ring {
+    struct lock_ring* next;
+    uint32_t tid;
+    atomic_ulong head;    // total events ever appended
+    lock_trace_event events[LOCK_TRACE_RING];
+} lock_ring_t;
+
+static _Atomic(lock_ring_t*) rings = NULL;
+static atomic_uint next_tid = 1;
+static __thread lock_ring_t* my_ring = NULL;
+
+// Returns the calling thread's ring, allocating and publishing it on first use
+static lock_ring_t* ring(void) {
+    if (my_ring != NULL) {
+        return my_ring;
+    }
+    lock_ring_t* r = malloc(sizeof(lock_ring_t));
+    if (r == NULL) {
+        fprintf(stderr, "lock_trace: failed to allocate ring\n");
+        exit(1);
+    }
+    r->tid = atomic_fetch_add(&next_tid, 1);
+    atomic_init(&r->head, 0);
+    lock_ring_t* head = atomic_load(&rings);
+    do {
+        r->next = head;
+    } while (!atomic_compare_exchange_weak(&rings, &head, r));
+    my_ring = r;
+    return r;
+}
+
+void lock_trace_record(const void* obj, lock_trace_kind kind, lock_trace_type type) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    lock_ring_t* r = ring();
+    unsigned long h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    lock_trace_event* e = &r->events[h & (LOCK_TRACE_RING - 1)];
+    e->ts_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    e->obj = (uint64_t)(uintptr_t)obj;
+    e->tid = r->tid;
+    e->kind = (uint16_t)kind;
+    e->type = (uint16_t)type;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+// Copies every ring, oldest event first, into one array grouped by thread
+static lock_trace_event* collect(long* count) {
+    long total = 0;
+    for (lock_ring_t* r = atomic_load(&rings); r != NULL; r = r->next) {
+        unsigned long h = atomic_load_explicit(&r->head, memory_order_acquire);
+        total += h < LOCK_TRACE_RING ? (long)h : LOCK_TRACE_RING;
+    }
+
+    lock_trace_event* all = malloc(sizeof(lock_trace_event) * (total ? total : 1));
+    if (all == NULL) {
+        return NULL;
+    }
+    long n = 0;
+    for (lock_ring_t* r = atomic_load(&rings); r != NULL && n < total; r = r->next) {
+        unsigned long h = atomic_load_explicit(&r->head, memory_order_acquire);
+        unsigned long start = h < LOCK_TRACE_RING ? 0 : h - LOCK_TRACE_RING;
+        for (unsigned long i = start; i < h && n < total; i++) {
+            all[n++] = r->events[i & (LOCK_TRACE_RING - 1)];
+        }
+    }
+    *count = n;
+    return all;
+}
+
+int lock_trace_write(FILE* out) {
+    long count = 0;
+    lock_trace_event* all = collect(&count);
+    if (all == NULL) {
+        return -1;
+    }
+    uint32_t header[2] = { LOCK_TRACE_MAGIC, LOCK_TRACE_VERSION };
+    uint64_t n = (uint64_t)count;
+    int ok = fwrite(header, sizeof(header), 1, out) == 1 &&
+             fwrite(&n, sizeof(n), 1, out) == 1 &&
+             (count == 0 || fwrite(all, sizeof(lock_trace_event), count, out) == (size_t)count);
+    free(all);
+    return ok ? 0 : -1;
+}
+
+void lock_trace_export_chrome(FILE* out) {
+    long count = 0;
+    lock_trace_event* all = collect(&count);
+    if (all == NULL) {
+        fprintf(stderr, "lock_trace: failed to allocate export buffer\n");
+        return;
+    }
+    lock_trace_events_to_chrome(all, count, out);
+    free(all);
+}
+
+#endif // LOCK_TRACE
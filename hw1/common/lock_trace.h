@@ -0,0 +1,92 @@
+#ifndef LOCK_TRACE_H
+#define LOCK_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Optional lock handoff tracing.
+ *
+ * Build with -DLOCK_TRACE (and link common/lock_trace.c) to make ticket_lock, rwlock and
+ * condition_variable log when a thread starts waiting, when it gets the lock (or is woken)
+ * and when it releases it. Each thread appends fixed-size binary events with CLOCK_MONOTONIC
+ * timestamps to its own ring buffer, so tracing never adds a shared cache line to the
+ * primitive. When the ring is full the oldest events are overwritten.
+ *
+ * The rings can be written to a binary file (lock_trace_write) and converted offline with
+ * tools/trace2chrome, or exported directly as Chrome trace_event JSON (chrome://tracing,
+ * Perfetto). Without LOCK_TRACE every hook expands to nothing.
+ */
+
+#ifndef LOCK_TRACE_RING
+#define LOCK_TRACE_RING (1 << 16)   // events per thread, must be a power of two
+#endif
+
+#define LOCK_TRACE_MAGIC   0x52544b4cu   // "LKTR"
+#define LOCK_TRACE_VERSION 1
+
+/*
+ * What the event refers to.
+ */
+typedef enum {
+    LOCK_TRACE_TICKET_LOCK = 0,
+    LOCK_TRACE_RWLOCK_READ = 1,
+    LOCK_TRACE_RWLOCK_WRITE = 2,
+    LOCK_TRACE_CONDVAR = 3,
+} lock_trace_kind;
+
+/*
+ * What happened.
+ */
+typedef enum {
+    LOCK_TRACE_WAIT = 0,       // started waiting
+    LOCK_TRACE_ACQUIRED = 1,   // got the lock / was woken
+    LOCK_TRACE_RELEASED = 2,   // released the lock
+} lock_trace_type;
+
+/*
+ * One trace event, as stored in the rings and in the binary file.
+ */
+typedef struct {
+    uint64_t ts_ns;
+    uint64_t obj;
+    uint32_t tid;       // small per-process thread number, starting at 1
+    uint16_t kind;
+    uint16_t type;
+} lock_trace_event;
+
+/*
+ * Converts events (grouped per thread, in recording order) to Chrome trace_event JSON.
+ * Wait and hold intervals become complete ("X") events on the thread's track.
+ * Available in every build so that offline tools can use it.
+ */
+void lock_trace_events_to_chrome(const lock_trace_event* events, long count, FILE* out);
+
+#ifdef LOCK_TRACE
+
+void lock_trace_record(const void* obj, lock_trace_kind kind, lock_trace_type type);
+
+/*
+ * Writes every thread's ring to 'out' in the binary format read by tools/trace2chrome.
+ * Intended for quiescent points; events recorded concurrently may be torn.
+ * Returns 0 on success, -1 on a write error.
+ */
+int lock_trace_write(FILE* out);
+
+/*
+ * Exports every thread's ring as Chrome trace_event JSON.
+ */
+void lock_trace_export_chrome(FILE* out);
+
+#define LOCK_TRACE_EVENT(obj, kind, type) lock_trace_record((obj), (kind), (type))
+
+#else // !LOCK_TRACE
+
+static inline int lock_trace_write(FILE* out) { (void)out; return 0; }
+static inline void lock_trace_export_chrome(FILE* out) { (void)out; }
+
+#define LOCK_TRACE_EVENT(obj, kind, type) ((void)0)
+
+#endif // LOCK_TRACE
+
+#endif // LOCK_TRACE_H
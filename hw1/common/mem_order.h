@@ -0,0 +1,55 @@
+#ifndef MEM_ORDER_H
+#define MEM_ORDER_H
+
+#include <stdatomic.h>
+
+/*
+ * Memory orders used by the primitives of tasks 1-6.
+ *
+ * Every atomic in the primitives names the weakest order that is correct for it:
+ *   ORDER_ACQUIRE  loads that take a lock, a turn or a permit (spin-loop reads included),
+ *   ORDER_RELEASE  stores that hand them back,
+ *   ORDER_ACQ_REL  read-modify-writes that do both,
+ *   ORDER_RELAXED  ticket dispensers, statistics and re-checks already ordered by an
+ *                  acquire or release next to them.
+ * The one place that needs more is the futex park handshake, see ORDER_HANDSHAKE_LOAD.
+ *
+ * Build with -DFORCE_SEQ_CST to turn every one of them back into memory_order_seq_cst,
+ * e.g. to compare against the orderings in bench/ordering_bench.c or to rule them out
+ * while debugging. Code that was written with explicit orders from the start (ws_deque,
+ * prio_lanes, flat combining, epochs) names memory_order_* directly and is not affected.
+ */
+
+#ifdef FORCE_SEQ_CST
+
+#define ORDER_RELAXED memory_order_seq_cst
+#define ORDER_ACQUIRE memory_order_seq_cst
+#define ORDER_RELEASE memory_order_seq_cst
+#define ORDER_ACQ_REL memory_order_seq_cst
+#define ORDER_NAME "seq_cst"
+
+// A sequentially consistent store is never reordered with a later sequentially consistent load
+#define ORDER_HANDSHAKE_LOAD(counter) atomic_load(counter)
+
+#else
+
+#define ORDER_RELAXED memory_order_relaxed
+#define ORDER_ACQUIRE memory_order_acquire
+#define ORDER_RELEASE memory_order_release
+#define ORDER_ACQ_REL memory_order_acq_rel
+#define ORDER_NAME "acq_rel"
+
+/*
+ * A waker publishes its store and then reads the sleeper count; a sleeper increments the
+ * count and then the kernel reads the word. Release and acquire alone let the store slip
+ * past the later load, so the waker reads the count with an acq_rel read-modify-write.
+ * The two read-modify-writes of the count are ordered: if the waker's comes first, the
+ * sleeper's increment synchronizes with it and the kernel sees the new word; otherwise the
+ * waker reads a count that includes the sleeper. On x86 this single locked add is also
+ * cheaper than a plain store followed by a fence.
+ */
+#define ORDER_HANDSHAKE_LOAD(counter) atomic_fetch_add_explicit(counter, 0, memory_order_acq_rel)
+
+#endif
+
+#endif // MEM_ORDER_H
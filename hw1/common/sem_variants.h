@@ -0,0 +1,60 @@
+#ifndef SEM_VARIANTS_H
+#define SEM_VARIANTS_H
+
+/*
+ * task1 and task2 both define a type named 'semaphore' and functions named semaphore_*,
+ * so they cannot be linked into the same program. Including this header (instead of
+ * either semaphore header, and without linking their .c files) compiles both
+ * implementations into the including translation unit under prefixed names:
+ *
+ *   tas_semaphore, tas_semaphore_init, tas_semaphore_wait, ...   (task1, test-and-set)
+ *   tl_semaphore,  tl_semaphore_init,  tl_semaphore_wait,  ...   (task2, ticket lock)
+ *
+ * Include it from exactly one .c file per program.
+ */
+
+#define semaphore              tas_semaphore
+#define semaphore_init         tas_semaphore_init
+#define semaphore_init_shared  tas_semaphore_init_shared
+#define semaphore_wait         tas_semaphore_wait
+#define semaphore_signal       tas_semaphore_signal
+#define semaphore_wait_n       tas_semaphore_wait_n
+#define semaphore_try_wait_n   tas_semaphore_try_wait_n
+#define semaphore_signal_n     tas_semaphore_signal_n
+#define semaphore_wait_async   tas_semaphore_wait_async
+#define semaphore_cancel_async tas_semaphore_cancel_async
+#include "../task1/tas_semaphore.c"
+#undef semaphore
+#undef semaphore_init
+#undef semaphore_init_shared
+#undef semaphore_wait
+#undef semaphore_signal
+#undef semaphore_wait_n
+#undef semaphore_try_wait_n
+#undef semaphore_signal_n
+#undef semaphore_wait_async
+#undef semaphore_cancel_async
+
+#define semaphore              tl_semaphore
+#define semaphore_init         tl_semaphore_init
+#define semaphore_init_shared  tl_semaphore_init_shared
+#define semaphore_wait         tl_semaphore_wait
+#define semaphore_signal       tl_semaphore_signal
+#define semaphore_wait_n       tl_semaphore_wait_n
+#define semaphore_try_wait_n   tl_semaphore_try_wait_n
+#define semaphore_signal_n     tl_semaphore_signal_n
+#define semaphore_wait_async   tl_semaphore_wait_async
+#define semaphore_cancel_async tl_semaphore_cancel_async
+#include "../task2/tl_semaphore.c"
+#undef semaphore
+#undef semaphore_init
+#undef semaphore_init_shared
+#undef semaphore_wait
+#undef semaphore_signal
+#undef semaphore_wait_n
+#undef semaphore_try_wait_n
+#undef semaphore_signal_n
+#undef semaphore_wait_async
+#undef semaphore_cancel_async
+
+#endif // SEM_VARIANTS_H
@@ -0,0 +1,128 @@
+/*
+ * sharded_counter.c
+ *
+ * Implementation of the sharded counter.
+ *
+ * Switching to precise mode races with adds that already chose their cell. Both sides use
+ * sequentially consistent operations: an add writes its cell and then reads 'precise', the
+ * switcher writes 'precise' and then sums the cells. Either the add sees precise mode and
+ * checks the threshold itself, or the switcher's sum includes the add.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "sharded_counter.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static atomic_int next_slot = 0;
+static __thread int my_slot = -1;
+
+// Cells are handed out to threads round-robin on first use, shared only beyond ncells threads
+static counter_cell* my_cell(sharded_counter* counter) {
+    if (my_slot < 0) {
+        my_slot = atomic_fetch_add(&next_slot, 1);
+    }
+    return &counter->cells[my_slot & (counter->ncells - 1)];
+}
+
+int sharded_counter_init(sharded_counter* counter, long batch) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int ncells = 1;
+    while (ncells < cpus && ncells < 1024) {
+        ncells <<= 1;
+    }
+
+    counter->cells = aligned_alloc(SHARDED_COUNTER_CACHE_LINE, sizeof(counter_cell) * ncells);
+    if (counter->cells == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < ncells; i++) {
+        atomic_init(&counter->cells[i].value, 0);
+    }
+    counter->ncells = ncells;
+    counter->batch = batch > 0 ? batch : SHARDED_COUNTER_BATCH;
+    atomic_init(&counter->total, 0);
+    atomic_init(&counter->precise, 0);
+    atomic_init(&counter->reached, 0);
+    atomic_init(&counter->parked, 0);
+    wait_policy_default(&counter->policy);
+    sharded_counter_set_threshold(counter, LONG_MAX);
+    return 0;
+}
+
+void sharded_counter_set_threshold(sharded_counter* counter, long threshold) {
+    long slack = counter->ncells * counter->batch;
+    counter->threshold = threshold;
+    counter->precise_at = threshold > LONG_MIN + slack ? threshold - slack : LONG_MIN;
+    atomic_store(&counter->precise, threshold != LONG_MAX && counter->precise_at <= 0);
+}
+
+void sharded_counter_destroy(sharded_counter* counter) {
+    free(counter->cells);
+    counter->cells = NULL;
+}
+
+// Sets 'reached' if the exact value is at the threshold. Returns 1 for the call that set it.
+static int check_threshold(sharded_counter* counter) {
+    if (atomic_load(&counter->reached) || sharded_counter_read(counter) < counter->threshold) {
+        return 0;
+    }
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&counter->reached, &expected, 1)) {
+        return 0;
+    }
+    wait_wake(&counter->policy, &counter->reached, &counter->parked, INT_MAX);
+    return 1;
+}
+
+/*
+ * sharded_counter_add
+ *
+ * Fast path: one add to the thread's own cell. Every 'batch' units the cell is drained
+ * into the total, and that is also when the distance to the threshold is checked.
+ */
+int sharded_counter_add(sharded_counter* counter, long delta) {
+    if (atomic_load(&counter->precise)) {
+        atomic_fetch_add(&counter->total, delta);
+        return check_threshold(counter);
+    }
+
+    counter_cell* cell = my_cell(counter);
+    long value = atomic_fetch_add(&cell->value, delta) + delta;
+    if (value >= counter->batch || value <= -counter->batch) {
+        value = atomic_exchange(&cell->value, 0);
+        long total = atomic_fetch_add(&counter->total, value) + value;
+        if (total >= counter->precise_at) {
+            atomic_store(&counter->precise, 1);
+        }
+    }
+    if (!atomic_load(&counter->precise)) {
+        return 0;
+    }
+    return check_threshold(counter);
+}
+
+long sharded_counter_read_approx(sharded_counter* counter) {
+    return atomic_load_explicit(&counter->total, memory_order_relaxed);
+}
+
+long sharded_counter_read(sharded_counter* counter) {
+    long sum = atomic_load(&counter->total);
+    for (int i = 0; i < counter->ncells; i++) {
+        sum += atomic_load(&counter->cells[i].value);
+    }
+    return sum;
+}
+
+int sharded_counter_reached(sharded_counter* counter) {
+    return atomic_load(&counter->reached);
+}
+
+void sharded_counter_wait(sharded_counter* counter) {
+    wait_state ws = WAIT_STATE_INIT;
+    while (!atomic_load(&counter->reached)) {
+        wait_pause(&counter->policy, &ws, &counter->reached, 0, &counter->parked);
+    }
+}
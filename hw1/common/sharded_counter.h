@@ -0,0 +1,86 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <stdatomic.h>
+#include "wait_policy.h"
+
+#define SHARDED_COUNTER_CACHE_LINE 64
+#define SHARDED_COUNTER_BATCH 64   // default per-cell delta folded into the total at once
+
+/*
+ * One cell per thread slot, each on its own cache line.
+ */
+typedef struct {
+    _Alignas(SHARDED_COUNTER_CACHE_LINE) atomic_long value;
+} counter_cell;
+
+/*
+ * Define the sharded counter type.
+ *
+ * Every thread adds to its own cell. Once a cell has collected 'batch', its content is
+ * folded into 'total' with one atomic add. So the shared line is written once per
+ * 'batch' increments instead of on every one, and 'total' alone is an approximate value
+ * that lags by less than ncells * batch.
+ *
+ * A threshold turns the counter into a completion signal. While 'total' is far from it,
+ * adds stay in the cells. Once it comes within ncells * batch, the counter switches to
+ * precise mode: adds go straight to 'total' and compare the exact sum with the threshold.
+ * The add that reaches it sets 'reached' and wakes sharded_counter_wait.
+ * Thresholds assume the counter only grows.
+ */
+typedef struct {
+    int ncells;                 // power of two
+    long batch;
+    counter_cell* cells;
+    long threshold;
+    long precise_at;            // threshold - ncells * batch
+    _Alignas(SHARDED_COUNTER_CACHE_LINE) atomic_long total;
+    _Alignas(SHARDED_COUNTER_CACHE_LINE) atomic_int precise;
+    atomic_int reached;
+    atomic_int parked;
+    wait_policy policy;
+} sharded_counter;
+
+/*
+ * Initializes a zero counter with one cell per online CPU (rounded up to a power of two).
+ * 'batch' <= 0 selects SHARDED_COUNTER_BATCH; 1 makes the approximate read exact.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int sharded_counter_init(sharded_counter* counter, long batch);
+
+/*
+ * Sets the value at which the counter is considered reached. Call before the first add.
+ */
+void sharded_counter_set_threshold(sharded_counter* counter, long threshold);
+
+/*
+ * Frees the cells. No thread may be using the counter.
+ */
+void sharded_counter_destroy(sharded_counter* counter);
+
+/*
+ * Adds 'delta'. Returns 1 if this call made the counter reach its threshold, 0 otherwise.
+ */
+int sharded_counter_add(sharded_counter* counter, long delta);
+
+/*
+ * Cheap read: the folded total only, one load of one cache line.
+ */
+long sharded_counter_read_approx(sharded_counter* counter);
+
+/*
+ * Exact read: the total plus every cell. Exact when no add runs concurrently.
+ */
+long sharded_counter_read(sharded_counter* counter);
+
+/*
+ * Returns 1 once the threshold was reached. One load of a line written once.
+ */
+int sharded_counter_reached(sharded_counter* counter);
+
+/*
+ * Blocks, following the counter's wait policy, until the threshold is reached.
+ */
+void sharded_counter_wait(sharded_counter* counter);
+
+#endif // SHARDED_COUNTER_H
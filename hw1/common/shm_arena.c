@@ -0,0 +1,156 @@
+/*
+ * shm_arena.c
+ *
+ * Bump allocator over a MAP_SHARED mapping. The first cache line of the mapping is a
+ * header with a magic number, the total size, the allocation offset and the root offset;
+ * everything in it is an offset, so the header is valid at any mapping address.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "shm_arena.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_ARENA_MAGIC 0x414e5241u   // "ARNA"
+
+typedef struct {
+    _Atomic uint32_t magic;   // written last by the creator
+    uint32_t reserved;
+    uint64_t size;
+    _Atomic uint64_t used;   // offset of the first free byte
+    _Atomic uint64_t root;   // offset of the root object, 0 if not set
+} arena_header;
+
+_Static_assert(sizeof(arena_header) <= SHM_ARENA_ALIGN, "arena header must fit one cache line");
+
+static arena_header* header(const shm_arena* arena) {
+    return (arena_header*)arena->base;
+}
+
+int shm_arena_create(shm_arena* arena, const char* name, size_t size) {
+    size = (size + SHM_ARENA_ALIGN - 1) & ~(size_t)(SHM_ARENA_ALIGN - 1);
+    if (size < SHM_ARENA_ALIGN) {
+        size = SHM_ARENA_ALIGN;
+    }
+
+    void* base;
+    if (name == NULL) {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        arena->name[0] = '\0';
+    } else {
+        if (strlen(name) >= SHM_ARENA_NAME_MAX) {
+            return -1;
+        }
+        shm_unlink(name); // start from an empty object, not a stale one
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            return -1;
+        }
+        if (ftruncate(fd, (off_t)size) != 0) {
+            close(fd);
+            shm_unlink(name);
+            return -1;
+        }
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        strcpy(arena->name, name);
+    }
+    if (base == MAP_FAILED) {
+        if (name != NULL) {
+            shm_unlink(name);
+        }
+        return -1;
+    }
+
+    arena->base = base;
+    arena->size = size;
+    arena_header* h = header(arena);
+    h->size = size;
+    atomic_init(&h->used, SHM_ARENA_ALIGN);
+    atomic_init(&h->root, 0);
+    atomic_store_explicit(&h->magic, SHM_ARENA_MAGIC, memory_order_release);
+    return 0;
+}
+
+int shm_arena_attach(shm_arena* arena, const char* name) {
+    if (strlen(name) >= SHM_ARENA_NAME_MAX) {
+        return -1;
+    }
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SHM_ARENA_ALIGN) {
+        close(fd);
+        return -1;
+    }
+    void* base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+
+    arena_header* h = (arena_header*)base;
+    if (atomic_load_explicit(&h->magic, memory_order_acquire) != SHM_ARENA_MAGIC ||
+        h->size != (uint64_t)st.st_size) {
+        munmap(base, (size_t)st.st_size);
+        return -1;
+    }
+    strcpy(arena->name, name);
+    arena->base = base;
+    arena->size = (size_t)st.st_size;
+    return 0;
+}
+
+/*
+ * shm_arena_alloc
+ *
+ * A CAS loop on the shared offset, so allocations from different processes never overlap.
+ * Fresh pages of a shared mapping are already zero, so no memset is needed.
+ */
+void* shm_arena_alloc(shm_arena* arena, size_t size) {
+    arena_header* h = header(arena);
+    size = (size + SHM_ARENA_ALIGN - 1) & ~(size_t)(SHM_ARENA_ALIGN - 1);
+    uint64_t used = atomic_load(&h->used);
+    do {
+        if (size > h->size - used) {
+            return NULL;
+        }
+    } while (!atomic_compare_exchange_weak(&h->used, &used, used + size));
+    return (char*)arena->base + used;
+}
+
+size_t shm_arena_offset(const shm_arena* arena, const void* ptr) {
+    return (size_t)((const char*)ptr - (const char*)arena->base);
+}
+
+void* shm_arena_ptr(const shm_arena* arena, size_t offset) {
+    return (char*)arena->base + offset;
+}
+
+void shm_arena_set_root(shm_arena* arena, void* root) {
+    atomic_store(&header(arena)->root, shm_arena_offset(arena, root));
+}
+
+void* shm_arena_root(const shm_arena* arena) {
+    uint64_t root = atomic_load(&header(arena)->root);
+    return root == 0 ? NULL : shm_arena_ptr(arena, root);
+}
+
+void shm_arena_detach(shm_arena* arena) {
+    if (arena->base != NULL) {
+        munmap(arena->base, arena->size);
+        arena->base = NULL;
+        arena->size = 0;
+    }
+}
+
+int shm_arena_unlink(const char* name) {
+    return shm_unlink(name);
+}
@@ -0,0 +1,75 @@
+#ifndef SHM_ARENA_H
+#define SHM_ARENA_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Shared-memory arena for process-shared primitives.
+ *
+ * One process creates the arena (a named POSIX shared memory object, or an anonymous
+ * MAP_SHARED mapping that is inherited across fork), carves objects out of it with
+ * shm_arena_alloc and initializes them with the *_init_shared functions. Other processes
+ * attach by name, or simply inherit the mapping, and use the objects directly.
+ *
+ * The region may be mapped at a different address in every process, so anything stored
+ * inside it must refer to other objects in the arena by offset (shm_arena_offset /
+ * shm_arena_ptr), never by pointer. The root offset gives attaching processes a starting
+ * point, typically a struct that holds all the shared objects.
+ */
+
+#define SHM_ARENA_ALIGN 64      // every allocation starts on its own cache line
+#define SHM_ARENA_NAME_MAX 64
+
+/*
+ * Per-process handle to a mapped arena. Lives in private memory.
+ */
+typedef struct {
+    char name[SHM_ARENA_NAME_MAX];  // empty for anonymous arenas
+    void* base;
+    size_t size;
+} shm_arena;
+
+/*
+ * Creates an arena of 'size' bytes (header included). 'name' is a shm_open name such as
+ * "/cp_pattern"; an existing object of that name is replaced. name == NULL creates an
+ * anonymous arena shared only with children forked afterwards.
+ * Returns 0 on success, -1 on failure (errno is set).
+ */
+int shm_arena_create(shm_arena* arena, const char* name, size_t size);
+
+/*
+ * Maps an arena created by another process. Returns 0 on success, -1 on failure
+ * (including when the object is not an arena).
+ */
+int shm_arena_attach(shm_arena* arena, const char* name);
+
+/*
+ * Allocates 'size' zeroed bytes, aligned to SHM_ARENA_ALIGN. Safe to call concurrently
+ * from any process. Memory is never freed individually. Returns NULL when the arena is full.
+ */
+void* shm_arena_alloc(shm_arena* arena, size_t size);
+
+/*
+ * Converts between pointers valid in this process and offsets valid in all of them.
+ */
+size_t shm_arena_offset(const shm_arena* arena, const void* ptr);
+void* shm_arena_ptr(const shm_arena* arena, size_t offset);
+
+/*
+ * Publishes / looks up the arena's root object. shm_arena_root returns NULL until set.
+ */
+void shm_arena_set_root(shm_arena* arena, void* root);
+void* shm_arena_root(const shm_arena* arena);
+
+/*
+ * Unmaps the arena from this process. The objects stay alive for the other processes.
+ */
+void shm_arena_detach(shm_arena* arena);
+
+/*
+ * Removes the name of a named arena; it is freed once every process has detached.
+ */
+int shm_arena_unlink(const char* name);
+
+#endif // SHM_ARENA_H
@@ -0,0 +1,210 @@
+/*
+ * topology.c
+ *
+ * Parses the sysfs node cpulists ("0-3,8-11") into a CPU to node table, and the per-CPU
+ * package and core ids into the keys the placement orderings sort by.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#define _GNU_SOURCE
+#include "topology.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_CPUS CPU_SETSIZE
+
+static int node_count = 1;
+static unsigned char cpu_node[MAX_CPUS]; // zero-initialized: everything on node 0
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+static int cpu_package[MAX_CPUS];
+static int cpu_core[MAX_CPUS];
+static pthread_once_t cores_once = PTHREAD_ONCE_INIT;
+
+// Marks every CPU of a cpulist file as belonging to 'node'. Returns 0 if the file is missing.
+static int read_cpulist(int node) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    int lo, hi;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        int c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%d", &hi) != 1) {
+                break;
+            }
+            c = fgetc(f);
+        }
+        for (int cpu = lo; cpu <= hi && cpu < MAX_CPUS; cpu++) {
+            cpu_node[cpu] = (unsigned char)node;
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(f);
+    return 1;
+}
+
+/*
+ * Node ids are dense on every machine we care about, so scanning stops at the first
+ * missing node directory.
+ */
+static void load_topology(void) {
+    const char* fake = getenv("TOPOLOGY_NODES");
+    if (fake != NULL) {
+        int n = atoi(fake);
+        if (n < 1 || n > TOPOLOGY_MAX_NODES) {
+            fprintf(stderr, "Ignoring invalid TOPOLOGY_NODES '%s'\n", fake);
+        } else {
+            node_count = n;
+            for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+                cpu_node[cpu] = (unsigned char)(cpu % n);
+            }
+            return;
+        }
+    }
+
+    int n = 0;
+    while (n < TOPOLOGY_MAX_NODES && read_cpulist(n)) {
+        n++;
+    }
+    node_count = n > 0 ? n : 1;
+}
+
+int topology_node_count(void) {
+    pthread_once(&topology_once, load_topology);
+    return node_count;
+}
+
+int topology_node_of_cpu(int cpu) {
+    pthread_once(&topology_once, load_topology);
+    if (cpu < 0 || cpu >= MAX_CPUS) {
+        return 0;
+    }
+    return cpu_node[cpu];
+}
+
+int topology_current_node(void) {
+    return topology_node_of_cpu(sched_getcpu());
+}
+
+// Reads a single integer from a sysfs file, 'fallback' if it cannot be read
+static int read_id(int cpu, const char* name, int fallback) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return fallback;
+    }
+    int id;
+    if (fscanf(f, "%d", &id) != 1) {
+        id = fallback;
+    }
+    fclose(f);
+    return id;
+}
+
+static void load_cores(void) {
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cpu_package[cpu] = read_id(cpu, "physical_package_id", 0);
+        cpu_core[cpu] = read_id(cpu, "core_id", cpu);
+    }
+}
+
+int topology_package_of_cpu(int cpu) {
+    pthread_once(&cores_once, load_cores);
+    return cpu >= 0 && cpu < MAX_CPUS ? cpu_package[cpu] : 0;
+}
+
+int topology_core_of_cpu(int cpu) {
+    pthread_once(&cores_once, load_cores);
+    return cpu >= 0 && cpu < MAX_CPUS ? cpu_core[cpu] : cpu;
+}
+
+// Sort keys of one CPU, most significant first
+typedef struct {
+    int key[4];
+} cpu_entry;
+
+static int compare_entries(const void* a, const void* b) {
+    const cpu_entry* x = a;
+    const cpu_entry* y = b;
+    for (int i = 0; i < 4; i++) {
+        if (x->key[i] != y->key[i]) {
+            return x->key[i] < y->key[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * topology_cpu_order
+ *
+ * Both orders start from the compact one. Scatter then ranks every CPU by its SMT index
+ * within its core and the core's index within its package, and sorts by those first, so
+ * consecutive CPUs land on different cores and different packages for as long as possible.
+ */
+int topology_cpu_order(int order, int* cpus, int max) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+    cpu_entry* entries = malloc(sizeof(cpu_entry) * CPU_COUNT(&allowed));
+    if (entries == NULL) {
+        return 0;
+    }
+    int n = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpu_entry e = { { topology_node_of_cpu(cpu), topology_package_of_cpu(cpu),
+                              topology_core_of_cpu(cpu), cpu } };
+            entries[n++] = e;
+        }
+    }
+    qsort(entries, n, sizeof(cpu_entry), compare_entries);
+
+    if (order == TOPOLOGY_SCATTER) {
+        int core_rank = -1;
+        int smt_index = 0;
+        for (int i = 0; i < n; i++) {
+            int same_package = i > 0 && entries[i].key[0] == entries[i - 1].key[0]
+                                     && entries[i].key[1] == entries[i - 1].key[1];
+            int same_core = same_package && entries[i].key[2] == entries[i - 1].key[2];
+            if (!same_package) {
+                core_rank = 0;
+                smt_index = 0;
+            } else if (same_core) {
+                smt_index++;
+            } else {
+                core_rank++;
+                smt_index = 0;
+            }
+            int cpu = entries[i].key[3];
+            int package = entries[i].key[0] * 4096 + entries[i].key[1];
+            cpu_entry e = { { smt_index, core_rank, package, cpu } };
+            entries[i] = e;
+        }
+        qsort(entries, n, sizeof(cpu_entry), compare_entries);
+    }
+
+    int count = n < max ? n : max;
+    for (int i = 0; i < count; i++) {
+        cpus[i] = entries[i].key[3];
+    }
+    free(entries);
+    return count;
+}
+
+int topology_bind_attr(pthread_attr_t* attr, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
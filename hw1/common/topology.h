@@ -0,0 +1,65 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <pthread.h>
+
+/*
+ * NUMA node discovery for the hierarchical locks, and CPU orderings for thread placement.
+ *
+ * The CPU to node map is read once from /sys/devices/system/node/node<N>/cpulist.
+ * When that directory is missing (no NUMA support, containers) the machine is treated as a
+ * single node, so every caller keeps working, just without the locality benefit.
+ *
+ * TOPOLOGY_NODES=<n> in the environment overrides the detection with n fake nodes, CPU c
+ * belonging to node c % n. It exists to exercise the multi-node paths on any machine.
+ *
+ * Packages and cores come from /sys/devices/system/cpu/cpu<N>/topology, read the first time
+ * an ordering is asked for. A CPU without those files counts as a core of its own.
+ */
+
+#define TOPOLOGY_MAX_NODES 64
+
+/*
+ * CPU orderings for topology_cpu_order.
+ *   TOPOLOGY_COMPACT  node by node, package by package, core by core, SMT siblings adjacent
+ *   TOPOLOGY_SCATTER  one thread of every core first, alternating between packages, then
+ *                     the second threads of every core, and so on
+ */
+#define TOPOLOGY_COMPACT 0
+#define TOPOLOGY_SCATTER 1
+
+/*
+ * Number of nodes (at least 1).
+ */
+int topology_node_count(void);
+
+/*
+ * Node of the given CPU, 0 for CPUs that are unknown to the map.
+ */
+int topology_node_of_cpu(int cpu);
+
+/*
+ * Node of the CPU the calling thread is running on right now. The thread may migrate
+ * right after, so the answer is a hint for locality, never something correctness relies on.
+ */
+int topology_current_node(void);
+
+/*
+ * Package and core id of the given CPU. Core ids are only unique within a package.
+ */
+int topology_package_of_cpu(int cpu);
+int topology_core_of_cpu(int cpu);
+
+/*
+ * Fills 'cpus' with up to 'max' of the CPUs this process may run on, in the given order.
+ * Returns how many were written.
+ */
+int topology_cpu_order(int order, int* cpus, int max);
+
+/*
+ * Sets 'attr' so that a thread created with it starts out restricted to 'cpu'.
+ * Returns 0 on success, an error number otherwise.
+ */
+int topology_bind_attr(pthread_attr_t* attr, int cpu);
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,165 @@
+/*
+ * wait_policy.c
+ *
+ * Implementation of the spin / backoff / yield / futex-park wait strategy.
+ *
+ * Parking is race free because both sides go through a sequentially consistent handshake:
+ * the waiter increments 'parked' before the futex call (which re-checks the word in the
+ * kernel), and the waker changes the word before reading 'parked' (see ORDER_HANDSHAKE_LOAD
+ * in mem_order.h). Either the waker sees the sleeper and wakes it, or the sleeper's futex call
+ * sees the new value and returns. The ordering lives here rather than in the primitives, so
+ * their release stores stay plain stores and a policy that never parks pays nothing for it.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "wait_policy.h"
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static wait_policy global_policy = { 32, 20, 16, 0 };
+static pthread_once_t global_once = PTHREAD_ONCE_INIT;
+
+// Reads WAIT_POLICY once, on first use of the global default
+static void load_environment(void) {
+    if (sysconf(_SC_NPROCESSORS_ONLN) == 1) {
+        global_policy.spin_limit = 0; // the thread we wait for cannot run while we spin
+    }
+    const char* spec = getenv("WAIT_POLICY");
+    if (spec != NULL && wait_policy_parse(&global_policy, spec) != 0) {
+        fprintf(stderr, "Ignoring malformed WAIT_POLICY '%s'\n", spec);
+    }
+}
+
+const wait_policy* wait_policy_global(void) {
+    pthread_once(&global_once, load_environment);
+    return &global_policy;
+}
+
+void wait_policy_default(wait_policy* policy) {
+    *policy = *wait_policy_global();
+}
+
+void wait_policy_set_global(const wait_policy* policy) {
+    pthread_once(&global_once, load_environment);
+    global_policy = *policy;
+}
+
+/*
+ * wait_policy_parse
+ *
+ * Accepts a preset name or a comma separated list of key=value pairs.
+ */
+int wait_policy_parse(wait_policy* policy, const char* spec) {
+    if (strcmp(spec, "spin") == 0) {
+        policy->spin_limit = WAIT_FOREVER;
+        policy->yield_limit = WAIT_FOREVER;
+        return 0;
+    }
+    if (strcmp(spec, "yield") == 0) {
+        policy->spin_limit = 0;
+        policy->yield_limit = WAIT_FOREVER;
+        return 0;
+    }
+    if (strcmp(spec, "park") == 0) {
+        policy->spin_limit = 0;
+        policy->yield_limit = 0;
+        return 0;
+    }
+
+    wait_policy parsed = *policy;
+    const char* p = spec;
+    while (*p != '\0') {
+        char key[16];
+        int value;
+        int used;
+        if (sscanf(p, "%15[a-z]=%d%n", key, &value, &used) != 2) {
+            return -1;
+        }
+        if (strcmp(key, "spin") == 0) {
+            parsed.spin_limit = value;
+        } else if (strcmp(key, "yield") == 0) {
+            parsed.yield_limit = value;
+        } else if (strcmp(key, "backoff") == 0 && value > 0) {
+            parsed.backoff_max = value;
+        } else {
+            return -1;
+        }
+        p += used;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+    *policy = parsed;
+    return 0;
+}
+
+/*
+ * pause_step
+ *
+ * Picks the phase from how many times this wait has already paused. In the park phase
+ * sleeps for at most 'timeout' (NULL = no limit) and returns -1 if that ran out.
+ */
+static int pause_step(const wait_policy* policy, wait_state* state, atomic_int* word,
+                      int expected, atomic_int* parked, const struct timespec* timeout) {
+    if (policy->spin_limit == WAIT_FOREVER || state->iter < policy->spin_limit) {
+        for (int i = 0; i < state->backoff; i++) {
+            wait_cpu_relax();
+        }
+        if (state->backoff < policy->backoff_max) {
+            state->backoff <<= 1;
+        }
+        if (state->iter < INT_MAX) {
+            state->iter++;
+        }
+        return 0;
+    }
+
+    if (word == NULL || policy->yield_limit == WAIT_FOREVER ||
+        state->iter - policy->spin_limit < policy->yield_limit) {
+        sched_yield();
+        if (state->iter < INT_MAX) {
+            state->iter++;
+        }
+        return 0;
+    }
+
+    atomic_fetch_add(parked, 1);
+    long rc = syscall(SYS_futex, (int*)word, policy->pshared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,
+                      expected, timeout, NULL, 0);
+    int timed_out = rc == -1 && errno == ETIMEDOUT;
+    atomic_fetch_sub(parked, 1);
+    return timed_out ? -1 : 0;
+}
+
+void wait_pause(const wait_policy* policy, wait_state* state,
+                atomic_int* word, int expected, atomic_int* parked) {
+    pause_step(policy, state, word, expected, parked, NULL);
+}
+
+int wait_pause_timed(const wait_policy* policy, wait_state* state,
+                     atomic_int* word, int expected, atomic_int* parked, long timeout_ms) {
+    struct timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000 };
+    return pause_step(policy, state, word, expected, parked, &timeout);
+}
+
+void wait_wake(const wait_policy* policy, atomic_int* word, atomic_int* parked, int count) {
+    if (!wait_may_park(policy)) {
+        return;
+    }
+    if (ORDER_HANDSHAKE_LOAD(parked) > 0) {
+        syscall(SYS_futex, (int*)word, policy->pshared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE,
+                count, NULL, NULL, 0);
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef WAIT_POLICY_H
+#define WAIT_POLICY_H
+
+#include <stdatomic.h>
+#include "mem_order.h"
+
+/*
+ * Shared wait strategy used by every primitive's wait loop.
+ *
+ * A waiter escalates through three phases:
+ *   1. spin:  up to 'spin_limit' iterations of the pause instruction, with the number of
+ *             pauses per iteration doubling up to 'backoff_max' (exponential backoff),
+ *   2. yield: up to 'yield_limit' calls to sched_yield,
+ *   3. park:  sleep in the kernel with a futex until the watched word changes.
+ * A yield_limit of WAIT_FOREVER never parks; a spin_limit of WAIT_FOREVER spins forever.
+ *
+ * Each primitive embeds its own wait_policy, initialized from the global default, so
+ * thresholds can be tuned per instance by assigning the field after *_init. The global
+ * default is read once from the WAIT_POLICY environment variable, either a preset
+ *   WAIT_POLICY=spin    pure spinning (dedicated cores)
+ *   WAIT_POLICY=yield   spin briefly, then yield forever (the original behaviour)
+ *   WAIT_POLICY=park    park almost immediately (oversubscribed hosts)
+ * or explicit thresholds, e.g. WAIT_POLICY=spin=200,yield=10,backoff=32.
+ * Without WAIT_POLICY the default is spin=32,yield=20,backoff=16, with no spinning at all
+ * on a single CPU.
+ *
+ * 'pshared' is not part of WAIT_POLICY: it describes where the primitive lives, not how to
+ * wait, and is set by the *_init_shared functions. Parking then uses the shared futex
+ * operations, so a waker in one process can wake a sleeper in another.
+ */
+
+#define WAIT_FOREVER -1
+
+typedef struct {
+    int spin_limit;     // pause-spin iterations before yielding (WAIT_FOREVER = never stop)
+    int yield_limit;    // yields before parking (WAIT_FOREVER = never park)
+    int backoff_max;    // upper bound on pause instructions per spin iteration
+    int pshared;        // the watched words live in memory shared between processes
+} wait_policy;
+
+/*
+ * Per-wait progress through the phases, kept on the waiter's stack.
+ */
+typedef struct {
+    int iter;
+    int backoff;
+} wait_state;
+
+#define WAIT_STATE_INIT { 0, 1 }
+
+/*
+ * Copies the global default policy into 'policy'.
+ */
+void wait_policy_default(wait_policy* policy);
+
+/*
+ * Returns the global default policy.
+ */
+const wait_policy* wait_policy_global(void);
+
+/*
+ * Replaces the global default. Only affects primitives initialized afterwards.
+ */
+void wait_policy_set_global(const wait_policy* policy);
+
+/*
+ * Parses a WAIT_POLICY specification into 'policy' (fields not mentioned are kept).
+ * Returns 0 on success, -1 if the specification is malformed.
+ */
+int wait_policy_parse(wait_policy* policy, const char* spec);
+
+/*
+ * One step of waiting. Call it in the wait loop each time the condition is still false.
+ * 'word' is the atomic the waiter is watching and 'expected' the value it last saw there;
+ * once in the park phase the caller sleeps until 'word' changes and wait_wake is called.
+ * 'parked' counts sleepers so wakers can skip the system call. Pass word == NULL for
+ * waits that cannot park (e.g. on an atomic_flag); they yield instead.
+ */
+void wait_pause(const wait_policy* policy, wait_state* state,
+                atomic_int* word, int expected, atomic_int* parked);
+
+/*
+ * Like wait_pause, but a park lasts at most 'timeout_ms' milliseconds.
+ * Returns -1 if the park timed out, 0 otherwise. Policies that never park never time out.
+ */
+int wait_pause_timed(const wait_policy* policy, wait_state* state,
+                     atomic_int* word, int expected, atomic_int* parked, long timeout_ms);
+
+/*
+ * Returns 1 if waiters following 'policy' can ever park. Wakers of a policy that only spins
+ * and yields have nobody to wake and skip the handshake with the sleepers entirely.
+ */
+static inline int wait_may_park(const wait_policy* policy) {
+    return policy->spin_limit != WAIT_FOREVER && policy->yield_limit != WAIT_FOREVER;
+}
+
+/*
+ * Wakes up to 'count' threads parked on 'word' (INT_MAX for all), after the caller changed it.
+ * 'policy' must be the one the waiters use. Costs one atomic read-modify-write when nobody
+ * is parked, nothing at all when the policy never parks.
+ */
+void wait_wake(const wait_policy* policy, atomic_int* word, atomic_int* parked, int count);
+
+/*
+ * CPU hint for spin loops (pause on x86, yield on ARM).
+ */
+static inline void wait_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif // WAIT_POLICY_H
@@ -0,0 +1,326 @@
+/*
+ * coro.hpp
+ *
+ * C++20 coroutine awaitables over the semaphore, the condition variable and a
+ * producer-consumer channel, built on the async waiters of common/async_wait.h.
+ *
+ * A coroutine that has to wait is queued as an async waiter instead of blocking its thread.
+ * When the permits are taken for it, or a signal reaches it, the completion callback posts
+ * the coroutine to an executor, which resumes it:
+ *
+ *   co_await hw1::async_acquire(sem, exec);          // hw1::counting_semaphore<>
+ *   co_await hw1::async_wait(cv, lock, exec);        // hw1::condition_variable<>, any unique_lock
+ *   std::optional<T> v = co_await chan.pop();        // hw1::channel<T, Exec>
+ *
+ * Executors are any type with post(std::coroutine_handle<>):
+ *   hw1::inline_executor        resumes right away on the thread that completed the wait
+ *   hw1::thread_pool_executor   resumes on the task6 executor's fixed pool of workers
+ *
+ * hw1::detached is a fire-and-forget coroutine type; start one with
+ * co_await hw1::schedule(exec) to move it onto the executor. This way a workload of 100k
+ * producers and consumers runs as coroutines on a handful of threads.
+ *
+ * Requires C++23, like locks.hpp. Link common/async_wait.c and task6/executor.c,
+ * task6/ws_deque.c besides the primitives.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#ifndef HW1_CORO_HPP
+#define HW1_CORO_HPP
+
+#include "locks.hpp"
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <utility>
+
+extern "C" {
+#define _Alignas(x) alignas(x)
+#include "../task6/executor.h"
+#undef _Alignas
+}
+
+namespace hw1 {
+
+template <class E>
+concept Executor = requires(E& e, std::coroutine_handle<> h) {
+    e.post(h);
+};
+
+struct inline_executor {
+    void post(std::coroutine_handle<> h) { h.resume(); }
+};
+
+/*
+ * Resumes coroutines on a fixed pool of the task6 executor.
+ */
+class thread_pool_executor {
+public:
+    explicit thread_pool_executor(int threads) {
+        if (executor_init(&ex_, threads, threads) != 0) {
+            throw std::bad_alloc();
+        }
+    }
+    ~thread_pool_executor() { executor_destroy(&ex_); }
+    thread_pool_executor(const thread_pool_executor&) = delete;
+    thread_pool_executor& operator=(const thread_pool_executor&) = delete;
+
+    void post(std::coroutine_handle<> h) {
+        executor_future_release(executor_submit(&ex_, &resume, h.address()));
+    }
+
+    // Blocks until every posted resumption has run. Must not be called from a worker.
+    void wait_idle() { executor_wait_all(&ex_); }
+
+private:
+    static void* resume(void* address) {
+        std::coroutine_handle<>::from_address(address).resume();
+        return nullptr;
+    }
+
+    executor ex_;
+};
+
+/*
+ * Coroutine type that starts eagerly and frees itself when it finishes.
+ */
+struct detached {
+    struct promise_type {
+        detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+/*
+ * co_await schedule(exec) continues the coroutine on 'exec'.
+ */
+template <Executor Exec>
+auto schedule(Exec& exec) {
+    struct awaiter {
+        Exec& exec;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { exec.post(h); }
+        void await_resume() const noexcept {}
+    };
+    return awaiter{exec};
+}
+
+/*
+ * Awaiter for 'n' permits. The async waiter lives in the coroutine frame; once it is handed
+ * to the semaphore the frame may be resumed on another thread at any moment, so
+ * await_suspend touches nothing of it afterwards.
+ */
+template <Executor Exec>
+class acquire_awaiter {
+public:
+    acquire_awaiter(semaphore* sem, int n, Exec& exec) : sem_(sem), n_(n), exec_(&exec) {}
+
+    bool await_ready() { return semaphore_try_wait_n(sem_, n_) != 0; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        handle_ = h;
+        async_waiter_init_callback(&waiter_, &on_complete, this);
+        int queued = semaphore_wait_async(sem_, &waiter_, n_);
+        if (queued < 0) {
+            semaphore_wait_n(sem_, n_);   // process-shared: no async waiting, block instead
+            return false;
+        }
+        return queued == 0;           // 1: taken right away, do not suspend
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    static void on_complete(void* arg) {
+        auto* self = static_cast<acquire_awaiter*>(arg);
+        self->exec_->post(self->handle_);
+    }
+
+    semaphore* sem_;
+    int n_;
+    Exec* exec_;
+    std::coroutine_handle<> handle_;
+    async_waiter waiter_;
+};
+
+template <class Wait, Executor Exec>
+acquire_awaiter<Exec> async_acquire(counting_semaphore<Wait>& sem, Exec& exec, int n = 1) {
+    return acquire_awaiter<Exec>(sem.native_handle(), n, exec);
+}
+
+/*
+ * Awaiter for a condition variable signal. Like condition_variable_wait, the lock is
+ * released while suspended and held again on resumption, and wakeups may be spurious.
+ * The ownership is moved out of the unique_lock before registering, since the resuming
+ * thread takes the mutex again through it.
+ */
+template <class Lock, Executor Exec>
+class cv_awaiter {
+public:
+    cv_awaiter(::condition_variable* cv, std::unique_lock<Lock>& lock, Exec& exec)
+        : cv_(cv), lock_(&lock), mutex_(lock.mutex()), exec_(&exec) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        handle_ = h;
+        async_waiter_init_callback(&waiter_, &on_complete, this);
+        Lock* m = lock_->release();
+        if (condition_variable_wait_async(cv_, &waiter_) != 0) {
+            *lock_ = std::unique_lock<Lock>(*m, std::adopt_lock);
+            return false;             // process-shared: report a spurious wakeup
+        }
+        m->unlock();
+        return true;
+    }
+
+    void await_resume() {
+        if (!lock_->owns_lock()) {
+            mutex_->lock();
+            *lock_ = std::unique_lock<Lock>(*mutex_, std::adopt_lock);
+        }
+    }
+
+private:
+    static void on_complete(void* arg) {
+        auto* self = static_cast<cv_awaiter*>(arg);
+        self->exec_->post(self->handle_);
+    }
+
+    ::condition_variable* cv_;
+    std::unique_lock<Lock>* lock_;
+    Lock* mutex_;
+    Exec* exec_;
+    std::coroutine_handle<> handle_;
+    async_waiter waiter_;
+};
+
+template <class Wait, class Lock, Executor Exec>
+cv_awaiter<Lock, Exec> async_wait(condition_variable<Wait>& cv, std::unique_lock<Lock>& lock, Exec& exec) {
+    return cv_awaiter<Lock, Exec>(cv.native_handle(), lock, exec);
+}
+
+/*
+ * Unbounded multi-producer multi-consumer channel, organised like cp_pattern's queue: a
+ * FIFO behind a ticket lock with an is_empty condition variable. push never blocks;
+ * pop is awaitable, pop_blocking serves plain threads. After close, pops drain the
+ * remaining items and then return std::nullopt.
+ *
+ * A suspended pop does not resume just to find the queue empty again: its completion
+ * callback takes the lock (never held for long) and retries the pop on the signaling
+ * thread, and only a successful retry posts the coroutine to the executor.
+ *
+ * Every signal completes one async waiter, but signals to threads blocked in pop_blocking
+ * share one wake-up token and merge when sent back to back. So push wakes everybody while
+ * blocking poppers are present; the ones that find the queue empty wait again.
+ */
+template <class T, Executor Exec>
+class channel {
+public:
+    explicit channel(Exec& exec) : exec_(&exec) {}
+    channel(const channel&) = delete;
+    channel& operator=(const channel&) = delete;
+
+    void push(T value) {
+        bool blocking;
+        {
+            std::scoped_lock guard(lock_);
+            items_.push_back(std::move(value));
+            blocking = blocking_ > 0;
+        }
+        if (blocking) {
+            is_empty_.notify_all();
+        } else {
+            is_empty_.notify_one();
+        }
+    }
+
+    void close() {
+        {
+            std::scoped_lock guard(lock_);
+            closed_ = true;
+        }
+        is_empty_.notify_all();
+    }
+
+    std::optional<T> pop_blocking() {
+        std::unique_lock guard(lock_);
+        blocking_++;
+        is_empty_.wait(guard, [&] { return !items_.empty() || closed_; });
+        blocking_--;
+        return take_locked();
+    }
+
+    class pop_awaiter {
+    public:
+        explicit pop_awaiter(channel* ch) : ch_(ch) {}
+
+        // Returns with the channel locked when the pop has to wait
+        bool await_ready() {
+            ch_->lock_.lock();
+            if (!ch_->items_.empty() || ch_->closed_) {
+                result_ = ch_->take_locked();
+                ch_->lock_.unlock();
+                return true;
+            }
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            handle_ = h;
+            async_waiter_init_callback(&waiter_, &on_signal, this);
+            condition_variable_wait_async(ch_->is_empty_.native_handle(), &waiter_);
+            ch_->lock_.unlock();
+        }
+
+        std::optional<T> await_resume() { return std::move(result_); }
+
+    private:
+        static void on_signal(void* arg) {
+            auto* self = static_cast<pop_awaiter*>(arg);
+            channel* ch = self->ch_;
+            ch->lock_.lock();
+            if (ch->items_.empty() && !ch->closed_) {
+                condition_variable_wait_async(ch->is_empty_.native_handle(), &self->waiter_);
+                ch->lock_.unlock();
+                return;
+            }
+            self->result_ = ch->take_locked();
+            ch->lock_.unlock();
+            ch->exec_->post(self->handle_);
+        }
+
+        channel* ch_;
+        std::optional<T> result_;
+        std::coroutine_handle<> handle_;
+        async_waiter waiter_;
+    };
+
+    pop_awaiter pop() { return pop_awaiter(this); }
+
+private:
+    std::optional<T> take_locked() {
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        T value = std::move(items_.front());
+        items_.pop_front();
+        return value;
+    }
+
+    Exec* exec_;
+    mutex<ticket> lock_;
+    condition_variable<> is_empty_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    int blocking_ = 0;          // threads inside pop_blocking
+};
+
+} // namespace hw1
+
+#endif // HW1_CORO_HPP
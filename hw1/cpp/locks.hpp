@@ -0,0 +1,359 @@
+/*
+ * locks.hpp
+ *
+ * Header-only C++ layer over the primitives of tasks 1-4.
+ *
+ * Every type here meets the standard Lockable / SharedLockable requirements, so
+ * std::lock_guard, std::unique_lock, std::scoped_lock, std::shared_lock and
+ * std::condition_variable_any work with them and an early return can no longer leak a lock.
+ *
+ * The lock algorithm and the wait strategy are template parameters:
+ *
+ *   hw1::mutex<hw1::ticket, hw1::wait_spin>   ticket lock that never leaves user space
+ *   hw1::mutex<hw1::mcs>                      MCS queue lock with the global WAIT_POLICY
+ *   hw1::mutex<hw1::binary_semaphore>         the semaphore of task2 (task1 with
+ *                                             -DHW1_TAS_SEMAPHORE) used as a mutex
+ *   hw1::shared_mutex<>                       rwlock of task4
+ *   hw1::counting_semaphore<>                 semaphore with batch permits
+ *   hw1::condition_variable<>                 task3 condition variable, paired with
+ *                                             std::unique_lock<hw1::mutex<hw1::ticket, W>>
+ *
+ * Both choices are resolved at compile time. The ticket lock's acquire and release are
+ * written out inline against the C struct, with the wait step of the chosen strategy
+ * inlined into the loop: wait_spin is a bare pause and lets release skip the wakeup check.
+ * The protocol is the C one, so C and C++ code can share a ticket_lock. Builds with
+ * LOCK_STATS or LOCK_TRACE call the C functions instead, so the hooks keep working.
+ *
+ * Requires C++23 (<stdatomic.h> in C++). Link the .c files of the primitives used, e.g.
+ *   g++ -std=c++23 -O2 -pthread -I../task3 app.cpp ../task3/cond_var.c ../task3/mcs_lock.c
+ *       ../task4/rw_lock.c ../task2/tl_semaphore.c ../common/wait_policy.c ../common/async_wait.c
+ * (compile the .c files with gcc and link the objects).
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#ifndef HW1_LOCKS_HPP
+#define HW1_LOCKS_HPP
+
+#include <stdatomic.h>
+#include <climits>
+#include <concepts>
+#include <cstddef>
+#include <mutex>
+
+extern "C" {
+#define _Alignas(x) alignas(x)
+#include "../task3/cond_var.h"
+#include "../task3/mcs_lock.h"
+#include "../task4/rw_lock.h"
+#ifdef HW1_TAS_SEMAPHORE
+#include "../task1/tas_semaphore.h"
+#else
+#include "../task2/tl_semaphore.h"
+#endif
+#undef _Alignas
+}
+
+#if defined(LOCK_STATS) || defined(LOCK_TRACE)
+#define HW1_INLINE_FAST_PATHS 0
+#else
+#define HW1_INLINE_FAST_PATHS 1
+#endif
+
+namespace hw1 {
+
+/*
+ * Standard lock requirements, checked against every type below.
+ */
+template <class L>
+concept Lockable = requires(L& l) {
+    l.lock();
+    l.unlock();
+    { l.try_lock() } -> std::convertible_to<bool>;
+};
+
+template <class L>
+concept SharedLockable = Lockable<L> && requires(L& l) {
+    l.lock_shared();
+    l.unlock_shared();
+    { l.try_lock_shared() } -> std::convertible_to<bool>;
+};
+
+/*
+ * Wait strategies. 'configure' fills the primitive's wait_policy at construction, 'pause'
+ * is one step of an inline wait loop, and 'may_park' tells releases whether a waiter can
+ * be asleep at all.
+ */
+struct wait_default {
+    static constexpr bool may_park = true;
+    static void configure(wait_policy& policy) { wait_policy_default(&policy); }
+    static void pause(const wait_policy& policy, wait_state& state,
+                      atomic_int* word, int expected, atomic_int* parked) {
+        wait_pause(&policy, &state, word, expected, parked);
+    }
+};
+
+template <int Spin, int Yield, int Backoff = 16>
+struct wait_fixed {
+    static constexpr bool may_park = Spin != WAIT_FOREVER && Yield != WAIT_FOREVER;
+    static void configure(wait_policy& policy) {
+        policy.spin_limit = Spin;
+        policy.yield_limit = Yield;
+        policy.backoff_max = Backoff;
+        policy.pshared = 0;
+    }
+    static void pause(const wait_policy& policy, wait_state& state,
+                      atomic_int* word, int expected, atomic_int* parked) {
+        wait_pause(&policy, &state, word, expected, parked);
+    }
+};
+
+// The WAIT_POLICY presets, fixed at compile time
+using wait_yield = wait_fixed<0, WAIT_FOREVER>;
+using wait_park = wait_fixed<0, 0>;
+
+struct wait_spin {
+    static constexpr bool may_park = false;
+    static void configure(wait_policy& policy) { wait_fixed<WAIT_FOREVER, WAIT_FOREVER>::configure(policy); }
+    static void pause(const wait_policy&, wait_state&, atomic_int*, int, atomic_int*) { wait_cpu_relax(); }
+};
+
+/*
+ * Lock algorithms for hw1::mutex. Each provides impl<Wait> with lock, try_lock and unlock.
+ */
+struct ticket {
+    template <class Wait>
+    class impl {
+    public:
+        impl() {
+            ticketlock_init(&lock_);
+            Wait::configure(lock_.policy);
+        }
+
+        void lock() {
+#if HW1_INLINE_FAST_PATHS
+            int my_ticket = atomic_fetch_add(&lock_.ticket, 1);
+            wait_state ws = WAIT_STATE_INIT;
+            int cur;
+            while ((cur = atomic_load(&lock_.cur_ticket)) != my_ticket) {
+                Wait::pause(lock_.policy, ws, &lock_.cur_ticket, cur, &lock_.parked);
+            }
+#else
+            ticketlock_acquire(&lock_);
+#endif
+        }
+
+        bool try_lock() { return ticketlock_try_acquire(&lock_) != 0; }
+
+        void unlock() {
+#if HW1_INLINE_FAST_PATHS
+            atomic_fetch_add(&lock_.cur_ticket, 1);
+            if constexpr (Wait::may_park) {
+                wait_wake(&lock_.policy, &lock_.cur_ticket, &lock_.parked, INT_MAX);
+            }
+#else
+            ticketlock_release(&lock_);
+#endif
+        }
+
+        ticket_lock* native_handle() { return &lock_; }
+
+    private:
+        ticket_lock lock_;
+    };
+};
+
+struct mcs {
+    template <class Wait>
+    class impl {
+    public:
+        impl() {
+            mcs_lock_init(&lock_);
+            Wait::configure(lock_.policy);
+        }
+
+        void lock() {
+            mcs_node* node = node_get();
+            mcs_lock_acquire(&lock_, node);
+            holder_ = node;
+        }
+
+        bool try_lock() {
+            mcs_node* node = node_get();
+            if (!mcs_lock_try_acquire(&lock_, node)) {
+                node_put(node);
+                return false;
+            }
+            holder_ = node;
+            return true;
+        }
+
+        void unlock() {
+            mcs_node* node = holder_;
+            mcs_lock_release(&lock_, node);
+            node_put(node);
+        }
+
+        mcs_lock* native_handle() { return &lock_; }
+
+    private:
+        // Queue nodes are reused per thread; a thread may hold several locks at once
+        struct pooled_node {
+            mcs_node node;
+            pooled_node* next_free;
+        };
+        static inline thread_local pooled_node* free_nodes = nullptr;
+
+        static mcs_node* node_get() {
+            pooled_node* n = free_nodes;
+            if (n == nullptr) {
+                return &(new pooled_node{})->node;
+            }
+            free_nodes = n->next_free;
+            return &n->node;
+        }
+
+        static void node_put(mcs_node* node) {
+            pooled_node* n = reinterpret_cast<pooled_node*>(node);
+            n->next_free = free_nodes;
+            free_nodes = n;
+        }
+
+        mcs_lock lock_;
+        mcs_node* holder_ = nullptr;   // node of the current owner
+    };
+};
+
+struct binary_semaphore {
+    template <class Wait>
+    class impl {
+    public:
+        impl() {
+            semaphore_init(&sem_, 1);
+            Wait::configure(sem_.policy);
+        }
+        void lock() { semaphore_wait(&sem_); }
+        bool try_lock() { return semaphore_try_wait_n(&sem_, 1) != 0; }
+        void unlock() { semaphore_signal(&sem_); }
+        semaphore* native_handle() { return &sem_; }
+
+    private:
+        semaphore sem_;
+    };
+};
+
+/*
+ * Mutex with a compile-time lock algorithm and wait strategy.
+ */
+template <class Algorithm = ticket, class Wait = wait_default>
+class mutex {
+public:
+    using algorithm = Algorithm;
+    using wait = Wait;
+
+    mutex() = default;
+    mutex(const mutex&) = delete;
+    mutex& operator=(const mutex&) = delete;
+
+    void lock() { impl_.lock(); }
+    bool try_lock() { return impl_.try_lock(); }
+    void unlock() { impl_.unlock(); }
+    auto native_handle() { return impl_.native_handle(); }
+
+private:
+    typename Algorithm::template impl<Wait> impl_;
+};
+
+/*
+ * Reader-writer mutex over the task4 rwlock.
+ */
+template <class Wait = wait_default>
+class shared_mutex {
+public:
+    shared_mutex() {
+        rwlock_init(&lock_);
+        wait_policy policy;
+        wait_policy_default(&policy);
+        Wait::configure(policy);
+        rwlock_set_wait_policy(&lock_, &policy);
+    }
+    shared_mutex(const shared_mutex&) = delete;
+    shared_mutex& operator=(const shared_mutex&) = delete;
+
+    void lock() { rwlock_acquire_write(&lock_); }
+    bool try_lock() { return rwlock_try_acquire_write(&lock_) != 0; }
+    void unlock() { rwlock_release_write(&lock_); }
+    void lock_shared() { rwlock_acquire_read(&lock_); }
+    bool try_lock_shared() { return rwlock_try_acquire_read(&lock_) != 0; }
+    void unlock_shared() { rwlock_release_read(&lock_); }
+    rwlock* native_handle() { return &lock_; }
+
+private:
+    rwlock lock_;
+};
+
+/*
+ * Counting semaphore with the std::counting_semaphore interface, plus batch acquires.
+ */
+template <class Wait = wait_default>
+class counting_semaphore {
+public:
+    explicit counting_semaphore(int initial) {
+        semaphore_init(&sem_, initial);
+        Wait::configure(sem_.policy);
+    }
+    counting_semaphore(const counting_semaphore&) = delete;
+    counting_semaphore& operator=(const counting_semaphore&) = delete;
+
+    void acquire(int n = 1) { semaphore_wait_n(&sem_, n); }
+    bool try_acquire(int n = 1) { return semaphore_try_wait_n(&sem_, n) != 0; }
+    void release(int n = 1) { semaphore_signal_n(&sem_, n); }
+    semaphore* native_handle() { return &sem_; }
+
+private:
+    semaphore sem_;
+};
+
+/*
+ * The task3 condition variable. Its wait needs the ticket lock it was designed for, so it
+ * takes a std::unique_lock of a ticket mutex; for any other lock use
+ * std::condition_variable_any. Spurious wakeups happen, use the predicate overload.
+ */
+template <class Wait = wait_default>
+class condition_variable {
+public:
+    condition_variable() {
+        condition_variable_init(&cv_);
+        Wait::configure(cv_.policy);
+    }
+    condition_variable(const condition_variable&) = delete;
+    condition_variable& operator=(const condition_variable&) = delete;
+
+    template <class MutexWait>
+    void wait(std::unique_lock<mutex<ticket, MutexWait>>& lock) {
+        condition_variable_wait(&cv_, lock.mutex()->native_handle());
+    }
+
+    template <class MutexWait, class Predicate>
+    void wait(std::unique_lock<mutex<ticket, MutexWait>>& lock, Predicate pred) {
+        while (!pred()) {
+            wait(lock);
+        }
+    }
+
+    void notify_one() { condition_variable_signal(&cv_); }
+    void notify_all() { condition_variable_broadcast(&cv_); }
+    ::condition_variable* native_handle() { return &cv_; }
+
+private:
+    ::condition_variable cv_;
+};
+
+static_assert(Lockable<mutex<ticket>>);
+static_assert(Lockable<mutex<mcs, wait_spin>>);
+static_assert(Lockable<mutex<binary_semaphore, wait_park>>);
+static_assert(SharedLockable<shared_mutex<>>);
+
+} // namespace hw1
+
+#endif // HW1_LOCKS_HPP
@@ -0,0 +1,434 @@
+/*
+ * memory_order_litmus.c
+ *
+ * Stress tests for the acquire/release orderings of the primitives: every test moves plain,
+ * non-atomic data between threads and relies on nothing but the primitive to order it.
+ *
+ *   mutex      two fields on separate cache lines, updated together inside the critical
+ *              section, must always be seen equal (ticket, MCS, both semaphores as mutexes,
+ *              rwlock writers against readers)
+ *   ping-pong  message passing: a value written before a signal must be read after the wait
+ *              (both semaphores, condition variable)
+ *   barrier    slots written before a phase must all be seen after it (sense, dissemination,
+ *              countdown latch)
+ *
+ * Everything runs twice: with the yield policy, whose wakers skip the park handshake, and
+ * with the park policy, which goes through it on every release. On x86 these mostly catch
+ * compiler reordering; on weakly ordered CPUs (ARM, POWER) they also catch hardware reordering.
+ *
+ * Build: gcc -O2 -pthread -Itask3 memory_order_litmus.c task3/cond_var.c task3/mcs_lock.c
+ *            task3/barrier.c task4/rw_lock.c common/wait_policy.c common/async_wait.c
+ *        add -DFORCE_SEQ_CST to run the same tests with every order sequentially consistent
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "common/sem_variants.h"
+#include "task3/mcs_lock.h"
+#include "task3/barrier.h"
+#include "task4/rw_lock.h"
+
+#define THREADS 4
+#define ITERATIONS 100000
+#define PHASES 2000
+
+// The two halves live on different lines so a weak CPU may make them visible out of order
+struct pair
+{
+    _Alignas(64) int a;
+    _Alignas(64) int b;
+};
+
+struct pair g_pair;
+
+ticket_lock g_ticket;
+mcs_lock g_mcs;
+tas_semaphore g_tas;
+tl_semaphore g_tl;
+rwlock g_rw;
+
+void fail(const char* test)
+{
+    fprintf(stderr, "%s: ordering violated\n", test);
+    exit(1);
+}
+
+// One critical section: the fields must be equal on entry, and stay equal for the next holder
+void critical_section(const char* test)
+{
+    int a = g_pair.a;
+    int b = g_pair.b;
+    if(a != b)
+    {
+        fail(test);
+    }
+    g_pair.a = a + 1;
+    g_pair.b = b + 1;
+}
+
+void *ticket_worker(void *arg)
+{
+    (void)arg;
+    for(int i = 0; i < ITERATIONS; i++)
+    {
+        ticketlock_acquire(&g_ticket);
+        critical_section("ticket_lock");
+        ticketlock_release(&g_ticket);
+    }
+    return NULL;
+}
+
+void *mcs_worker(void *arg)
+{
+    (void)arg;
+    mcs_node node;
+    for(int i = 0; i < ITERATIONS; i++)
+    {
+        mcs_lock_acquire(&g_mcs, &node);
+        critical_section("mcs_lock");
+        mcs_lock_release(&g_mcs, &node);
+    }
+    return NULL;
+}
+
+void *tas_worker(void *arg)
+{
+    (void)arg;
+    for(int i = 0; i < ITERATIONS; i++)
+    {
+        tas_semaphore_wait(&g_tas);
+        critical_section("tas_semaphore");
+        tas_semaphore_signal(&g_tas);
+    }
+    return NULL;
+}
+
+void *tl_worker(void *arg)
+{
+    (void)arg;
+    for(int i = 0; i < ITERATIONS; i++)
+    {
+        tl_semaphore_wait(&g_tl);
+        critical_section("tl_semaphore");
+        tl_semaphore_signal(&g_tl);
+    }
+    return NULL;
+}
+
+// Even threads write, odd threads read; readers only check
+void *rw_worker(void *arg)
+{
+    long id = (long)arg;
+    for(int i = 0; i < ITERATIONS; i++)
+    {
+        if(id % 2 == 0)
+        {
+            rwlock_acquire_write(&g_rw);
+            critical_section("rwlock");
+            rwlock_release_write(&g_rw);
+        }
+        else
+        {
+            rwlock_acquire_read(&g_rw);
+            if(g_pair.a != g_pair.b)
+            {
+                fail("rwlock");
+            }
+            rwlock_release_read(&g_rw);
+        }
+    }
+    return NULL;
+}
+
+// Runs 'worker' on THREADS threads and checks that no increment was lost
+void run_mutex(const char* test, void *(*worker)(void*), int writers)
+{
+    pthread_t threads[THREADS];
+    g_pair.a = 0;
+    g_pair.b = 0;
+    for(long i = 0; i < THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, worker, (void*)i);
+    }
+    for(int i = 0; i < THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    if(g_pair.a != writers * ITERATIONS || g_pair.b != writers * ITERATIONS)
+    {
+        fprintf(stderr, "%s: lost updates (%d, %d of %d)\n", test, g_pair.a, g_pair.b,
+                writers * ITERATIONS);
+        exit(1);
+    }
+}
+
+/*
+ * Ping-pong: the main thread writes the round into 'message' and signals, the echo thread
+ * waits, checks it and writes it back into 'reply' before signalling in turn.
+ */
+struct ping
+{
+    _Alignas(64) int message;
+    _Alignas(64) int reply;
+    tas_semaphore tas_to, tas_back;
+    tl_semaphore tl_to, tl_back;
+    ticket_lock lock;
+    condition_variable cv;
+    int turn;   // 0: the echo thread's turn, 1: the main thread's, guarded by 'lock'
+};
+
+struct ping g_ping;
+
+void *tas_echo(void *arg)
+{
+    (void)arg;
+    for(int i = 1; i <= ITERATIONS; i++)
+    {
+        tas_semaphore_wait(&g_ping.tas_to);
+        if(g_ping.message != i)
+        {
+            fail("tas_semaphore ping-pong");
+        }
+        g_ping.reply = i;
+        tas_semaphore_signal(&g_ping.tas_back);
+    }
+    return NULL;
+}
+
+void *tl_echo(void *arg)
+{
+    (void)arg;
+    for(int i = 1; i <= ITERATIONS; i++)
+    {
+        tl_semaphore_wait(&g_ping.tl_to);
+        if(g_ping.message != i)
+        {
+            fail("tl_semaphore ping-pong");
+        }
+        g_ping.reply = i;
+        tl_semaphore_signal(&g_ping.tl_back);
+    }
+    return NULL;
+}
+
+// The payload is written outside the lock, only the turn is handed over under it
+void *cv_echo(void *arg)
+{
+    (void)arg;
+    for(int i = 1; i <= ITERATIONS; i++)
+    {
+        ticketlock_acquire(&g_ping.lock);
+        while(g_ping.turn != 0)
+        {
+            condition_variable_wait(&g_ping.cv, &g_ping.lock);
+        }
+        ticketlock_release(&g_ping.lock);
+        if(g_ping.message != i)
+        {
+            fail("condition_variable ping-pong");
+        }
+        g_ping.reply = i;
+        ticketlock_acquire(&g_ping.lock);
+        g_ping.turn = 1;
+        condition_variable_broadcast(&g_ping.cv);
+        ticketlock_release(&g_ping.lock);
+    }
+    return NULL;
+}
+
+void run_ping_pong(void)
+{
+    pthread_t echo;
+    tas_semaphore_init(&g_ping.tas_to, 0);
+    tas_semaphore_init(&g_ping.tas_back, 0);
+    tl_semaphore_init(&g_ping.tl_to, 0);
+    tl_semaphore_init(&g_ping.tl_back, 0);
+    ticketlock_init(&g_ping.lock);
+    condition_variable_init(&g_ping.cv);
+
+    pthread_create(&echo, NULL, tas_echo, NULL);
+    for(int i = 1; i <= ITERATIONS; i++)
+    {
+        g_ping.message = i;
+        tas_semaphore_signal(&g_ping.tas_to);
+        tas_semaphore_wait(&g_ping.tas_back);
+        if(g_ping.reply != i)
+        {
+            fail("tas_semaphore ping-pong");
+        }
+    }
+    pthread_join(echo, NULL);
+
+    pthread_create(&echo, NULL, tl_echo, NULL);
+    for(int i = 1; i <= ITERATIONS; i++)
+    {
+        g_ping.message = i;
+        tl_semaphore_signal(&g_ping.tl_to);
+        tl_semaphore_wait(&g_ping.tl_back);
+        if(g_ping.reply != i)
+        {
+            fail("tl_semaphore ping-pong");
+        }
+    }
+    pthread_join(echo, NULL);
+
+    g_ping.turn = 1;
+    pthread_create(&echo, NULL, cv_echo, NULL);
+    for(int i = 1; i <= ITERATIONS; i++)
+    {
+        ticketlock_acquire(&g_ping.lock);
+        while(g_ping.turn != 1)
+        {
+            condition_variable_wait(&g_ping.cv, &g_ping.lock);
+        }
+        ticketlock_release(&g_ping.lock);
+        if(i > 1 && g_ping.reply != i - 1)
+        {
+            fail("condition_variable ping-pong");
+        }
+        g_ping.message = i;
+        ticketlock_acquire(&g_ping.lock);
+        g_ping.turn = 0;
+        condition_variable_broadcast(&g_ping.cv);
+        ticketlock_release(&g_ping.lock);
+    }
+    pthread_join(echo, NULL);
+}
+
+/*
+ * Barriers: in every phase each thread writes its slot, waits, and then checks that every
+ * slot holds the phase. A second wait keeps the next phase's writes out of the checks.
+ */
+int g_slots[THREADS * 16];   // one slot per cache line
+sense_barrier g_sense;
+dissemination_barrier g_dissemination;
+
+void check_slots(const char* test, int phase)
+{
+    for(int i = 0; i < THREADS; i++)
+    {
+        if(g_slots[i * 16] != phase)
+        {
+            fail(test);
+        }
+    }
+}
+
+void *sense_worker(void *arg)
+{
+    long id = (long)arg;
+    for(int phase = 1; phase <= PHASES; phase++)
+    {
+        g_slots[id * 16] = phase;
+        sense_barrier_wait(&g_sense);
+        check_slots("sense_barrier", phase);
+        sense_barrier_wait(&g_sense);
+    }
+    return NULL;
+}
+
+void *dissemination_worker(void *arg)
+{
+    long id = (long)arg;
+    for(int phase = 1; phase <= PHASES; phase++)
+    {
+        g_slots[id * 16] = phase;
+        dissemination_barrier_wait(&g_dissemination, (int)id);
+        check_slots("dissemination_barrier", phase);
+        dissemination_barrier_wait(&g_dissemination, (int)id);
+    }
+    return NULL;
+}
+
+countdown_latch g_latch;
+
+void *latch_worker(void *arg)
+{
+    long id = (long)arg;
+    g_slots[id * 16] = -1;
+    countdown_latch_count_down(&g_latch);
+    return NULL;
+}
+
+void run_barriers(void)
+{
+    pthread_t threads[THREADS];
+
+    sense_barrier_init(&g_sense, THREADS);
+    for(long i = 0; i < THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, sense_worker, (void*)i);
+    }
+    for(int i = 0; i < THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    if(dissemination_barrier_init(&g_dissemination, THREADS) != 0)
+    {
+        fprintf(stderr, "dissemination_barrier: out of memory\n");
+        exit(1);
+    }
+    for(long i = 0; i < THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, dissemination_worker, (void*)i);
+    }
+    for(int i = 0; i < THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    dissemination_barrier_destroy(&g_dissemination);
+
+    for(int round = 0; round < PHASES / 10; round++)
+    {
+        countdown_latch_init(&g_latch, THREADS);
+        for(int i = 0; i < THREADS; i++)
+        {
+            g_slots[i * 16] = 0;
+        }
+        for(long i = 0; i < THREADS; i++)
+        {
+            pthread_create(&threads[i], NULL, latch_worker, (void*)i);
+        }
+        countdown_latch_wait(&g_latch);
+        check_slots("countdown_latch", -1);
+        for(int i = 0; i < THREADS; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+// Every primitive is initialized after the policy is set, so it picks the policy up
+void run_all(const char* policy_name)
+{
+    wait_policy policy = *wait_policy_global();
+    if(wait_policy_parse(&policy, policy_name) != 0)
+    {
+        fprintf(stderr, "bad policy %s\n", policy_name);
+        exit(1);
+    }
+    wait_policy_set_global(&policy);
+
+    ticketlock_init(&g_ticket);
+    run_mutex("ticket_lock", ticket_worker, THREADS);
+    mcs_lock_init(&g_mcs);
+    run_mutex("mcs_lock", mcs_worker, THREADS);
+    tas_semaphore_init(&g_tas, 1);
+    run_mutex("tas_semaphore", tas_worker, THREADS);
+    tl_semaphore_init(&g_tl, 1);
+    run_mutex("tl_semaphore", tl_worker, THREADS);
+    rwlock_init(&g_rw);
+    run_mutex("rwlock", rw_worker, THREADS / 2);
+    run_ping_pong();
+    run_barriers();
+}
+
+int main(void)
+{
+    run_all("yield");
+    run_all("park");
+    printf("good\n");
+    return 0;
+}
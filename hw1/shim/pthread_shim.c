@@ -0,0 +1,675 @@
+/*
+ * pthread_shim.c
+ *
+ * LD_PRELOAD library that runs unmodified programs on this project's primitives.
+ *
+ * Interposes pthread_mutex_*, pthread_rwlock_*, pthread_cond_* and sem_* and maps them onto:
+ *   mutex   ticket_lock (task3) or mcs_lock (task3), chosen by SHIM_MUTEX=ticket|mcs
+ *   rwlock  rwlock (task4)
+ *   cond    condition_variable (task3)
+ *   sem     the ticket-lock semaphore (task2) or the test-and-set one (task1),
+ *           chosen by SHIM_SEM=tl|tas
+ * Waiting follows WAIT_POLICY as everywhere else. Defaults are ticket and tl.
+ *
+ * The pthread object only holds a pointer to our state in its first word, created on first
+ * use, so statically initialized objects (PTHREAD_MUTEX_INITIALIZER, a zeroed std::mutex)
+ * work without an init call. Objects that are never destroyed leak that state.
+ *
+ * A condition variable pairs with any mutex through an internal ticket lock: a waiter takes
+ * it before unlocking the user's mutex and condition_variable_wait releases it, while
+ * signal and broadcast take it too. So no signal can fall between the unlock and the wait.
+ * The task3 condition variable holds a single wake-up token, so signals are also counted
+ * on the side and every one of them releases one waiter, see cond_wait.
+ *
+ * Limitations:
+ *  - process-shared mutexes, rwlocks and condition variables are rejected (our state lives
+ *    in the process heap); process-shared and named semaphores go to glibc,
+ *  - error-checking and robust mutexes behave like normal ones, recursive ones are supported,
+ *  - timed lock operations poll with a short sleep; timed waits on condition variables and
+ *    nothing else park with a timeout.
+ *
+ * Build: gcc -O2 -shared -fPIC -pthread -I../task3 pthread_shim.c ../task3/cond_var.c
+ *            ../task3/mcs_lock.c ../task4/rw_lock.c ../common/wait_policy.c ../common/async_wait.c
+ *            -o libpthread_shim.so -ldl
+ * Usage: SHIM_MUTEX=ticket|mcs SHIM_SEM=tl|tas LD_PRELOAD=./libpthread_shim.so <program> [args]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#define _GNU_SOURCE
+#include "../task3/cond_var.h"
+#include "../task3/mcs_lock.h"
+#include "../task4/rw_lock.h"
+#include "../common/sem_variants.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SHIM_SEM_MAGIC 0x5348494du    // marks a sem_t initialized by the shim
+#define SHIM_POLL_MAX_US 1000         // longest sleep between attempts of a timed lock
+
+enum { SHIM_TICKET, SHIM_MCS };
+enum { SHIM_SEM_TL, SHIM_SEM_TAS };
+
+static int mutex_kind = SHIM_TICKET;
+static int sem_kind = SHIM_SEM_TL;
+
+// Identifies the calling thread for recursion and write-ownership checks. The library is
+// loaded at startup, so the static TLS model is safe and avoids __tls_get_addr on every lock.
+#define SHIM_TLS __attribute__((tls_model("initial-exec")))
+static __thread char self_marker SHIM_TLS;
+#define SELF ((void*)&self_marker)
+
+// glibc's own semaphore functions, for semaphores the shim does not own
+static int (*real_sem_init)(sem_t*, int, unsigned int);
+static int (*real_sem_destroy)(sem_t*);
+static int (*real_sem_wait)(sem_t*);
+static int (*real_sem_trywait)(sem_t*);
+static int (*real_sem_timedwait)(sem_t*, const struct timespec*);
+static int (*real_sem_clockwait)(sem_t*, clockid_t, const struct timespec*);
+static int (*real_sem_post)(sem_t*);
+static int (*real_sem_getvalue)(sem_t*, int*);
+
+__attribute__((constructor))
+static void shim_init(void) {
+    const char* mutex = getenv("SHIM_MUTEX");
+    if (mutex == NULL || strcmp(mutex, "ticket") == 0) {
+        mutex_kind = SHIM_TICKET;
+    } else if (strcmp(mutex, "mcs") == 0) {
+        mutex_kind = SHIM_MCS;
+    } else {
+        fprintf(stderr, "pthread_shim: unknown SHIM_MUTEX '%s' (ticket|mcs)\n", mutex);
+        exit(1);
+    }
+    const char* sem = getenv("SHIM_SEM");
+    if (sem == NULL || strcmp(sem, "tl") == 0) {
+        sem_kind = SHIM_SEM_TL;
+    } else if (strcmp(sem, "tas") == 0) {
+        sem_kind = SHIM_SEM_TAS;
+    } else {
+        fprintf(stderr, "pthread_shim: unknown SHIM_SEM '%s' (tl|tas)\n", sem);
+        exit(1);
+    }
+
+    real_sem_init = dlsym(RTLD_NEXT, "sem_init");
+    real_sem_destroy = dlsym(RTLD_NEXT, "sem_destroy");
+    real_sem_wait = dlsym(RTLD_NEXT, "sem_wait");
+    real_sem_trywait = dlsym(RTLD_NEXT, "sem_trywait");
+    real_sem_timedwait = dlsym(RTLD_NEXT, "sem_timedwait");
+    real_sem_clockwait = dlsym(RTLD_NEXT, "sem_clockwait");
+    real_sem_post = dlsym(RTLD_NEXT, "sem_post");
+    real_sem_getvalue = dlsym(RTLD_NEXT, "sem_getvalue");
+}
+
+static void* alloc_state(size_t size) {
+    void* state = aligned_alloc(MCS_CACHE_LINE, (size + MCS_CACHE_LINE - 1) / MCS_CACHE_LINE * MCS_CACHE_LINE);
+    if (state == NULL) {
+        fprintf(stderr, "pthread_shim: out of memory\n");
+        exit(1);
+    }
+    memset(state, 0, size);
+    return state;
+}
+
+static void reject_shared(const char* what) {
+    fprintf(stderr, "pthread_shim: process-shared %s objects are not supported\n", what);
+    exit(1);
+}
+
+/*
+ * lazy_state
+ *
+ * Returns the state stored in the first word of 'obj', creating it on first use. Two
+ * threads racing on a statically initialized object agree through a CAS; the loser
+ * frees its copy.
+ */
+static void* lazy_state(void* obj, void* (*create)(void* obj)) {
+    _Atomic(void*)* slot = (_Atomic(void*)*)obj;
+    void* state = atomic_load_explicit(slot, memory_order_acquire);
+    if (state != NULL) {
+        return state;
+    }
+    void* fresh = create(obj);
+    if (atomic_compare_exchange_strong(slot, &state, fresh)) {
+        return fresh;
+    }
+    free(fresh);
+    return state;
+}
+
+static void drop_state(void* obj) {
+    _Atomic(void*)* slot = (_Atomic(void*)*)obj;
+    free(atomic_exchange(slot, NULL));
+}
+
+// Milliseconds from now until 'abstime' on 'clock', rounded up; <= 0 if it has passed
+static long ms_until(clockid_t clock, const struct timespec* abstime) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    long long ns = (abstime->tv_sec - now.tv_sec) * 1000000000LL + (abstime->tv_nsec - now.tv_nsec);
+    return ns <= 0 ? 0 : (long)((ns + 999999) / 1000000);
+}
+
+// One step of a polled timed operation: 0 once 'abstime' has passed, else sleeps and returns 1
+static int poll_wait(clockid_t clock, const struct timespec* abstime, long* sleep_us) {
+    if (ms_until(clock, abstime) <= 0) {
+        return 0;
+    }
+    struct timespec ts = { 0, *sleep_us * 1000 };
+    nanosleep(&ts, NULL);
+    if (*sleep_us < SHIM_POLL_MAX_US) {
+        *sleep_us *= 2;
+    }
+    return 1;
+}
+
+/* ---------------------------------------------------------------- mutex */
+
+/*
+ * Per-thread pool of MCS queue nodes. A node is held from lock to unlock, and a thread may
+ * hold several mutexes and release them in any order, so nodes come from a free list.
+ */
+typedef struct shim_node {
+    mcs_node node;
+    struct shim_node* free_next;
+} shim_node;
+
+static __thread shim_node* free_nodes SHIM_TLS = NULL;
+
+static shim_node* node_get(void) {
+    shim_node* n = free_nodes;
+    if (n == NULL) {
+        return alloc_state(sizeof(shim_node));
+    }
+    free_nodes = n->free_next;
+    return n;
+}
+
+static void node_put(shim_node* n) {
+    n->free_next = free_nodes;
+    free_nodes = n;
+}
+
+typedef struct {
+    mcs_lock mcs;
+    ticket_lock ticket;
+    int recursive;
+    _Atomic(void*) owner;
+    int depth;              // recursion depth, owner only
+    shim_node* node;        // MCS node of the current owner
+} shim_mutex;
+
+static void* mutex_create(void* obj) {
+    shim_mutex* m = alloc_state(sizeof(shim_mutex));
+    mcs_lock_init(&m->mcs);
+    ticketlock_init(&m->ticket);
+    // glibc keeps the type in a field our pointer does not overlay, so static recursive initializers work
+    m->recursive = (((pthread_mutex_t*)obj)->__data.__kind & 3) == PTHREAD_MUTEX_RECURSIVE;
+    return m;
+}
+
+static shim_mutex* get_mutex(pthread_mutex_t* mutex) {
+    return lazy_state(mutex, mutex_create);
+}
+
+int pthread_mutex_init(pthread_mutex_t* mutex, const pthread_mutexattr_t* attr) {
+    int type = PTHREAD_MUTEX_DEFAULT;
+    int pshared = PTHREAD_PROCESS_PRIVATE;
+    if (attr != NULL) {
+        pthread_mutexattr_gettype(attr, &type);
+        pthread_mutexattr_getpshared(attr, &pshared);
+    }
+    if (pshared == PTHREAD_PROCESS_SHARED) {
+        reject_shared("mutex");
+    }
+    memset(mutex, 0, sizeof(*mutex));
+    shim_mutex* m = mutex_create(mutex);
+    m->recursive = type == PTHREAD_MUTEX_RECURSIVE;
+    atomic_store((_Atomic(void*)*)mutex, m);
+    return 0;
+}
+
+int pthread_mutex_destroy(pthread_mutex_t* mutex) {
+    drop_state(mutex);
+    return 0;
+}
+
+static void mutex_acquired(shim_mutex* m, shim_node* node) {
+    m->node = node;
+    atomic_store_explicit(&m->owner, SELF, memory_order_relaxed);
+    m->depth = 1;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    shim_mutex* m = get_mutex(mutex);
+    if (m->recursive && atomic_load_explicit(&m->owner, memory_order_relaxed) == SELF) {
+        m->depth++;
+        return 0;
+    }
+    shim_node* node = NULL;
+    if (mutex_kind == SHIM_MCS) {
+        node = node_get();
+        mcs_lock_acquire(&m->mcs, &node->node);
+    } else {
+        ticketlock_acquire(&m->ticket);
+    }
+    mutex_acquired(m, node);
+    return 0;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t* mutex) {
+    shim_mutex* m = get_mutex(mutex);
+    if (m->recursive && atomic_load_explicit(&m->owner, memory_order_relaxed) == SELF) {
+        m->depth++;
+        return 0;
+    }
+    shim_node* node = NULL;
+    if (mutex_kind == SHIM_MCS) {
+        node = node_get();
+        if (!mcs_lock_try_acquire(&m->mcs, &node->node)) {
+            node_put(node);
+            return EBUSY;
+        }
+    } else if (!ticketlock_try_acquire(&m->ticket)) {
+        return EBUSY;
+    }
+    mutex_acquired(m, node);
+    return 0;
+}
+
+int pthread_mutex_clocklock(pthread_mutex_t* mutex, clockid_t clock, const struct timespec* abstime) {
+    long sleep_us = 1;
+    int rc;
+    while ((rc = pthread_mutex_trylock(mutex)) == EBUSY) {
+        if (!poll_wait(clock, abstime, &sleep_us)) {
+            return ETIMEDOUT;
+        }
+    }
+    return rc;
+}
+
+int pthread_mutex_timedlock(pthread_mutex_t* mutex, const struct timespec* abstime) {
+    return pthread_mutex_clocklock(mutex, CLOCK_REALTIME, abstime);
+}
+
+int pthread_mutex_unlock(pthread_mutex_t* mutex) {
+    shim_mutex* m = get_mutex(mutex);
+    if (m->recursive && --m->depth > 0) {
+        return 0;
+    }
+    shim_node* node = m->node;
+    atomic_store_explicit(&m->owner, NULL, memory_order_relaxed);
+    if (mutex_kind == SHIM_MCS) {
+        mcs_lock_release(&m->mcs, &node->node);
+        node_put(node);
+    } else {
+        ticketlock_release(&m->ticket);
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------- rwlock */
+
+typedef struct {
+    rwlock lock;
+    _Atomic(void*) writer;  // thread holding the write side, tells unlock which side to release
+} shim_rwlock;
+
+static void* rwlock_create(void* obj) {
+    (void)obj;
+    shim_rwlock* rw = alloc_state(sizeof(shim_rwlock));
+    rwlock_init(&rw->lock);
+    return rw;
+}
+
+static shim_rwlock* get_rwlock(pthread_rwlock_t* lock) {
+    return lazy_state(lock, rwlock_create);
+}
+
+int pthread_rwlock_init(pthread_rwlock_t* lock, const pthread_rwlockattr_t* attr) {
+    int pshared = PTHREAD_PROCESS_PRIVATE;
+    if (attr != NULL) {
+        pthread_rwlockattr_getpshared(attr, &pshared);
+    }
+    if (pshared == PTHREAD_PROCESS_SHARED) {
+        reject_shared("rwlock");
+    }
+    memset(lock, 0, sizeof(*lock));
+    atomic_store((_Atomic(void*)*)lock, rwlock_create(lock));
+    return 0;
+}
+
+int pthread_rwlock_destroy(pthread_rwlock_t* lock) {
+    drop_state(lock);
+    return 0;
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+    rwlock_acquire_read(&get_rwlock(lock)->lock);
+    return 0;
+}
+
+int pthread_rwlock_tryrdlock(pthread_rwlock_t* lock) {
+    return rwlock_try_acquire_read(&get_rwlock(lock)->lock) ? 0 : EBUSY;
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+    shim_rwlock* rw = get_rwlock(lock);
+    rwlock_acquire_write(&rw->lock);
+    atomic_store_explicit(&rw->writer, SELF, memory_order_relaxed);
+    return 0;
+}
+
+int pthread_rwlock_trywrlock(pthread_rwlock_t* lock) {
+    shim_rwlock* rw = get_rwlock(lock);
+    if (!rwlock_try_acquire_write(&rw->lock)) {
+        return EBUSY;
+    }
+    atomic_store_explicit(&rw->writer, SELF, memory_order_relaxed);
+    return 0;
+}
+
+int pthread_rwlock_clockrdlock(pthread_rwlock_t* lock, clockid_t clock, const struct timespec* abstime) {
+    long sleep_us = 1;
+    while (pthread_rwlock_tryrdlock(lock) == EBUSY) {
+        if (!poll_wait(clock, abstime, &sleep_us)) {
+            return ETIMEDOUT;
+        }
+    }
+    return 0;
+}
+
+int pthread_rwlock_clockwrlock(pthread_rwlock_t* lock, clockid_t clock, const struct timespec* abstime) {
+    long sleep_us = 1;
+    while (pthread_rwlock_trywrlock(lock) == EBUSY) {
+        if (!poll_wait(clock, abstime, &sleep_us)) {
+            return ETIMEDOUT;
+        }
+    }
+    return 0;
+}
+
+int pthread_rwlock_timedrdlock(pthread_rwlock_t* lock, const struct timespec* abstime) {
+    return pthread_rwlock_clockrdlock(lock, CLOCK_REALTIME, abstime);
+}
+
+int pthread_rwlock_timedwrlock(pthread_rwlock_t* lock, const struct timespec* abstime) {
+    return pthread_rwlock_clockwrlock(lock, CLOCK_REALTIME, abstime);
+}
+
+int pthread_rwlock_unlock(pthread_rwlock_t* lock) {
+    shim_rwlock* rw = get_rwlock(lock);
+    if (atomic_load_explicit(&rw->writer, memory_order_relaxed) == SELF) {
+        atomic_store_explicit(&rw->writer, NULL, memory_order_relaxed);
+        rwlock_release_write(&rw->lock);
+    } else {
+        rwlock_release_read(&rw->lock);
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------- cond */
+
+/*
+ * 'waiters', 'pending' and 'generation' are guarded by 'lock'. 'pending' counts signals no
+ * waiter has consumed yet and never exceeds 'waiters'; a broadcast releases every current
+ * waiter by starting a new generation and resets both counts.
+ */
+typedef struct {
+    condition_variable cv;
+    ticket_lock lock;       // orders waiters' unlock of the user mutex against signals
+    clockid_t clock;        // clock of pthread_cond_timedwait deadlines
+    int waiters;            // blocked in the current generation
+    int pending;            // signals still to be consumed
+    long generation;        // bumped by every broadcast
+} shim_cond;
+
+static void* cond_create(void* obj) {
+    (void)obj;
+    shim_cond* c = alloc_state(sizeof(shim_cond));
+    condition_variable_init(&c->cv);
+    ticketlock_init(&c->lock);
+    c->clock = CLOCK_REALTIME;
+    c->waiters = 0;
+    c->pending = 0;
+    c->generation = 0;
+    return c;
+}
+
+static shim_cond* get_cond(pthread_cond_t* cond) {
+    return lazy_state(cond, cond_create);
+}
+
+int pthread_cond_init(pthread_cond_t* cond, const pthread_condattr_t* attr) {
+    int pshared = PTHREAD_PROCESS_PRIVATE;
+    clockid_t clock = CLOCK_REALTIME;
+    if (attr != NULL) {
+        pthread_condattr_getpshared(attr, &pshared);
+        pthread_condattr_getclock(attr, &clock);
+    }
+    if (pshared == PTHREAD_PROCESS_SHARED) {
+        reject_shared("condition variable");
+    }
+    memset(cond, 0, sizeof(*cond));
+    shim_cond* c = cond_create(cond);
+    c->clock = clock;
+    atomic_store((_Atomic(void*)*)cond, c);
+    return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t* cond) {
+    drop_state(cond);
+    return 0;
+}
+
+/*
+ * cond_wait
+ *
+ * Releases the user's mutex completely (also a recursive one) under the internal lock and
+ * restores it afterwards. 'abstime' == NULL waits without a limit.
+ *
+ * Two signals sent before either waiter takes the token leave one token, so a waiter only
+ * returns after consuming a pending signal (or being released by a broadcast), goes back to
+ * sleep on a token without one, and passes the token on while signals are still pending.
+ */
+static int cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, clockid_t clock,
+                     const struct timespec* abstime) {
+    shim_cond* c = get_cond(cond);
+    shim_mutex* m = get_mutex(mutex);
+    int depth = m->depth;
+    int rc = 0;
+
+    ticketlock_acquire(&c->lock);
+    m->depth = 1;
+    pthread_mutex_unlock(mutex);
+    long generation = c->generation;
+    c->waiters++;
+    while (1) {
+        if (abstime == NULL) {
+            condition_variable_wait(&c->cv, &c->lock);
+        } else {
+            long ms = ms_until(clock, abstime);
+            if (ms <= 0 || condition_variable_timedwait(&c->cv, &c->lock, ms) != 0) {
+                rc = ETIMEDOUT;
+            }
+        }
+        if (c->generation != generation) {
+            rc = 0;                     // broadcast; the counts were reset for us
+            break;
+        }
+        if (c->pending > 0) {
+            c->pending--;
+            c->waiters--;
+            rc = 0;
+            break;
+        }
+        if (rc == ETIMEDOUT) {
+            c->waiters--;
+            break;
+        }
+    }
+    if (c->pending > 0) {
+        condition_variable_signal(&c->cv);
+    }
+    ticketlock_release(&c->lock);
+    pthread_mutex_lock(mutex);
+    m->depth = depth;
+    return rc;
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex) {
+    return cond_wait(cond, mutex, CLOCK_REALTIME, NULL);
+}
+
+int pthread_cond_clockwait(pthread_cond_t* cond, pthread_mutex_t* mutex, clockid_t clock,
+                           const struct timespec* abstime) {
+    return ms_until(clock, abstime) <= 0 ? ETIMEDOUT : cond_wait(cond, mutex, clock, abstime);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime) {
+    return pthread_cond_clockwait(cond, mutex, get_cond(cond)->clock, abstime);
+}
+
+int pthread_cond_signal(pthread_cond_t* cond) {
+    shim_cond* c = get_cond(cond);
+    ticketlock_acquire(&c->lock);
+    if (c->pending < c->waiters) {
+        c->pending++;
+        condition_variable_signal(&c->cv);
+    }
+    ticketlock_release(&c->lock);
+    return 0;
+}
+
+int pthread_cond_broadcast(pthread_cond_t* cond) {
+    shim_cond* c = get_cond(cond);
+    ticketlock_acquire(&c->lock);
+    if (c->waiters > 0) {
+        c->generation++;
+        c->waiters = 0;
+        c->pending = 0;
+        condition_variable_broadcast(&c->cv);
+    }
+    ticketlock_release(&c->lock);
+    return 0;
+}
+
+/* ---------------------------------------------------------------- sem */
+
+typedef union {
+    tl_semaphore tl;
+    tas_semaphore tas;
+} shim_sem;
+
+// Overlay of our fields on sem_t; glibc never stores SHIM_SEM_MAGIC in the second word
+typedef struct {
+    shim_sem* state;
+    unsigned int magic;
+} shim_sem_slot;
+
+static shim_sem* own_sem(sem_t* sem) {
+    shim_sem_slot* slot = (shim_sem_slot*)sem;
+    return slot->magic == SHIM_SEM_MAGIC ? slot->state : NULL;
+}
+
+int sem_init(sem_t* sem, int pshared, unsigned int value) {
+    if (pshared) {
+        return real_sem_init(sem, pshared, value);
+    }
+    shim_sem* s = alloc_state(sizeof(shim_sem));
+    if (sem_kind == SHIM_SEM_TAS) {
+        tas_semaphore_init(&s->tas, (int)value);
+    } else {
+        tl_semaphore_init(&s->tl, (int)value);
+    }
+    shim_sem_slot* slot = (shim_sem_slot*)sem;
+    slot->state = s;
+    slot->magic = SHIM_SEM_MAGIC;
+    return 0;
+}
+
+int sem_destroy(sem_t* sem) {
+    shim_sem* s = own_sem(sem);
+    if (s == NULL) {
+        return real_sem_destroy(sem);
+    }
+    memset(sem, 0, sizeof(*sem));
+    free(s);
+    return 0;
+}
+
+int sem_wait(sem_t* sem) {
+    shim_sem* s = own_sem(sem);
+    if (s == NULL) {
+        return real_sem_wait(sem);
+    }
+    if (sem_kind == SHIM_SEM_TAS) {
+        tas_semaphore_wait(&s->tas);
+    } else {
+        tl_semaphore_wait(&s->tl);
+    }
+    return 0;
+}
+
+int sem_trywait(sem_t* sem) {
+    shim_sem* s = own_sem(sem);
+    if (s == NULL) {
+        return real_sem_trywait(sem);
+    }
+    int taken = sem_kind == SHIM_SEM_TAS ? tas_semaphore_try_wait_n(&s->tas, 1)
+                                         : tl_semaphore_try_wait_n(&s->tl, 1);
+    if (!taken) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return 0;
+}
+
+int sem_clockwait(sem_t* sem, clockid_t clock, const struct timespec* abstime) {
+    if (own_sem(sem) == NULL) {
+        return real_sem_clockwait(sem, clock, abstime);
+    }
+    long sleep_us = 1;
+    while (sem_trywait(sem) != 0) {
+        if (!poll_wait(clock, abstime, &sleep_us)) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int sem_timedwait(sem_t* sem, const struct timespec* abstime) {
+    if (own_sem(sem) == NULL) {
+        return real_sem_timedwait(sem, abstime);
+    }
+    return sem_clockwait(sem, CLOCK_REALTIME, abstime);
+}
+
+int sem_post(sem_t* sem) {
+    shim_sem* s = own_sem(sem);
+    if (s == NULL) {
+        return real_sem_post(sem);
+    }
+    if (sem_kind == SHIM_SEM_TAS) {
+        tas_semaphore_signal(&s->tas);
+    } else {
+        tl_semaphore_signal(&s->tl);
+    }
+    return 0;
+}
+
+int sem_getvalue(sem_t* sem, int* value) {
+    shim_sem* s = own_sem(sem);
+    if (s == NULL) {
+        return real_sem_getvalue(sem, value);
+    }
+    *value = sem_kind == SHIM_SEM_TAS ? atomic_load(&s->tas.value) : atomic_load(&s->tl.value);
+    return 0;
+}
@@ -7,11 +7,14 @@
  * and synchronization among threads. The semaphore is initialized with a given value, and supports
  * wait (P) and signal (V) operations.
  *
+ * The value is only changed while holding the flag, whose acquire and release order it, so
+ * the value itself is accessed relaxed.
+ *
  * Author: Noam Hasson, Asaf Ramati
  */
 
 #include "tas_semaphore.h"
-#include <sched.h>
+#include <limits.h>
 
 /*
  * semaphore_init
@@ -22,28 +25,104 @@
 void semaphore_init(semaphore* sem, int initial_value) {
     atomic_init(&sem->value, initial_value);
     atomic_flag_clear(&sem->lock);
+    atomic_init(&sem->parked, 0);
+    wait_policy_default(&sem->policy);
+    async_waitq_init(&sem->async);
+    LOCK_STATS_INIT(sem, "tas_semaphore");
+}
+
+/*
+ * semaphore_init_shared
+ *
+ * Apart from the async waiter queue the struct is plain counters, so it only needs futexes
+ * that work across processes. The queue holds pointers into one process, so it stays empty
+ * here: semaphore_wait_async refuses a process-shared semaphore.
+ */
+void semaphore_init_shared(semaphore* sem, int initial_value) {
+    semaphore_init(sem, initial_value);
+    sem->policy.pshared = 1;
+}
+
+/*
+ * Spins on the test-and-set flag. The flag cannot be parked on, so the
+ * policy only spins and yields here; it is only held for a few instructions.
+ */
+static void tas_lock(semaphore* sem) {
+    wait_state ws = WAIT_STATE_INIT;
+    while (atomic_flag_test_and_set_explicit(&sem->lock, ORDER_ACQUIRE)) {
+        wait_pause(&sem->policy, &ws, NULL, 0, NULL);
+    }
 }
 
 /*
  * semaphore_wait
  *
- * Wait (P) operation for the TAS semaphore.
- * Spins until the lock is acquired, then waits for the value to be positive.
- * Once allowed, the thread decrements the semaphore value and releases the lock.
+ * Wait (P) operation for the TAS semaphore: a request for a single permit.
  */
 void semaphore_wait(semaphore* sem) {
+    semaphore_wait_n(sem, 1);
+}
+
+/*
+ * semaphore_wait_n
+ *
+ * Spins until the lock is acquired, then checks whether 'n' permits are available.
+ * If so, the thread takes all of them and releases the lock; otherwise it releases
+ * the lock without taking anything and waits for the value to change.
+ */
+void semaphore_wait_n(semaphore* sem, int n) {
+    LOCK_STATS_BEGIN(stats);
+    wait_state ws = WAIT_STATE_INIT;
     while (1) {
-        while (atomic_flag_test_and_set(&sem->lock)) {
-            sched_yield();
-        }
-        if (atomic_load(&sem->value) > 0) {
-            atomic_fetch_sub(&sem->value, 1);
-            atomic_flag_clear(&sem->lock);
+        tas_lock(sem);
+        int value = atomic_load_explicit(&sem->value, ORDER_RELAXED);
+        if (value >= n) {
+            atomic_fetch_sub_explicit(&sem->value, n, ORDER_RELAXED);
+            atomic_flag_clear_explicit(&sem->lock, ORDER_RELEASE);
             break;
         }
-        atomic_flag_clear(&sem->lock);
-        sched_yield();
+        atomic_flag_clear_explicit(&sem->lock, ORDER_RELEASE);
+        LOCK_STATS_SPIN(stats);
+        wait_pause(&sem->policy, &ws, &sem->value, value, &sem->parked);
+    }
+    LOCK_STATS_ACQUIRED(sem, stats);
+}
+
+/*
+ * semaphore_try_wait_n
+ *
+ * Same check as semaphore_wait_n, but gives up instead of waiting.
+ */
+int semaphore_try_wait_n(semaphore* sem, int n) {
+    tas_lock(sem);
+    int taken = atomic_load_explicit(&sem->value, ORDER_RELAXED) >= n;
+    if (taken) {
+        atomic_fetch_sub_explicit(&sem->value, n, ORDER_RELAXED);
     }
+    atomic_flag_clear_explicit(&sem->lock, ORDER_RELEASE);
+    return taken;
+}
+
+/*
+ * tas_serve_async
+ *
+ * Takes permits for the queued async waiters, oldest first, for as long as the head's
+ * request can be met, then completes the served waiters outside the queue lock.
+ * A failed attempt holds nothing, so only adding permits can let a waiter through.
+ */
+static void tas_serve_async(semaphore* sem) {
+    if (atomic_load(&sem->async.count) == 0) {
+        return;
+    }
+    async_waiter* served = NULL;
+    async_waiter** tail = &served;
+    async_waitq_lock(&sem->async);
+    while (sem->async.head != NULL && semaphore_try_wait_n(sem, sem->async.head->permits)) {
+        *tail = async_waitq_pop_locked(&sem->async);
+        tail = &(*tail)->next;
+    }
+    async_waitq_unlock(&sem->async);
+    async_waiter_complete_all(served);
 }
 
 /*
@@ -53,9 +132,49 @@ void semaphore_wait(semaphore* sem) {
  * Increments the semaphore value, potentially allowing another waiting thread to proceed.
  */
 void semaphore_signal(semaphore* sem) {
-    while (atomic_flag_test_and_set(&sem->lock)) {
-        sched_yield();
+    semaphore_signal_n(sem, 1);
+}
+
+/*
+ * semaphore_signal_n
+ *
+ * Adds 'n' permits. Every parked waiter is woken: waiters may ask for different
+ * amounts, and waking only one could pick a thread that still cannot proceed
+ * while another one that could stays asleep.
+ */
+void semaphore_signal_n(semaphore* sem, int n) {
+    tas_lock(sem);
+    atomic_fetch_add_explicit(&sem->value, n, ORDER_RELAXED);
+    atomic_flag_clear_explicit(&sem->lock, ORDER_RELEASE);
+    wait_wake(&sem->policy, &sem->value, &sem->parked, INT_MAX);
+    tas_serve_async(sem);
+    LOCK_STATS_RELEASED(sem);
+}
+
+/*
+ * semaphore_wait_async
+ *
+ * Tries once, then queues the waiter and serves the queue itself, in case the permits
+ * arrived after the try but before a signaler could see the waiter.
+ */
+int semaphore_wait_async(semaphore* sem, async_waiter* w, int n) {
+    if (sem->policy.pshared) {
+        return -1;
     }
-    atomic_fetch_add(&sem->value, 1);
-    atomic_flag_clear(&sem->lock);
+    if (semaphore_try_wait_n(sem, n)) {
+        return 1;
+    }
+    w->permits = n;
+    async_waitq_push(&sem->async, w);
+    tas_serve_async(sem);
+    return 0;
+}
+
+/*
+ * semaphore_cancel_async
+ *
+ * A removed waiter took nothing; one the queue no longer holds was already served.
+ */
+int semaphore_cancel_async(semaphore* sem, async_waiter* w) {
+    return async_waitq_remove(&sem->async, w);
 }
@@ -2,6 +2,9 @@
 #define TAS_SEMAPHORE_H
 
 #include <stdatomic.h>
+#include "../common/async_wait.h"
+#include "../common/lock_stats.h"
+#include "../common/wait_policy.h"
 
 /*
  * Define the semaphore type.
@@ -10,6 +13,10 @@
 typedef struct {
     atomic_int value;
     atomic_flag lock;
+    atomic_int parked;
+    wait_policy policy;
+    async_waitq async;
+    LOCK_STATS_FIELD
 } semaphore;
 
 /*
@@ -17,6 +24,12 @@ typedef struct {
  */
 void semaphore_init(semaphore* sem, int initial_value);
 
+/*
+ * Initializes the semaphore for use by several processes. 'sem' must live in memory shared
+ * between them (e.g. an shm_arena); every process then uses the normal wait and signal.
+ */
+void semaphore_init_shared(semaphore* sem, int initial_value);
+
 /*
  * Decrements the semaphore (wait operation).
  */
@@ -27,4 +40,34 @@ void semaphore_wait(semaphore* sem);
  */
 void semaphore_signal(semaphore* sem);
 
+/*
+ * Takes 'n' permits (n >= 1) at once, blocking until all of them are available.
+ * Permits are never taken partially, so two threads each waiting for several
+ * permits cannot deadlock by holding a share of them.
+ */
+void semaphore_wait_n(semaphore* sem, int n);
+
+/*
+ * Takes 'n' permits if they are available right now. Returns 1 if taken, 0 otherwise.
+ */
+int semaphore_try_wait_n(semaphore* sem, int n);
+
+/*
+ * Returns 'n' permits (n >= 1) with a single atomic update.
+ */
+void semaphore_signal_n(semaphore* sem, int n);
+
+/*
+ * Asks for 'n' permits without blocking (see async_wait.h). Returns 1 if they were taken
+ * right away and 'w' was not used, 0 if 'w' was queued and completes once the permits have
+ * been taken on its behalf, -1 for a process-shared semaphore.
+ */
+int semaphore_wait_async(semaphore* sem, async_waiter* w, int n);
+
+/*
+ * Withdraws a queued async waiter. Returns 1 if it was removed, 0 if it has completed or is
+ * completing: the permits then belong to the caller, who still receives the completion.
+ */
+int semaphore_cancel_async(semaphore* sem, async_waiter* w);
+
 #endif // TAS_SEMAPHORE_H
\ No newline at end of file
@@ -7,10 +7,14 @@
  * among waiting threads. The semaphore is initialized with a given value, and supports
  * wait (P) and signal (V) operations.
  *
+ * Only the holder of the current turn ever writes cur_ticket, so giving the turn back is a
+ * release store of the next ticket rather than an atomic add.
+ *
  * Author: Noam Hasson, Asaf Ramati
  */
 
 #include "tl_semaphore.h"
+#include <limits.h>
 
 /*
  * semaphore_init
@@ -22,25 +26,118 @@ void semaphore_init(semaphore* sem, int initial_value) {
     atomic_init(&sem->value, initial_value);
     atomic_init(&sem->ticket, 0);
     atomic_init(&sem->cur_ticket, 0);
+    atomic_init(&sem->parked, 0);
+    wait_policy_default(&sem->policy);
+    async_waitq_init(&sem->async);
+    LOCK_STATS_INIT(sem, "tl_semaphore");
+}
+
+/*
+ * semaphore_init_shared
+ *
+ * Apart from the async waiter queue the struct is plain counters, so it only needs futexes
+ * that work across processes. The queue holds pointers into one process, so it stays empty
+ * here: semaphore_wait_async refuses a process-shared semaphore.
+ */
+void semaphore_init_shared(semaphore* sem, int initial_value) {
+    semaphore_init(sem, initial_value);
+    sem->policy.pshared = 1;
 }
 
+static void tl_serve_async(semaphore* sem);
+
 /*
  * semaphore_wait
  *
- * Wait (P) operation for the ticket lock semaphore.
- * Each thread obtains a ticket and waits until it is their turn and the semaphore value is positive.
- * Once allowed, the thread decrements the semaphore value and advances the ticket.
+ * Wait (P) operation for the ticket lock semaphore: a request for a single permit.
  */
 void semaphore_wait(semaphore* sem) {
-    int my_ticket = atomic_fetch_add(&sem->ticket, 1);
-    while(atomic_load(&sem->cur_ticket) != my_ticket){
-        sched_yield(); 
+    semaphore_wait_n(sem, 1);
+}
+
+/*
+ * semaphore_wait_n
+ *
+ * Each thread obtains a ticket and waits until it is their turn and at least 'n' permits
+ * are available. Only the head of the queue ever takes permits, and it takes all 'n' at
+ * once, so nobody holds part of a request while waiting. FIFO order also means a large
+ * request is not starved by a stream of small ones.
+ */
+void semaphore_wait_n(semaphore* sem, int n) {
+    LOCK_STATS_BEGIN(stats);
+    wait_state ws = WAIT_STATE_INIT;
+    int my_ticket = atomic_fetch_add_explicit(&sem->ticket, 1, ORDER_RELAXED);
+    int cur;
+    while((cur = atomic_load_explicit(&sem->cur_ticket, ORDER_ACQUIRE)) != my_ticket){
+        LOCK_STATS_SPIN(stats);
+        wait_pause(&sem->policy, &ws, &sem->cur_ticket, cur, &sem->parked);
+    }
+    int value;
+    while ((value = atomic_load_explicit(&sem->value, ORDER_ACQUIRE)) < n) {
+        LOCK_STATS_SPIN(stats);
+        wait_pause(&sem->policy, &ws, &sem->value, value, &sem->parked);
+    }
+    atomic_fetch_sub_explicit(&sem->value, n, ORDER_RELAXED);
+    atomic_store_explicit(&sem->cur_ticket, my_ticket + 1, ORDER_RELEASE);
+    wait_wake(&sem->policy, &sem->cur_ticket, &sem->parked, INT_MAX); // the next ticket holder may be asleep
+    tl_serve_async(sem);   // async waiters could not take permits while we held the turn
+    LOCK_STATS_ACQUIRED(sem, stats);
+}
+
+/*
+ * tl_try_take
+ *
+ * Only succeeds when nobody is queued: the caller takes the next ticket with a CAS
+ * that fails if another thread holds or waits for a turn, then behaves like the head
+ * of the queue without waiting and always gives its turn back.
+ */
+static int tl_try_take(semaphore* sem, int n) {
+    int cur = atomic_load_explicit(&sem->cur_ticket, ORDER_ACQUIRE);
+    if (atomic_load(&sem->value) < n ||   // sequentially consistent, see semaphore_signal_n
+        !atomic_compare_exchange_strong_explicit(&sem->ticket, &cur, cur + 1, ORDER_ACQUIRE, ORDER_RELAXED)) {
+        return 0;
+    }
+    int taken = atomic_load_explicit(&sem->value, ORDER_ACQUIRE) >= n;
+    if (taken) {
+        atomic_fetch_sub_explicit(&sem->value, n, ORDER_RELAXED);
+    }
+    atomic_store_explicit(&sem->cur_ticket, cur + 1, ORDER_RELEASE);
+    wait_wake(&sem->policy, &sem->cur_ticket, &sem->parked, INT_MAX);
+    return taken;
+}
+
+/*
+ * tl_serve_async
+ *
+ * Takes permits for the queued async waiters, oldest first, for as long as the head's
+ * request can be met, then completes the served waiters outside the queue lock.
+ * Async waiters take permits like semaphore_try_wait_n, between the turns of blocking
+ * waiters, so every path that adds permits or gives back a turn calls this.
+ */
+static void tl_serve_async(semaphore* sem) {
+    if (atomic_load(&sem->async.count) == 0) {
+        return;
     }
-    while (atomic_load(&sem->value) <= 0) { 
-        sched_yield(); 
+    async_waiter* served = NULL;
+    async_waiter** tail = &served;
+    async_waitq_lock(&sem->async);
+    while (sem->async.head != NULL && tl_try_take(sem, sem->async.head->permits)) {
+        *tail = async_waitq_pop_locked(&sem->async);
+        tail = &(*tail)->next;
     }
-    atomic_fetch_sub(&sem->value , 1);
-    atomic_fetch_add(&sem->cur_ticket, 1);
+    async_waitq_unlock(&sem->async);
+    async_waiter_complete_all(served);
+}
+
+/*
+ * semaphore_try_wait_n
+ *
+ * A turn taken and given back may have kept an async waiter from its permits.
+ */
+int semaphore_try_wait_n(semaphore* sem, int n) {
+    int taken = tl_try_take(sem, n);
+    tl_serve_async(sem);
+    return taken;
 }
 
 /*
@@ -50,5 +147,47 @@ void semaphore_wait(semaphore* sem) {
  * Increments the semaphore value, potentially allowing another waiting thread to proceed.
  */
 void semaphore_signal(semaphore* sem) {
-    atomic_fetch_add(&sem->value, 1);
+    semaphore_signal_n(sem, 1);
+}
+
+/*
+ * semaphore_signal_n
+ *
+ * Adds 'n' permits with one atomic add. The add stays sequentially consistent: an async
+ * waiter queues itself and then looks at the value, the signaler changes the value and then
+ * looks at the queue, and one of the two has to see the other.
+ */
+void semaphore_signal_n(semaphore* sem, int n) {
+    atomic_fetch_add(&sem->value, n);
+    wait_wake(&sem->policy, &sem->value, &sem->parked, 1); // only the head of the queue waits on the value
+    tl_serve_async(sem);
+    LOCK_STATS_RELEASED(sem);
+}
+
+/*
+ * semaphore_wait_async
+ *
+ * Tries once, then queues the waiter and serves the queue itself, in case the permits
+ * arrived after the try but before a signaler could see the waiter.
+ */
+int semaphore_wait_async(semaphore* sem, async_waiter* w, int n) {
+    if (sem->policy.pshared) {
+        return -1;
+    }
+    if (tl_try_take(sem, n)) {
+        return 1;
+    }
+    w->permits = n;
+    async_waitq_push(&sem->async, w);
+    tl_serve_async(sem);
+    return 0;
+}
+
+/*
+ * semaphore_cancel_async
+ *
+ * A removed waiter took nothing; one the queue no longer holds was already served.
+ */
+int semaphore_cancel_async(semaphore* sem, async_waiter* w) {
+    return async_waitq_remove(&sem->async, w);
 }
@@ -0,0 +1,169 @@
+/*
+ * barrier.c
+ * ----------------
+ * Implementation of reusable barriers and a one-shot countdown latch.
+ *
+ * Two barrier flavours are provided:
+ *   - sense_barrier: centralized counter with sense reversal. Cheap for small thread counts,
+ *     the whole phase is released by a single store to the shared sense flag.
+ *   - dissemination_barrier: log2(N) rounds of pairwise signalling with no shared counter,
+ *     which scales better once many threads would otherwise hammer the same cache line.
+ *
+ * Arrivals are releases and the waits acquires. In the sense barrier the arrivals form one
+ * chain of read-modify-writes on the counter, so the last thread's release of the sense
+ * carries every arrival's writes to all waiters.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "barrier.h"
+#include <limits.h>
+#include <stdlib.h>
+
+/*
+ * sense_barrier_init
+ *
+ * Initializes the barrier: no thread has arrived yet and the sense starts at 0.
+ */
+void sense_barrier_init(sense_barrier* barrier, int parties) {
+    barrier->parties = parties;
+    atomic_init(&barrier->count, parties);
+    atomic_init(&barrier->sense, 0);
+    atomic_init(&barrier->parked, 0);
+    wait_policy_default(&barrier->policy);
+}
+
+/*
+ * sense_barrier_wait
+ *
+ * Each thread reads the current sense before arriving, so it knows which value
+ * marks the end of this phase. The last thread to arrive resets the counter for
+ * the next phase and then flips the sense, releasing every waiter at once.
+ */
+int sense_barrier_wait(sense_barrier* barrier) {
+    int my_sense = !atomic_load_explicit(&barrier->sense, ORDER_RELAXED);
+
+    if (atomic_fetch_sub_explicit(&barrier->count, 1, ORDER_ACQ_REL) == 1) {
+        atomic_store_explicit(&barrier->count, barrier->parties, ORDER_RELAXED); // reset before releasing anyone
+        atomic_store_explicit(&barrier->sense, my_sense, ORDER_RELEASE);
+        wait_wake(&barrier->policy, &barrier->sense, &barrier->parked, INT_MAX);
+        return 1;
+    }
+
+    wait_state ws = WAIT_STATE_INIT;
+    while (atomic_load_explicit(&barrier->sense, ORDER_ACQUIRE) != my_sense) {
+        wait_pause(&barrier->policy, &ws, &barrier->sense, !my_sense, &barrier->parked);
+    }
+    return 0;
+}
+
+/*
+ * dissemination_barrier_init
+ *
+ * Allocates two parities worth of per-round flags so that a phase can never
+ * overwrite flags still being read by the previous one.
+ */
+int dissemination_barrier_init(dissemination_barrier* barrier, int parties) {
+    int rounds = 0;
+    while ((1 << rounds) < parties) {
+        rounds++;
+    }
+
+    barrier->parties = parties;
+    barrier->rounds = rounds;
+    atomic_init(&barrier->parked, 0);
+    wait_policy_default(&barrier->policy);
+    barrier->flags = calloc((size_t)2 * (rounds ? rounds : 1) * parties, sizeof(barrier_flag_t));
+    barrier->local = calloc(parties, sizeof(barrier_local_t));
+    if (barrier->flags == NULL || barrier->local == NULL) {
+        free(barrier->flags);
+        free(barrier->local);
+        return -1;
+    }
+
+    for (int i = 0; i < 2 * rounds * parties; i++) {
+        atomic_init(&barrier->flags[i].flag, 0);
+    }
+    for (int i = 0; i < parties; i++) {
+        barrier->local[i].parity = 0;
+        barrier->local[i].sense = 1;
+    }
+    return 0;
+}
+
+/*
+ * dissemination_barrier_wait
+ *
+ * In round k, thread i notifies thread (i + 2^k) % N and waits to be notified by
+ * thread (i - 2^k) % N. After the last round every thread has transitively heard
+ * from all others. Sense flips every second phase to make the flags reusable.
+ */
+void dissemination_barrier_wait(dissemination_barrier* barrier, int id) {
+    barrier_local_t* me = &barrier->local[id];
+    int n = barrier->parties;
+    barrier_flag_t* flags = barrier->flags + (size_t)me->parity * barrier->rounds * n;
+
+    for (int k = 0; k < barrier->rounds; k++) {
+        int partner = (id + (1 << k)) % n;
+        atomic_store_explicit(&flags[k * n + partner].flag, me->sense, ORDER_RELEASE);
+        wait_wake(&barrier->policy, &flags[k * n + partner].flag, &barrier->parked, 1);
+
+        wait_state ws = WAIT_STATE_INIT;
+        while (atomic_load_explicit(&flags[k * n + id].flag, ORDER_ACQUIRE) != me->sense) {
+            wait_pause(&barrier->policy, &ws, &flags[k * n + id].flag, !me->sense, &barrier->parked);
+        }
+    }
+
+    if (me->parity == 1) {
+        me->sense = !me->sense;
+    }
+    me->parity = 1 - me->parity;
+}
+
+/*
+ * dissemination_barrier_destroy
+ *
+ * Frees the flag arrays. No thread may be inside the barrier.
+ */
+void dissemination_barrier_destroy(dissemination_barrier* barrier) {
+    free(barrier->flags);
+    free(barrier->local);
+    barrier->flags = NULL;
+    barrier->local = NULL;
+}
+
+// Initializes the latch with the number of arrivals needed to open it
+void countdown_latch_init(countdown_latch* latch, int count) {
+    atomic_init(&latch->count, count);
+    atomic_init(&latch->parked, 0);
+    wait_policy_default(&latch->policy);
+}
+
+/*
+ * countdown_latch_count_down
+ *
+ * Decrements the count; extra calls after the latch opened are ignored.
+ */
+void countdown_latch_count_down(countdown_latch* latch) {
+    int cur = atomic_load_explicit(&latch->count, ORDER_RELAXED);
+    while (cur > 0 && !atomic_compare_exchange_weak_explicit(&latch->count, &cur, cur - 1,
+                                                              ORDER_RELEASE, ORDER_RELAXED)) {
+        // cur was reloaded by the failed CAS, retry
+    }
+    if (cur == 1) {
+        wait_wake(&latch->policy, &latch->count, &latch->parked, INT_MAX);
+    }
+}
+
+/*
+ * countdown_latch_wait
+ *
+ * Waits, following the latch's wait policy, until the count reaches zero.
+ */
+void countdown_latch_wait(countdown_latch* latch) {
+    wait_state ws = WAIT_STATE_INIT;
+    int cur;
+    while ((cur = atomic_load_explicit(&latch->count, ORDER_ACQUIRE)) > 0) {
+        wait_pause(&latch->policy, &ws, &latch->count, cur, &latch->parked);
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <stdatomic.h>
+#include "../common/wait_policy.h"
+
+#define BARRIER_CACHE_LINE 64
+
+/*
+ * Define the centralized sense-reversing barrier type.
+ * The last thread to arrive flips 'sense', releasing everyone spinning on it
+ * with a single store instead of one wakeup per waiter.
+ */
+typedef struct {
+    atomic_int count;   // threads still expected in the current phase
+    atomic_int sense;   // flips once per completed phase
+    int parties;        // number of threads taking part in every phase
+    atomic_int parked;
+    wait_policy policy;
+} sense_barrier;
+
+/*
+ * Per-thread flag of the dissemination barrier, padded to its own cache line
+ * so that every round only touches the partner's line.
+ */
+typedef struct {
+    atomic_int flag;
+    char pad[BARRIER_CACHE_LINE - sizeof(atomic_int)];
+} barrier_flag_t;
+
+/*
+ * Per-thread bookkeeping of the dissemination barrier (parity and sense).
+ * Only ever touched by the owning thread.
+ */
+typedef struct {
+    int parity;
+    int sense;
+    char pad[BARRIER_CACHE_LINE - 2 * sizeof(int)];
+} barrier_local_t;
+
+/*
+ * Define the dissemination barrier type.
+ * Every thread signals a partner at distance 2^k in round k, so a phase
+ * completes in ceil(log2(parties)) rounds without any shared counter.
+ */
+typedef struct {
+    int parties;
+    int rounds;
+    barrier_flag_t* flags;   // [2 parities][rounds][parties]
+    barrier_local_t* local;  // [parties]
+    atomic_int parked;       // only touched by threads that go to sleep
+    wait_policy policy;
+} dissemination_barrier;
+
+/*
+ * Define the one-shot countdown latch type.
+ */
+typedef struct {
+    atomic_int count;
+    atomic_int parked;
+    wait_policy policy;
+} countdown_latch;
+
+/*
+ * Initializes the sense-reversing barrier for 'parties' threads.
+ */
+void sense_barrier_init(sense_barrier* barrier, int parties);
+
+/*
+ * Blocks until all 'parties' threads have called sense_barrier_wait for the current phase.
+ * Returns 1 in exactly one thread per phase (the last to arrive), 0 in all others.
+ */
+int sense_barrier_wait(sense_barrier* barrier);
+
+/*
+ * Initializes the dissemination barrier for 'parties' threads.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int dissemination_barrier_init(dissemination_barrier* barrier, int parties);
+
+/*
+ * Blocks until all threads have reached the barrier.
+ * 'id' is the caller's index in [0, parties) and must be unique per thread.
+ */
+void dissemination_barrier_wait(dissemination_barrier* barrier, int id);
+
+/*
+ * Releases the memory held by the dissemination barrier.
+ */
+void dissemination_barrier_destroy(dissemination_barrier* barrier);
+
+/*
+ * Initializes the latch with the number of count_down calls needed to open it.
+ */
+void countdown_latch_init(countdown_latch* latch, int count);
+
+/*
+ * Decrements the latch count. The call that brings it to zero releases all waiters.
+ */
+void countdown_latch_count_down(countdown_latch* latch);
+
+/*
+ * Blocks until the latch count reaches zero. Returns immediately once the latch is open.
+ */
+void countdown_latch_wait(countdown_latch* latch);
+
+#endif // BARRIER_H
@@ -0,0 +1,92 @@
+/*
+ * cohort_lock.c
+ *
+ * Implementation of the cohort lock from two levels of ticket locks.
+ *
+ * Ownership of the global lock is a token that travels with the local lock: whoever holds a
+ * node's local lock with 'global_passed' set also owns the global lock. Both fields of
+ * cohort_node are only read or written while holding that node's local lock, so they need
+ * no atomics; the local lock's release/acquire orders them.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "cohort_lock.h"
+#include "../common/topology.h"
+#include <stdlib.h>
+
+/*
+ * cohort_lock_init
+ *
+ * Sizes the lock for the current machine: one cohort per node, a single one when the
+ * topology is unknown (it then behaves like two nested ticket locks).
+ */
+int cohort_lock_init(cohort_lock* lock, int pass_limit) {
+    int nodes = topology_node_count();
+    lock->node = aligned_alloc(COHORT_CACHE_LINE, sizeof(cohort_node) * nodes);
+    if (lock->node == NULL) {
+        return -1;
+    }
+    ticketlock_init(&lock->global);
+    lock->nodes = nodes;
+    lock->pass_limit = pass_limit > 0 ? pass_limit : COHORT_PASS_LIMIT;
+    lock->owner_node = 0;
+    for (int i = 0; i < nodes; i++) {
+        ticketlock_init(&lock->node[i].local);
+        lock->node[i].global_passed = 0;
+        lock->node[i].passes = 0;
+    }
+    return 0;
+}
+
+/*
+ * cohort_lock_acquire
+ *
+ * Queues on the local lock of the node the thread is running on. If the previous local
+ * holder passed the global lock along, the thread owns the whole lock right away;
+ * otherwise it is the first of a new cohort and competes for the global lock.
+ */
+void cohort_lock_acquire(cohort_lock* lock) {
+    int n = topology_current_node() % lock->nodes;
+    cohort_node* node = &lock->node[n];
+
+    ticketlock_acquire(&node->local);
+    if (node->global_passed) {
+        node->global_passed = 0;
+    } else {
+        ticketlock_acquire(&lock->global);
+        node->passes = 0;
+    }
+    lock->owner_node = n;
+}
+
+// A local waiter is queued when tickets were handed out beyond the one being served
+static int local_has_waiters(ticket_lock* local) {
+    // only a hint, a waiter that arrives right after the check just waits for the next cohort
+    return atomic_load_explicit(&local->ticket, ORDER_RELAXED) -
+           atomic_load_explicit(&local->cur_ticket, ORDER_RELAXED) > 1;
+}
+
+/*
+ * cohort_lock_release
+ *
+ * Hands the global lock to the next thread of the same node while one is waiting and the
+ * cohort has not used up its pass limit. Otherwise the global lock is released first, so a
+ * waiter on another node can take it, and then the local lock.
+ */
+void cohort_lock_release(cohort_lock* lock) {
+    cohort_node* node = &lock->node[lock->owner_node];
+
+    if (node->passes < lock->pass_limit && local_has_waiters(&node->local)) {
+        node->passes++;
+        node->global_passed = 1;
+    } else {
+        ticketlock_release(&lock->global);
+    }
+    ticketlock_release(&node->local);
+}
+
+void cohort_lock_destroy(cohort_lock* lock) {
+    free(lock->node);
+    lock->node = NULL;
+}
@@ -0,0 +1,57 @@
+#ifndef COHORT_LOCK_H
+#define COHORT_LOCK_H
+
+#include "cond_var.h"
+
+#define COHORT_CACHE_LINE 64
+#define COHORT_PASS_LIMIT 64   // default bound on consecutive handoffs inside one node
+
+/*
+ * Per-node part of the cohort lock, on its own cache line so that threads of one node
+ * never touch another node's line while queueing.
+ */
+typedef struct {
+    _Alignas(COHORT_CACHE_LINE) ticket_lock local;
+    int global_passed;  // the global lock was handed over together with 'local'
+    int passes;         // consecutive local handoffs since the global lock was taken
+} cohort_node;
+
+/*
+ * Define the NUMA-aware cohort lock type (C-TKT-TKT).
+ * A thread first takes its node's local ticket lock, then the global ticket lock. On release,
+ * if another thread of the same node is queued on the local lock, the global lock is passed
+ * along with the local one instead of being released, up to 'pass_limit' times in a row.
+ * The lock stays on one socket's caches for a whole cohort, and the limit keeps other nodes
+ * from starving.
+ */
+typedef struct {
+    _Alignas(COHORT_CACHE_LINE) ticket_lock global;
+    int nodes;
+    int pass_limit;
+    int owner_node;      // node whose local lock the current holder took
+    cohort_node* node;   // [nodes]
+} cohort_lock;
+
+/*
+ * Initializes the lock with one cohort per NUMA node (see common/topology.h).
+ * 'pass_limit' <= 0 selects COHORT_PASS_LIMIT.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int cohort_lock_init(cohort_lock* lock, int pass_limit);
+
+/*
+ * Acquires the lock. Threads are queued FIFO within a node.
+ */
+void cohort_lock_acquire(cohort_lock* lock);
+
+/*
+ * Releases the lock, preferring a waiter on the same node.
+ */
+void cohort_lock_release(cohort_lock* lock);
+
+/*
+ * Frees the per-node state. The lock must not be held.
+ */
+void cohort_lock_destroy(cohort_lock* lock);
+
+#endif // COHORT_LOCK_H
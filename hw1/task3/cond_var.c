@@ -6,23 +6,56 @@
  * This file provides a simple condition variable mechanism using atomic flags and counters,
  * as well as a FIFO ticket lock for mutual exclusion. These primitives are designed to be
  * used in multi-threaded environments for safe coordination between threads.
+ * Waiting follows each instance's wait_policy (spin, yield, then futex park).
+ *
+ * Only the holder of a ticket lock writes cur_ticket, so releasing it is a release store of
+ * the next ticket rather than an atomic add. The condition variable's 'waiters' counter keeps
+ * sequentially consistent accesses: signalers are allowed to run without the external lock,
+ * and a waiter that announced itself has to be seen by any signal that comes after.
  *
  * Author: Noam Hasson, Asaf Ramati
  */
 
 #include "cond_var.h"
-#include <sched.h>
+#include "../common/lock_trace.h"
+#include <limits.h>
+#include <time.h>
 
 // Initializes the condition variable: sets the flag to false and waiters to 0
 void condition_variable_init(condition_variable* cv) {
     atomic_flag_clear(&cv->lock);       // Initially, no signal
     atomic_init(&cv->waiters, 0);       // No threads waiting
+    atomic_init(&cv->seq, 0);
+    atomic_init(&cv->epoch, 0);
+    atomic_init(&cv->parked, 0);
+    wait_policy_default(&cv->policy);
+    async_waitq_init(&cv->async);
+    LOCK_STATS_INIT(cv, "condition_variable");
 }
 
 // Initializes the ticket lock to its initial state
 void ticketlock_init(ticket_lock* lock) {
     atomic_init(&lock->ticket, 0);      // Next ticket to give out
     atomic_init(&lock->cur_ticket, 0);  // Ticket currently being served
+    atomic_init(&lock->parked, 0);
+    wait_policy_default(&lock->policy);
+    LOCK_STATS_INIT(lock, "ticket_lock");
+}
+
+/*
+ * Process-shared variants. The ticket lock is plain counters, and so is the condition
+ * variable apart from its async waiter queue, so only the futex operations used for parking
+ * have to change. The queue holds pointers into one process, so it stays empty here:
+ * condition_variable_wait_async refuses a process-shared condition variable.
+ */
+void condition_variable_init_shared(condition_variable* cv) {
+    condition_variable_init(cv);
+    cv->policy.pshared = 1;
+}
+
+void ticketlock_init_shared(ticket_lock* lock) {
+    ticketlock_init(lock);
+    lock->policy.pshared = 1;
 }
 
 /*
@@ -30,17 +63,69 @@ void ticketlock_init(ticket_lock* lock) {
  *
  * Causes the calling thread to wait on the condition variable.
  * The thread increments the waiters count, releases the external lock,
- * and spins until the signal flag is cleared by another thread.
+ * and waits until it takes the signal flag or a broadcast starts a new epoch.
  * Upon waking, the thread reacquires the external lock and decrements the waiters count.
  */
 void condition_variable_wait(condition_variable* cv, ticket_lock* ext_lock) {
+    LOCK_STATS_BEGIN(stats);
+    LOCK_TRACE_EVENT(cv, LOCK_TRACE_CONDVAR, LOCK_TRACE_WAIT);
+    wait_state ws = WAIT_STATE_INIT;
+    int epoch = atomic_load_explicit(&cv->epoch, ORDER_RELAXED);
     atomic_fetch_add(&cv->waiters, 1); // Mark this thread as a waiter
     ticketlock_release(ext_lock);      // Release the external lock while waiting
-    while (atomic_flag_test_and_set(&cv->lock)) { // Spin until signaled
-        sched_yield(); 
-    }   
+    while (1) {
+        int seq = atomic_load_explicit(&cv->seq, ORDER_ACQUIRE);  // read before checking, so a signal in between unparks us
+        if (!atomic_flag_test_and_set_explicit(&cv->lock, ORDER_ACQUIRE) ||
+            atomic_load_explicit(&cv->epoch, ORDER_RELAXED) != epoch) {
+            break;
+        }
+        LOCK_STATS_SPIN(stats);
+        wait_pause(&cv->policy, &ws, &cv->seq, seq, &cv->parked);
+    }
     ticketlock_acquire(ext_lock);      // Reacquire the external lock before returning
-    atomic_fetch_sub(&cv->waiters, 1); // This thread is no longer waiting
+    atomic_fetch_sub_explicit(&cv->waiters, 1, ORDER_RELAXED); // This thread is no longer waiting
+    LOCK_TRACE_EVENT(cv, LOCK_TRACE_CONDVAR, LOCK_TRACE_ACQUIRED);
+    LOCK_STATS_ACQUIRED(cv, stats);
+}
+
+/*
+ * condition_variable_timedwait
+ *
+ * The wait loop of condition_variable_wait with a deadline. A waiter that times out takes
+ * one last look at the signal token, so a signal that picked it just before the deadline
+ * is consumed rather than left behind for nobody.
+ */
+int condition_variable_timedwait(condition_variable* cv, ticket_lock* ext_lock, long timeout_ms) {
+    LOCK_STATS_BEGIN(stats);
+    LOCK_TRACE_EVENT(cv, LOCK_TRACE_CONDVAR, LOCK_TRACE_WAIT);
+    wait_state ws = WAIT_STATE_INIT;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long deadline = now.tv_sec * 1000LL + now.tv_nsec / 1000000 + timeout_ms;
+    int result = 0;
+    int epoch = atomic_load_explicit(&cv->epoch, ORDER_RELAXED);
+    atomic_fetch_add(&cv->waiters, 1);
+    ticketlock_release(ext_lock);
+    while (1) {
+        int seq = atomic_load_explicit(&cv->seq, ORDER_ACQUIRE);
+        if (!atomic_flag_test_and_set_explicit(&cv->lock, ORDER_ACQUIRE) ||
+            atomic_load_explicit(&cv->epoch, ORDER_RELAXED) != epoch) {
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long left = deadline - (now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+        if (left <= 0) {
+            result = -1;
+            break;
+        }
+        LOCK_STATS_SPIN(stats);
+        wait_pause_timed(&cv->policy, &ws, &cv->seq, seq, &cv->parked, (long)left);
+    }
+    ticketlock_acquire(ext_lock);
+    atomic_fetch_sub_explicit(&cv->waiters, 1, ORDER_RELAXED);
+    LOCK_TRACE_EVENT(cv, LOCK_TRACE_CONDVAR, LOCK_TRACE_ACQUIRED);
+    LOCK_STATS_ACQUIRED(cv, stats);
+    return result;
 }
 
 /*
@@ -50,10 +135,35 @@ void condition_variable_wait(condition_variable* cv, ticket_lock* ext_lock) {
  * until its ticket is the current one, ensuring fair access.
  */
 void ticketlock_acquire(ticket_lock* lock) {
-    int my_ticket = atomic_fetch_add(&lock->ticket, 1); // Get a ticket number
-    while (atomic_load(&lock->cur_ticket) != my_ticket) {
-        sched_yield(); 
+    LOCK_STATS_BEGIN(stats);
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_TICKET_LOCK, LOCK_TRACE_WAIT);
+    wait_state ws = WAIT_STATE_INIT;
+    int my_ticket = atomic_fetch_add_explicit(&lock->ticket, 1, ORDER_RELAXED); // Get a ticket number
+    int cur;
+    while ((cur = atomic_load_explicit(&lock->cur_ticket, ORDER_ACQUIRE)) != my_ticket) {
+        LOCK_STATS_SPIN(stats);
+        wait_pause(&lock->policy, &ws, &lock->cur_ticket, cur, &lock->parked);
     }
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_TICKET_LOCK, LOCK_TRACE_ACQUIRED);
+    LOCK_STATS_ACQUIRED(lock, stats);
+}
+
+/*
+ * ticketlock_try_acquire
+ *
+ * Takes the next ticket only if it is already being served, i.e. nobody holds or waits.
+ * A stale 'cur' is smaller than the ticket dispenser, so the CAS can only succeed on the
+ * value the previous holder released.
+ */
+int ticketlock_try_acquire(ticket_lock* lock) {
+    int cur = atomic_load_explicit(&lock->cur_ticket, ORDER_ACQUIRE);
+    if (!atomic_compare_exchange_strong_explicit(&lock->ticket, &cur, cur + 1, ORDER_ACQUIRE, ORDER_RELAXED)) {
+        return 0;
+    }
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_TICKET_LOCK, LOCK_TRACE_ACQUIRED);
+    LOCK_STATS_BEGIN(stats);
+    LOCK_STATS_ACQUIRED(lock, stats);
+    return 1;
 }
 
 /*
@@ -62,30 +172,76 @@ void ticketlock_acquire(ticket_lock* lock) {
  * Releases the ticket lock, allowing the next ticket holder to proceed.
  */
 void ticketlock_release(ticket_lock* lock) {
-    atomic_fetch_add(&lock->cur_ticket, 1); // Advance to the next ticket
+    LOCK_STATS_RELEASED(lock);
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_TICKET_LOCK, LOCK_TRACE_RELEASED);
+    int next = atomic_load_explicit(&lock->cur_ticket, ORDER_RELAXED) + 1;
+    atomic_store_explicit(&lock->cur_ticket, next, ORDER_RELEASE); // Advance to the next ticket
+    wait_wake(&lock->policy, &lock->cur_ticket, &lock->parked, INT_MAX); // the next holder may be any sleeper
+}
+
+/*
+ * condition_variable_wait_async
+ *
+ * The registration happens under the caller's external lock, so a signaler that changes
+ * the state under the same lock afterwards finds the waiter in the queue.
+ */
+int condition_variable_wait_async(condition_variable* cv, async_waiter* w) {
+    if (cv->policy.pshared) {
+        return -1;
+    }
+    async_waitq_push(&cv->async, w);
+    return 0;
+}
+
+int condition_variable_cancel_async(condition_variable* cv, async_waiter* w) {
+    return async_waitq_remove(&cv->async, w);
 }
 
 /*
  * condition_variable_signal
  *
  * Wakes up a single waiting thread, if any, by clearing the signal flag.
+ * Async waiters are served first, oldest first: completing one costs no wakeup of a
+ * sleeping thread, and the event loop will come back for the lock on its own.
  */
 void condition_variable_signal(condition_variable* cv) {
+    if (atomic_load(&cv->async.count) > 0) {
+        async_waitq_lock(&cv->async);
+        async_waiter* w = async_waitq_pop_locked(&cv->async);
+        async_waitq_unlock(&cv->async);
+        if (w != NULL) {
+            async_waiter_complete(w);
+            return;
+        }
+    }
     if (atomic_load(&cv->waiters) > 0) {
-        atomic_flag_clear(&cv->lock);
+        atomic_flag_clear_explicit(&cv->lock, ORDER_RELEASE);
+        atomic_fetch_add_explicit(&cv->seq, 1, ORDER_RELEASE);
+        wait_wake(&cv->policy, &cv->seq, &cv->parked, 1);
     }
 }
 
 /*
  * condition_variable_broadcast
  *
- * Wakes up all waiting threads by repeatedly clearing the signal flag.
- * Each clear allows one waiting thread to proceed.
+ * Wakes up all waiting threads at once by starting a new epoch: every thread that
+ * started waiting before the broadcast sees the epoch change and returns.
+ * Every registered async waiter is completed as well.
  */
 void condition_variable_broadcast(condition_variable* cv) {
-    int w = atomic_load(&cv->waiters);
-    for (int i = 0; i < w; i++) {
-        atomic_flag_clear(&cv->lock); // Wake one thread per clear
-        sched_yield();
+    if (atomic_load(&cv->async.count) > 0) {
+        async_waiter* all = NULL;
+        async_waiter** tail = &all;
+        async_waitq_lock(&cv->async);
+        while ((*tail = async_waitq_pop_locked(&cv->async)) != NULL) {
+            tail = &(*tail)->next;
+        }
+        async_waitq_unlock(&cv->async);
+        async_waiter_complete_all(all);
+    }
+    if (atomic_load(&cv->waiters) > 0) {
+        atomic_fetch_add_explicit(&cv->epoch, 1, ORDER_RELAXED);
+        atomic_fetch_add_explicit(&cv->seq, 1, ORDER_RELEASE);   // publishes the epoch
+        wait_wake(&cv->policy, &cv->seq, &cv->parked, INT_MAX);
     }
 }
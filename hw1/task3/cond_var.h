@@ -2,13 +2,25 @@
 #define COND_VAR_H
 
 #include <stdatomic.h>
+#include "../common/async_wait.h"
+#include "../common/lock_stats.h"
+#include "../common/wait_policy.h"
 
 /*
  * Define the condition variable type.
+ * 'lock' is the single-wakeup token consumed by signal; 'epoch' releases every current
+ * waiter at once on broadcast; 'seq' changes on both and is the word parked waiters sleep on.
+ * 'async' holds the waiters registered with condition_variable_wait_async.
  */
 typedef struct {
     atomic_flag lock;
     atomic_int waiters; 
+    atomic_int seq;
+    atomic_int epoch;
+    atomic_int parked;
+    wait_policy policy;
+    async_waitq async;
+    LOCK_STATS_FIELD
 } condition_variable;
 
 /*
@@ -17,6 +29,9 @@ typedef struct {
 typedef struct {
     atomic_int cur_ticket;
     atomic_int ticket;
+    atomic_int parked;
+    wait_policy policy;
+    LOCK_STATS_FIELD
 } ticket_lock;
 
 /*
@@ -24,12 +39,37 @@ typedef struct {
  */
 void condition_variable_init(condition_variable* cv);
 
+/*
+ * Initializes 'cv' for use by several processes; it must live in shared memory.
+ */
+void condition_variable_init_shared(condition_variable* cv);
+
 /*
  * Causes the calling thread to wait on the condition variable 'cv'.
  * The thread should release the external lock 'ext_lock' while waiting and reacquire it before returning.
  */
 void condition_variable_wait(condition_variable* cv, ticket_lock* ext_lock);
 
+/*
+ * Like condition_variable_wait, but gives up after about 'timeout_ms' milliseconds.
+ * Returns 0 if woken, -1 on timeout; 'ext_lock' is held again either way.
+ */
+int condition_variable_timedwait(condition_variable* cv, ticket_lock* ext_lock, long timeout_ms);
+
+/*
+ * Registers 'w' to be completed by a later signal or broadcast, without blocking
+ * (see async_wait.h). Call it with the external lock held, after checking the predicate,
+ * then release the lock; once 'w' completes, reacquire it and check the predicate again.
+ * Returns 0, or -1 for a process-shared condition variable.
+ */
+int condition_variable_wait_async(condition_variable* cv, async_waiter* w);
+
+/*
+ * Withdraws a registered async waiter. Returns 1 if it was removed, 0 if a signal has
+ * already been delivered to it.
+ */
+int condition_variable_cancel_async(condition_variable* cv, async_waiter* w);
+
 /*
  * Wakes up one thread waiting on the condition variable 'cv'.
  */
@@ -44,7 +84,9 @@ void condition_variable_broadcast(condition_variable* cv);
  * Ticket lock function declarations — needed for correct compilation
  */
 void ticketlock_init(ticket_lock* lock);
+void ticketlock_init_shared(ticket_lock* lock);   // for a lock placed in shared memory
 void ticketlock_acquire(ticket_lock* lock);
+int ticketlock_try_acquire(ticket_lock* lock);   // 1 if acquired, 0 if held or contended
 void ticketlock_release(ticket_lock* lock);
 
 #endif // COND_VAR_H
\ No newline at end of file
@@ -0,0 +1,72 @@
+/*
+ * mcs_lock.c
+ *
+ * Implementation of the MCS queue lock.
+ *
+ * The exchange on the tail is acq_rel: it publishes our freshly initialized node to the
+ * successor that links behind it, and takes the handoff when the queue was empty. Linking
+ * into 'next' is a release the predecessor's release path acquires, and clearing 'locked'
+ * is the release that passes the lock on.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "mcs_lock.h"
+#include <stddef.h>
+
+void mcs_lock_init(mcs_lock* lock) {
+    atomic_init(&lock->tail, NULL);
+    atomic_init(&lock->parked, 0);
+    wait_policy_default(&lock->policy);
+}
+
+/*
+ * mcs_lock_acquire
+ *
+ * Appends 'node' to the queue with one exchange on the tail. If there was a predecessor,
+ * links behind it and waits until it clears our 'locked' flag.
+ */
+void mcs_lock_acquire(mcs_lock* lock, mcs_node* node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+
+    mcs_node* pred = atomic_exchange_explicit(&lock->tail, node, ORDER_ACQ_REL);
+    if (pred == NULL) {
+        return;
+    }
+    atomic_store_explicit(&pred->next, node, ORDER_RELEASE);
+
+    wait_state ws = WAIT_STATE_INIT;
+    while (atomic_load_explicit(&node->locked, ORDER_ACQUIRE)) {
+        wait_pause(&lock->policy, &ws, &node->locked, 1, &lock->parked);
+    }
+}
+
+int mcs_lock_try_acquire(mcs_lock* lock, mcs_node* node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    mcs_node* expected = NULL;
+    return atomic_compare_exchange_strong_explicit(&lock->tail, &expected, node, ORDER_ACQ_REL, ORDER_RELAXED);
+}
+
+/*
+ * mcs_lock_release
+ *
+ * Without a known successor, tries to swing the tail back to empty. If that fails a
+ * successor is between its exchange and its link, so wait for the link to appear.
+ */
+void mcs_lock_release(mcs_lock* lock, mcs_node* node) {
+    mcs_node* next = atomic_load_explicit(&node->next, ORDER_ACQUIRE);
+    if (next == NULL) {
+        mcs_node* expected = node;
+        if (atomic_compare_exchange_strong_explicit(&lock->tail, &expected, NULL, ORDER_RELEASE, ORDER_RELAXED)) {
+            return;
+        }
+        wait_state ws = WAIT_STATE_INIT;
+        while ((next = atomic_load_explicit(&node->next, ORDER_ACQUIRE)) == NULL) {
+            wait_pause(&lock->policy, &ws, NULL, 0, NULL);
+        }
+    }
+    atomic_store_explicit(&next->locked, 0, ORDER_RELEASE);
+    // the successor may already have returned and reused its node; a stray wake is harmless
+    wait_wake(&lock->policy, &next->locked, &lock->parked, 1);
+}
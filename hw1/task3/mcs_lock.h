@@ -0,0 +1,48 @@
+#ifndef MCS_LOCK_H
+#define MCS_LOCK_H
+
+#include <stdatomic.h>
+#include "../common/wait_policy.h"
+
+#define MCS_CACHE_LINE 64
+
+/*
+ * Queue node of the MCS lock. Every acquirer brings its own node (usually on its stack)
+ * and spins only on its own 'locked' field, so a handoff touches one cache line that
+ * belongs to the next waiter instead of one line shared by all waiters.
+ */
+typedef struct mcs_node {
+    _Alignas(MCS_CACHE_LINE) _Atomic(struct mcs_node*) next;
+    atomic_int locked;
+} mcs_node;
+
+/*
+ * Define the MCS queue lock type (Mellor-Crummey and Scott). FIFO like the ticket lock.
+ */
+typedef struct {
+    _Alignas(MCS_CACHE_LINE) _Atomic(mcs_node*) tail;
+    atomic_int parked;
+    wait_policy policy;
+} mcs_lock;
+
+/*
+ * Initializes the lock to the unlocked state.
+ */
+void mcs_lock_init(mcs_lock* lock);
+
+/*
+ * Acquires the lock using 'node', which must stay valid until the matching release.
+ */
+void mcs_lock_acquire(mcs_lock* lock, mcs_node* node);
+
+/*
+ * Acquires the lock with 'node' only if it is free. Returns 1 if acquired, 0 otherwise.
+ */
+int mcs_lock_try_acquire(mcs_lock* lock, mcs_node* node);
+
+/*
+ * Releases the lock acquired with 'node'.
+ */
+void mcs_lock_release(mcs_lock* lock, mcs_node* node);
+
+#endif // MCS_LOCK_H
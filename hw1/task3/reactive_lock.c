@@ -0,0 +1,116 @@
+/*
+ * reactive_lock.c
+ *
+ * Implementation of the reactive lock: a test-and-set word, optionally fronted by a ticket
+ * lock that lines up the contenders (the same split as the Linux queued spinlock).
+ *
+ * The history window and the switch counter are only touched by the holder, right after it
+ * acquired the word, so the word orders them and they need no atomics. The mode is written
+ * the same way but read by anybody; a stale read only picks the other path to the same word,
+ * so it is relaxed everywhere.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "reactive_lock.h"
+
+void reactive_lock_init(reactive_lock* lock) {
+    atomic_init(&lock->word, 0);
+    atomic_init(&lock->parked, 0);
+    atomic_init(&lock->mode, REACTIVE_TAS);
+    lock->adaptive = 1;
+    lock->history = 0;
+    lock->switches = 0;
+    wait_policy_default(&lock->policy);
+    ticketlock_init(&lock->queue);
+}
+
+void reactive_lock_init_fixed(reactive_lock* lock, int mode) {
+    reactive_lock_init(lock);
+    atomic_store_explicit(&lock->mode, mode, ORDER_RELAXED);
+    lock->adaptive = 0;
+}
+
+void reactive_lock_set_wait_policy(reactive_lock* lock, const wait_policy* policy) {
+    lock->policy = *policy;
+    lock->queue.policy = *policy;
+}
+
+// One test-and-test-and-set attempt; reading first keeps spinners off the line in exclusive state
+static int take_word(reactive_lock* lock) {
+    return atomic_load_explicit(&lock->word, ORDER_RELAXED) == 0 &&
+           atomic_exchange_explicit(&lock->word, 1, ORDER_ACQUIRE) == 0;
+}
+
+static void wait_word(reactive_lock* lock) {
+    wait_state ws = WAIT_STATE_INIT;
+    while (!take_word(lock)) {
+        wait_pause(&lock->policy, &ws, &lock->word, 1, &lock->parked);
+    }
+}
+
+/*
+ * record
+ *
+ * Shifts the outcome of this acquisition into the window and switches modes if the number of
+ * contended acquisitions in it crossed a threshold.
+ */
+static void record(reactive_lock* lock, int contended) {
+    if (!lock->adaptive) {
+        return;
+    }
+    lock->history = (lock->history << 1) | (uint64_t)contended;
+    int recent = __builtin_popcountll(lock->history);
+    int mode = atomic_load_explicit(&lock->mode, ORDER_RELAXED);
+    if (mode == REACTIVE_TAS && recent >= REACTIVE_TO_QUEUE) {
+        atomic_store_explicit(&lock->mode, REACTIVE_QUEUE, ORDER_RELAXED);
+        lock->switches++;
+    } else if (mode == REACTIVE_QUEUE && recent <= REACTIVE_TO_TAS) {
+        atomic_store_explicit(&lock->mode, REACTIVE_TAS, ORDER_RELAXED);
+        lock->switches++;
+    }
+}
+
+/*
+ * reactive_lock_acquire
+ *
+ * An acquisition counts as contended if the thread could not take the word (or, in QUEUE
+ * mode, its place in line) at the first attempt. The queue is left as soon as the word is
+ * taken, so the next in line can start spinning on it during our critical section.
+ */
+void reactive_lock_acquire(reactive_lock* lock) {
+    int contended = 0;
+    if (atomic_load_explicit(&lock->mode, ORDER_RELAXED) == REACTIVE_TAS) {
+        if (!take_word(lock)) {
+            contended = 1;
+            wait_word(lock);
+        }
+    } else {
+        if (!ticketlock_try_acquire(&lock->queue)) {
+            contended = 1;
+            ticketlock_acquire(&lock->queue);
+        }
+        if (!take_word(lock)) {
+            contended = 1;
+            wait_word(lock);
+        }
+        ticketlock_release(&lock->queue);
+    }
+    record(lock, contended);
+}
+
+/*
+ * Skips the queue in either mode; a single attempt cannot starve anybody.
+ */
+int reactive_lock_try_acquire(reactive_lock* lock) {
+    return take_word(lock);
+}
+
+void reactive_lock_release(reactive_lock* lock) {
+    atomic_store_explicit(&lock->word, 0, ORDER_RELEASE);
+    wait_wake(&lock->policy, &lock->word, &lock->parked, 1);
+}
+
+int reactive_lock_mode(reactive_lock* lock) {
+    return atomic_load_explicit(&lock->mode, ORDER_RELAXED);
+}
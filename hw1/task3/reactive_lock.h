@@ -0,0 +1,75 @@
+#ifndef REACTIVE_LOCK_H
+#define REACTIVE_LOCK_H
+
+#include <stdint.h>
+#include "cond_var.h"
+
+#define REACTIVE_CACHE_LINE 64
+#define REACTIVE_WINDOW 64          // acquisitions the contention estimate looks back over
+#define REACTIVE_TO_QUEUE 16        // contended acquisitions in the window that switch to QUEUE
+#define REACTIVE_TO_TAS 2           // ... and at or below which QUEUE switches back to TAS
+
+/*
+ * Modes of the reactive lock.
+ */
+#define REACTIVE_TAS   0
+#define REACTIVE_QUEUE 1
+
+/*
+ * Define the reactive lock type.
+ *
+ * Mutual exclusion always comes from one test-and-set word, as in task1, so the lock is only
+ * ever held through 'word'. The mode decides how threads get to it:
+ *   TAS    every acquirer spins on the word directly. Cheapest with little contention: one
+ *          exchange to acquire and one store to release.
+ *   QUEUE  acquirers first line up on a ticket lock and only the head of the line spins on
+ *          the word, handing the ticket lock on as soon as it has the word. Under heavy
+ *          contention the word sees one contender instead of all of them, and the order is FIFO.
+ * As the holder is the same in both modes, the mode may change at any time: a thread that
+ * read the old mode just takes the word the old way.
+ *
+ * The holder records whether its acquisition was contended in a sliding window of the last
+ * REACTIVE_WINDOW acquisitions, and switches modes when the count crosses REACTIVE_TO_QUEUE
+ * or REACTIVE_TO_TAS. The gap between the two thresholds keeps it from flapping.
+ */
+typedef struct {
+    _Alignas(REACTIVE_CACHE_LINE) atomic_int word;    // 1 while held
+    atomic_int parked;
+    atomic_int mode;
+    int adaptive;               // 0: the mode was fixed at init
+    uint64_t history;           // one bit per recent acquisition, 1 = contended; holder only
+    long switches;              // mode changes so far; holder only
+    wait_policy policy;
+    _Alignas(REACTIVE_CACHE_LINE) ticket_lock queue;
+} reactive_lock;
+
+/*
+ * Initializes the lock unlocked, in TAS mode, switching modes on its own.
+ */
+void reactive_lock_init(reactive_lock* lock);
+
+/*
+ * Initializes the lock unlocked and pinned to 'mode' (REACTIVE_TAS or REACTIVE_QUEUE).
+ */
+void reactive_lock_init_fixed(reactive_lock* lock, int mode);
+
+/*
+ * Waiting on the word and in the queue follows 'policy'.
+ */
+void reactive_lock_set_wait_policy(reactive_lock* lock, const wait_policy* policy);
+
+void reactive_lock_acquire(reactive_lock* lock);
+
+/*
+ * Acquires the lock only if it is free. Returns 1 if acquired, 0 otherwise.
+ */
+int reactive_lock_try_acquire(reactive_lock* lock);
+
+void reactive_lock_release(reactive_lock* lock);
+
+/*
+ * Current mode. Only a snapshot unless called by the holder.
+ */
+int reactive_lock_mode(reactive_lock* lock);
+
+#endif // REACTIVE_LOCK_H
@@ -6,10 +6,16 @@
  * This lock allows multiple readers to access a shared resource concurrently, but writers require exclusive access.
  * The implementation ensures fairness and prevents race conditions in a multi-threaded environment.
  *
+ * Everything except the two releases happens under the internal ticket lock, which already
+ * orders it, so the flag and counter are touched with acquire or relaxed operations there.
+ * The releases run outside the lock: a reader's decrement and a writer's clear are releases
+ * that the next writer's check and the next reader's peek acquire.
+ *
  * Author: Noam Hasson, Asaf Ramat
  */
 
 #include "rw_lock.h"
+#include "../common/lock_trace.h"
 
 /*
  * Initializes the readers-writer lock structure.
@@ -20,6 +26,29 @@ void rwlock_init(rwlock* lock) {
     atomic_flag_clear(&lock->writer);
     condition_variable_init(&lock->cv);
     ticketlock_init(&lock->lock);
+    LOCK_STATS_INIT(lock, "rwlock");
+}
+
+/*
+ * Initializes the lock for use across processes: the internal ticket lock and condition
+ * variable park on shared futexes. The flags and counters need nothing special.
+ */
+void rwlock_init_shared(rwlock* lock) {
+    rwlock_init(lock);
+    lock->lock.policy.pshared = 1;
+    lock->cv.policy.pshared = 1;
+}
+
+/*
+ * Waiting in the rwlock happens inside its ticket lock and condition variable,
+ * so tuning means tuning both.
+ */
+void rwlock_set_wait_policy(rwlock* lock, const wait_policy* policy) {
+    int pshared = lock->lock.policy.pshared;
+    lock->lock.policy = *policy;
+    lock->cv.policy = *policy;
+    lock->lock.policy.pshared = pshared;
+    lock->cv.policy.pshared = pshared;
 }
 
 /*
@@ -28,17 +57,42 @@ void rwlock_init(rwlock* lock) {
  * If a writer is active, the reader waits on the condition variable.
  */
 void rwlock_acquire_read(rwlock* lock) {
+    LOCK_STATS_BEGIN(stats);
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_READ, LOCK_TRACE_WAIT);
     while (1) {
         ticketlock_acquire(&lock->lock);
-        if (!atomic_flag_test_and_set(&lock->writer)) {
-            atomic_flag_clear(&lock->writer);  // just a peek
-            atomic_fetch_add(&lock->readers, 1);
+        if (!atomic_flag_test_and_set_explicit(&lock->writer, ORDER_ACQUIRE)) {
+            atomic_flag_clear_explicit(&lock->writer, ORDER_RELAXED);  // just a peek
+            atomic_fetch_add_explicit(&lock->readers, 1, ORDER_RELAXED);
             ticketlock_release(&lock->lock);
             break;
         }
+        LOCK_STATS_SPIN(stats);
         condition_variable_wait(&lock->cv, &lock->lock);  // releases and reacquires internally
         ticketlock_release(&lock -> lock);
     }
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_READ, LOCK_TRACE_ACQUIRED);
+    LOCK_STATS_ACQUIRED(lock, stats);
+}
+
+/*
+ * Same check as rwlock_acquire_read, without waiting on the condition variable.
+ * The internal ticket lock is only ever held briefly, so taking it does not block.
+ */
+int rwlock_try_acquire_read(rwlock* lock) {
+    ticketlock_acquire(&lock->lock);
+    int acquired = !atomic_flag_test_and_set_explicit(&lock->writer, ORDER_ACQUIRE);
+    if (acquired) {
+        atomic_flag_clear_explicit(&lock->writer, ORDER_RELAXED);  // just a peek
+        atomic_fetch_add_explicit(&lock->readers, 1, ORDER_RELAXED);
+    }
+    ticketlock_release(&lock->lock);
+    if (acquired) {
+        LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_READ, LOCK_TRACE_ACQUIRED);
+        LOCK_STATS_BEGIN(stats);
+        LOCK_STATS_ACQUIRED(lock, stats);
+    }
+    return acquired;
 }
 
 /*
@@ -46,7 +100,9 @@ void rwlock_acquire_read(rwlock* lock) {
  * Decrements the readers count. If this was the last reader, signals a waiting writer.
  */
 void rwlock_release_read(rwlock* lock) {
-    int remaining = atomic_fetch_sub(&lock->readers, 1) - 1;
+    LOCK_STATS_RELEASED(lock);
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_READ, LOCK_TRACE_RELEASED);
+    int remaining = atomic_fetch_sub_explicit(&lock->readers, 1, ORDER_RELEASE) - 1;
     if (remaining == 0) {
         condition_variable_signal(&lock->cv);
     }
@@ -58,13 +114,32 @@ void rwlock_release_read(rwlock* lock) {
  * Sets the writer flag to indicate exclusive access.
  */
 void rwlock_acquire_write(rwlock* lock) {
+    LOCK_STATS_BEGIN(stats);
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_WRITE, LOCK_TRACE_WAIT);
     ticketlock_acquire(&lock->lock);
-    while (atomic_load(&lock->readers) > 0 || atomic_flag_test_and_set(&lock->writer)) {
+    while (atomic_load_explicit(&lock->readers, ORDER_ACQUIRE) > 0 ||
+           atomic_flag_test_and_set_explicit(&lock->writer, ORDER_ACQUIRE)) {
+        LOCK_STATS_SPIN(stats);
         condition_variable_wait(&lock->cv, &lock->lock);
     }
     // Explicitly set writer flag (though it's already set above, this clarifies intention)
-    atomic_flag_test_and_set(&lock->writer);
+    atomic_flag_test_and_set_explicit(&lock->writer, ORDER_RELAXED);
     ticketlock_release(&lock->lock);
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_WRITE, LOCK_TRACE_ACQUIRED);
+    LOCK_STATS_ACQUIRED(lock, stats);
+}
+
+int rwlock_try_acquire_write(rwlock* lock) {
+    ticketlock_acquire(&lock->lock);
+    int acquired = atomic_load_explicit(&lock->readers, ORDER_ACQUIRE) == 0 &&
+                   !atomic_flag_test_and_set_explicit(&lock->writer, ORDER_ACQUIRE);
+    ticketlock_release(&lock->lock);
+    if (acquired) {
+        LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_WRITE, LOCK_TRACE_ACQUIRED);
+        LOCK_STATS_BEGIN(stats);
+        LOCK_STATS_ACQUIRED(lock, stats);
+    }
+    return acquired;
 }
 
 /*
@@ -72,6 +147,8 @@ void rwlock_acquire_write(rwlock* lock) {
  * Clears the writer flag and broadcasts to all waiting threads (readers and writers).
  */
 void rwlock_release_write(rwlock* lock) {
-    atomic_flag_clear(&lock->writer);
+    LOCK_STATS_RELEASED(lock);
+    LOCK_TRACE_EVENT(lock, LOCK_TRACE_RWLOCK_WRITE, LOCK_TRACE_RELEASED);
+    atomic_flag_clear_explicit(&lock->writer, ORDER_RELEASE);
     condition_variable_broadcast(&lock->cv);
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ typedef struct {
     atomic_flag writer;
     condition_variable cv;
     ticket_lock lock;
+    LOCK_STATS_FIELD
 } rwlock;
 
 /*
@@ -19,11 +20,27 @@ typedef struct {
  */
 void rwlock_init(rwlock* lock);
 
+/*
+ * Initializes the read-write lock for use by several processes; it must live in shared memory.
+ */
+void rwlock_init_shared(rwlock* lock);
+
+/*
+ * Applies 'policy' to the internal ticket lock and condition variable.
+ * Whether the lock is process-shared is kept as initialized.
+ */
+void rwlock_set_wait_policy(rwlock* lock, const wait_policy* policy);
+
 /*
  * Acquires the lock for reading.
  */
 void rwlock_acquire_read(rwlock* lock);
 
+/*
+ * Acquires the lock for reading if no writer holds it. Returns 1 if acquired, 0 otherwise.
+ */
+int rwlock_try_acquire_read(rwlock* lock);
+
 /*
  * Releases the lock after reading.
  */
@@ -34,6 +51,11 @@ void rwlock_release_read(rwlock* lock);
  */
 void rwlock_acquire_write(rwlock* lock);
 
+/*
+ * Acquires the lock for writing if nobody holds it. Returns 1 if acquired, 0 otherwise.
+ */
+int rwlock_try_acquire_write(rwlock* lock);
+
 /*
  * Releases the lock after writing.
  */
@@ -0,0 +1,174 @@
+/*
+ * epoch.c
+ *
+ * Implementation of epoch-based reclamation.
+ *
+ * The global epoch only advances when every thread inside a read section has observed the
+ * current value. An object retired at epoch e was unreachable for readers that start at e or
+ * later, and once the epoch reaches e + 2 every reader that started at e - 1 or earlier has
+ * left. So each thread keeps three limbo lists, indexed by epoch % 3, and a list is freed
+ * when its slot comes round again.
+ *
+ * A reader publishes its epoch with a store ordered by a sequentially consistent fence before
+ * it loads any shared pointer; the writer's scan uses sequentially consistent loads. Either
+ * the writer sees the reader as active, or the reader sees the new pointer.
+ *
+ * Records live in a fixed table of MAX_THREADS entries, the same bound as the TLS table.
+ * The calling thread's record is cached in a __thread pointer rather than looked up with
+ * get_tls_data, which takes the table's global lock and would put a shared line back on
+ * the read path.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "epoch.h"
+#include "../common/wait_policy.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static _Alignas(EPOCH_CACHE_LINE) atomic_ulong global_epoch = 0;
+static epoch_record records[MAX_THREADS];
+static __thread epoch_record* my_record = NULL;
+
+static epoch_record* self(void) {
+    if (my_record == NULL) {
+        fprintf(stderr, "Thread used epochs without calling epoch_register\n");
+        exit(1);
+    }
+    return my_record;
+}
+
+void epoch_register(void) {
+    if (my_record != NULL) {
+        return;
+    }
+    for (int i = 0; i < MAX_THREADS; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&records[i].in_use, &expected, 1)) {
+            epoch_record* rec = &records[i];
+            atomic_store(&rec->state, 0);
+            rec->nesting = 0;
+            rec->retired_since_advance = 0;
+            for (int j = 0; j < 3; j++) {
+                rec->limbo[j] = NULL;
+                rec->limbo_epoch[j] = 0;
+            }
+            my_record = rec;
+            return;
+        }
+    }
+    fprintf(stderr, "Epoch table full: more than %d registered threads\n", MAX_THREADS);
+    exit(1);
+}
+
+static void free_list(epoch_retired* node) {
+    while (node != NULL) {
+        epoch_retired* next = node->next;
+        node->free_fn(node->ptr);
+        free(node);
+        node = next;
+    }
+}
+
+void epoch_unregister(void) {
+    epoch_record* rec = self();
+    epoch_synchronize();
+    for (int j = 0; j < 3; j++) {
+        free_list(rec->limbo[j]);
+        rec->limbo[j] = NULL;
+    }
+    my_record = NULL;
+    atomic_store(&rec->in_use, 0);
+}
+
+void epoch_enter(void) {
+    epoch_record* rec = self();
+    if (rec->nesting++ > 0) {
+        return;
+    }
+    unsigned long epoch = atomic_load_explicit(&global_epoch, memory_order_relaxed);
+    atomic_store_explicit(&rec->state, (epoch << 1) | 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+void epoch_exit(void) {
+    epoch_record* rec = self();
+    if (--rec->nesting > 0) {
+        return;
+    }
+    atomic_store_explicit(&rec->state, 0, memory_order_release);
+}
+
+/*
+ * try_advance
+ *
+ * Moves the global epoch from 'epoch' to 'epoch + 1' if no active reader is still in an
+ * older one. A reader that published a stale value just delays the advance. Returns the
+ * global epoch afterwards.
+ */
+static unsigned long try_advance(unsigned long epoch) {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        if (!atomic_load(&records[i].in_use)) {
+            continue;
+        }
+        unsigned long state = atomic_load(&records[i].state);
+        if ((state & 1) && (state >> 1) != epoch) {
+            return atomic_load(&global_epoch);
+        }
+    }
+    atomic_compare_exchange_strong(&global_epoch, &epoch, epoch + 1);
+    return atomic_load(&global_epoch);
+}
+
+// Frees every limbo list of 'rec' that is at least two epochs behind 'epoch'
+static void reclaim(epoch_record* rec, unsigned long epoch) {
+    for (int j = 0; j < 3; j++) {
+        if (rec->limbo[j] != NULL && rec->limbo_epoch[j] + 2 <= epoch) {
+            free_list(rec->limbo[j]);
+            rec->limbo[j] = NULL;
+        }
+    }
+}
+
+/*
+ * epoch_retire
+ *
+ * Adds the object to the list for the current epoch. Every EPOCH_RETIRE_BATCH retires the
+ * thread tries to advance the epoch and frees whatever became safe.
+ */
+void epoch_retire(void* ptr, void (*free_fn)(void*)) {
+    epoch_record* rec = self();
+    epoch_retired* node = malloc(sizeof(epoch_retired));
+    if (node == NULL) {
+        fprintf(stderr, "Failed to allocate memory for a retired object\n");
+        exit(1);
+    }
+    node->ptr = ptr;
+    node->free_fn = free_fn;
+
+    unsigned long epoch = atomic_load(&global_epoch);
+    reclaim(rec, epoch);
+    int slot = epoch % 3;
+    if (rec->limbo[slot] == NULL) {
+        rec->limbo_epoch[slot] = epoch;
+    }
+    node->next = rec->limbo[slot];
+    rec->limbo[slot] = node;
+
+    if (++rec->retired_since_advance >= EPOCH_RETIRE_BATCH) {
+        rec->retired_since_advance = 0;
+        reclaim(rec, try_advance(epoch));
+    }
+}
+
+void epoch_synchronize(void) {
+    unsigned long target = atomic_load(&global_epoch) + 2;
+    wait_state ws = WAIT_STATE_INIT;
+    unsigned long epoch;
+    while ((epoch = try_advance(atomic_load(&global_epoch))) < target) {
+        wait_pause(wait_policy_global(), &ws, NULL, 0, NULL);
+    }
+    if (my_record != NULL) {
+        reclaim(my_record, epoch);
+    }
+}
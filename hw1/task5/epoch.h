@@ -0,0 +1,77 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdatomic.h>
+#include "local_storage.h"
+
+#define EPOCH_CACHE_LINE 64
+#define EPOCH_RETIRE_BATCH 64   // retires between attempts to advance the global epoch
+
+/*
+ * Epoch-based reclamation for read-mostly, pointer-swapped structures.
+ *
+ * Readers bracket every access with epoch_enter / epoch_exit, which only write the calling
+ * thread's own record. Writers publish a new version with an atomic pointer store and hand
+ * the old one to epoch_retire. It is freed once every thread that was inside a read section
+ * at that time has left it, i.e. after the global epoch advanced twice. epoch_synchronize
+ * waits for such a grace period directly.
+ *
+ * Like the TLS table, the facility is process-wide with one record per thread, and at most
+ * MAX_THREADS threads can be registered at the same time.
+ */
+
+/*
+ * Deferred free: 'free_fn(ptr)' runs after a grace period.
+ */
+typedef struct epoch_retired {
+    struct epoch_retired* next;
+    void* ptr;
+    void (*free_fn)(void*);
+} epoch_retired;
+
+/*
+ * Per-thread record. 'state' is 0 outside a read section and (epoch << 1) | 1 inside,
+ * so a writer reads both facts with one load. Everything else is private to the owner.
+ */
+typedef struct {
+    _Alignas(EPOCH_CACHE_LINE) atomic_ulong state;
+    atomic_int in_use;
+    int nesting;
+    int retired_since_advance;
+    unsigned long limbo_epoch[3];
+    epoch_retired* limbo[3];      // retired objects by epoch % 3
+} epoch_record;
+
+/*
+ * Claims a record for the calling thread. Exits if MAX_THREADS threads are registered.
+ */
+void epoch_register(void);
+
+/*
+ * Waits for a grace period, frees everything the thread retired, and releases its record.
+ */
+void epoch_unregister(void);
+
+/*
+ * Starts a read section. Sections nest.
+ */
+void epoch_enter(void);
+
+/*
+ * Ends a read section. Pointers read inside it must not be used afterwards.
+ */
+void epoch_exit(void);
+
+/*
+ * Schedules 'free_fn(ptr)' for after all current readers are gone. 'ptr' must already be
+ * unreachable for new readers. Must not be called inside a read section.
+ */
+void epoch_retire(void* ptr, void (*free_fn)(void*));
+
+/*
+ * Blocks until every read section that was active at the call has ended.
+ * Must not be called inside a read section.
+ */
+void epoch_synchronize(void);
+
+#endif // EPOCH_H
@@ -11,7 +11,8 @@
  *   - set_tls_data: Set the TLS data pointer for the calling thread.
  *   - tls_thread_free: Free the TLS slot for the calling thread.
  *
- * Synchronization is provided by a global spinlock (atomic_flag).
+ * Synchronization is provided by a global spinlock (atomic_flag) that waits
+ * according to the global wait_policy.
  *
  * Author: Noam Hasson, Asaf Ramati
  */
@@ -22,19 +23,21 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include "../common/wait_policy.h"
 
 tls_data_t g_tls[MAX_THREADS];
 atomic_flag tls_lock = ATOMIC_FLAG_INIT;  // global spinlock
 
 // Spinlock helpers
 static void tls_lock_acquire() {
-    while (atomic_flag_test_and_set(&tls_lock)) {
-        // spin
+    wait_state ws = WAIT_STATE_INIT;
+    while (atomic_flag_test_and_set_explicit(&tls_lock, ORDER_ACQUIRE)) {
+        wait_pause(wait_policy_global(), &ws, NULL, 0, NULL);
     }
 }
 
 static void tls_lock_release() {
-    atomic_flag_clear(&tls_lock);
+    atomic_flag_clear_explicit(&tls_lock, ORDER_RELEASE);
 }
 
 // Initialize all TLS slots to unused
@@ -0,0 +1,178 @@
+/*
+ * batch_stage.c
+ *
+ * Batch processing stage for the consumers of the producer-consumer pattern.
+ *
+ * Instead of a scalar '% 6' and an snprintf per item, a consumer hands a contiguous array of
+ * values to this stage. The divisibility predicate is evaluated with SIMD and the output lines
+ * are built with memcpy and a hand-rolled integer formatter into one buffer.
+ *
+ * Divisibility by 6 is tested without a division: x is divisible by 6 iff x is even and
+ * x * 0xAAAAAAAB (the inverse of 3 modulo 2^32) is at most 0x55555555.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "batch_stage.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_STAGE_X86 1
+#endif
+
+#define INV3      0xAAAAAAABu
+#define THIRD_MAX 0x55555555u
+
+typedef void (*check_fn)(const int* values, unsigned char* divisible, int count);
+
+// Portable fallback, also used for the tail of the vector loops
+static void check_div6_scalar(const int* values, unsigned char* divisible, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t x = (uint32_t)values[i];
+        divisible[i] = ((x & 1) == 0) && (x * INV3 <= THIRD_MAX);
+    }
+}
+
+#ifdef BATCH_STAGE_X86
+
+__attribute__((target("sse4.1")))
+static void check_div6_sse41(const int* values, unsigned char* divisible, int count) {
+    const __m128i inv3 = _mm_set1_epi32((int)INV3);
+    const __m128i limit = _mm_set1_epi32((int)THIRD_MAX);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(values + i));
+        __m128i m = _mm_mullo_epi32(x, inv3);
+        __m128i div3 = _mm_cmpeq_epi32(_mm_min_epu32(m, limit), m);   // unsigned m <= limit
+        __m128i even = _mm_cmpeq_epi32(_mm_and_si128(x, one), zero);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(div3, even)));
+        for (int j = 0; j < 4; j++) {
+            divisible[i + j] = (mask >> j) & 1;
+        }
+    }
+    check_div6_scalar(values + i, divisible + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void check_div6_avx2(const int* values, unsigned char* divisible, int count) {
+    const __m256i inv3 = _mm256_set1_epi32((int)INV3);
+    const __m256i limit = _mm256_set1_epi32((int)THIRD_MAX);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(values + i));
+        __m256i m = _mm256_mullo_epi32(x, inv3);
+        __m256i div3 = _mm256_cmpeq_epi32(_mm256_min_epu32(m, limit), m);
+        __m256i even = _mm256_cmpeq_epi32(_mm256_and_si256(x, one), zero);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(div3, even)));
+        for (int j = 0; j < 8; j++) {
+            divisible[i + j] = (mask >> j) & 1;
+        }
+    }
+    check_div6_scalar(values + i, divisible + i, count - i);
+}
+
+#endif // BATCH_STAGE_X86
+
+static check_fn selected = NULL;
+static const char* selected_isa = "scalar";
+
+// Picks the widest instruction set the running CPU supports
+static check_fn resolve(void) {
+    check_fn current = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+    if (current != NULL) {
+        return current;
+    }
+    check_fn fn = check_div6_scalar;
+    const char* isa = "scalar";
+#ifdef BATCH_STAGE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        fn = check_div6_avx2;
+        isa = "avx2";
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        fn = check_div6_sse41;
+        isa = "sse4.1";
+    }
+#endif
+    // threads racing here all store the same answer; the name is published before the function
+    __atomic_store_n(&selected_isa, isa, __ATOMIC_RELAXED);
+    __atomic_store_n(&selected, fn, __ATOMIC_RELEASE);
+    return fn;
+}
+
+/*
+ * batch_check_div6
+ *
+ * Dispatches to the implementation selected on first use.
+ */
+void batch_check_div6(const int* values, unsigned char* divisible, int count) {
+    check_fn fn = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+    if (fn == NULL) {
+        fn = resolve();
+    }
+    fn(values, divisible, count);
+}
+
+const char* batch_stage_isa(void) {
+    resolve();
+    return __atomic_load_n(&selected_isa, __ATOMIC_RELAXED);
+}
+
+// Writes the decimal digits of 'v' to 'out' and returns the number of characters
+static size_t format_uint(char* out, unsigned long v) {
+    char tmp[24];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+/*
+ * batch_format
+ *
+ * The "Consumer <id> checked " prefix is built once per batch, every line is then
+ * three memcpys and one integer conversion.
+ */
+size_t batch_format(char* buf, unsigned long consumer_id,
+                    const int* values, const unsigned char* divisible, int count) {
+    static const char middle[] = ". Is it divisible by 6? ";
+    static const char yes[] = "True\n";
+    static const char no[] = "False\n";
+
+    char prefix[48];
+    size_t prefix_len = 9;
+    memcpy(prefix, "Consumer ", 9);
+    prefix_len += format_uint(prefix + prefix_len, consumer_id);
+    memcpy(prefix + prefix_len, " checked ", 9);
+    prefix_len += 9;
+
+    char* p = buf;
+    for (int i = 0; i < count; i++) {
+        memcpy(p, prefix, prefix_len);
+        p += prefix_len;
+        p += format_uint(p, (unsigned long)values[i]);
+        memcpy(p, middle, sizeof(middle) - 1);
+        p += sizeof(middle) - 1;
+        if (divisible[i]) {
+            memcpy(p, yes, sizeof(yes) - 1);
+            p += sizeof(yes) - 1;
+        } else {
+            memcpy(p, no, sizeof(no) - 1);
+            p += sizeof(no) - 1;
+        }
+    }
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,30 @@
+#ifndef BATCH_STAGE_H
+#define BATCH_STAGE_H
+
+#include <stddef.h>
+
+/*
+ * Longest line batch_format can emit for one value, including the newline.
+ */
+#define BATCH_LINE_MAX 96
+
+/*
+ * Sets divisible[i] to 1 if values[i] is divisible by 6 and to 0 otherwise.
+ * Values must be non-negative. Uses AVX2 or SSE4.1 when the CPU supports them.
+ */
+void batch_check_div6(const int* values, unsigned char* divisible, int count);
+
+/*
+ * Formats one consumer line per value into 'buf':
+ *   "Consumer <consumer_id> checked <value>. Is it divisible by 6? True|False\n"
+ * 'buf' must hold at least count * BATCH_LINE_MAX bytes. Returns the number of bytes written.
+ */
+size_t batch_format(char* buf, unsigned long consumer_id,
+                    const int* values, const unsigned char* divisible, int count);
+
+/*
+ * Name of the instruction set selected at runtime ("avx2", "sse4.1" or "scalar").
+ */
+const char* batch_stage_isa(void);
+
+#endif // BATCH_STAGE_H
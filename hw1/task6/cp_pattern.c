@@ -14,8 +14,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "../task3/cond_var.h"
+#include "ws_deque.h"
+#include "batch_stage.h"
+#include "flat_combining.h"
+#include "prio_lanes.h"
+#include "../common/lock_trace.h"
+#include "../common/sharded_counter.h"
+#include "../common/topology.h"
+#include <limits.h>
 #include <pthread.h>
 #include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #define MAX_NUM 1000000
 
@@ -31,20 +42,148 @@ typedef struct node {
 node_t* queue_head = NULL;
 node_t* queue_tail = NULL;
 
+/*
+ * Bounded mode (--capacity=N): the list is replaced by a fixed ring of N ints so memory
+ * stays bounded and the queue's working set stays cache-resident. Producers block on
+ * not_full while the ring is full. 0 means unbounded.
+ */
+int queue_capacity = 0;
+int* ring = NULL;
+int ring_head = 0;
+int ring_size = 0;
+
+/*
+ * Queue organisation selected on the command line.
+ *  - QUEUE_LIST: one shared linked list guarded by queue_lock (the original design).
+ *  - QUEUE_WS:   every consumer owns a Chase-Lev deque; producers hand items to the
+ *                consumer's inbox round-robin and idle consumers steal from their peers.
+ *  - QUEUE_FC:   the same shared list, but every operation on it (and on seen[] and
+ *                produced_count) is a request to a flat-combining executor, so one thread
+ *                applies a whole batch of them per lock handoff.
+ *  - QUEUE_PRIO: --lanes=K lock-free FIFO lanes, item n going to lane n % K (lane 0 is the
+ *                most urgent). Consumers drain higher lanes first, and every --quota=N-th
+ *                pop goes to a lower lane so that none of them starves.
+ */
+typedef enum { QUEUE_LIST, QUEUE_WS, QUEUE_FC, QUEUE_PRIO } queue_mode_t;
+queue_mode_t queue_mode = QUEUE_LIST;
+
+// Node handed from a producer to a consumer inbox in QUEUE_WS mode
+typedef struct {
+    ws_inbox_node link;
+    int value;
+} ws_node_t;
+
+// Per-consumer state in QUEUE_WS mode, only 'inbox' is written by other threads
+typedef struct {
+    ws_deque deque;
+    ws_inbox inbox;
+    _Alignas(WS_DEQUE_CACHE_LINE) atomic_long consumed;
+} consumer_state_t;
+
+consumer_state_t* consumer_states = NULL;
+
+// Requests understood by queue_apply in QUEUE_FC mode
+enum { FC_OP_PRODUCE, FC_OP_TAKE, FC_OP_EMPTY };
+
+#define FC_REJECTED 0    // FC_OP_PRODUCE: number was already produced
+#define FC_PRODUCED 1    // FC_OP_PRODUCE: number was queued
+#define FC_DONE    -1    // FC_OP_PRODUCE: all numbers are produced; FC_OP_TAKE: queue is empty
+
+/*
+ * QUEUE_FC state. Slots are numbered producers first, then consumers, then the main thread.
+ * Idle consumers park on fc_signal, which the combiner bumps after queueing an item.
+ */
+fc_executor queue_fc;
+atomic_int fc_signal = 0;
+atomic_int fc_parked = 0;
+wait_policy fc_wait_policy;
+
+static intptr_t queue_apply(void* state, int op, intptr_t arg);
+
+/*
+ * QUEUE_PRIO state. Idle consumers park on prio_signal like the flat-combining consumers
+ * on fc_signal. Each consumer records the queueing delay of its items per lane; the
+ * histograms are merged and reported at the end.
+ */
+#define PRIO_LANE_CAPACITY 65536
+
+typedef struct {
+    prio_cursor cursor;
+    prio_hist* hist;            // one per lane
+    _Alignas(PRIO_CACHE_LINE) atomic_long consumed;
+} prio_consumer_t;
+
+prio_queue prio;
+int prio_lanes = 4;
+int prio_quota = 8;
+prio_consumer_t* prio_states = NULL;
+atomic_int prio_signal = 0;
+atomic_int prio_parked = 0;
+wait_policy prio_wait_policy;
+
+/*
+ * Maximum number of items a consumer takes per dequeue (--batch=N). With N > 1 the
+ * items go through the vectorized batch stage and are printed with one write.
+ */
+int batch_size = 1;
+
+/*
+ * Aggregation mode (--aggregate): consumers print nothing per item. Each one tallies its
+ * items in its own accumulator instead, and the accumulators are merged into one summary
+ * after the consumers have stopped. Producers skip their per-item line as well, so the run
+ * is bound by the queue and the check rather than by stdout.
+ */
+int aggregate = 0;
+
+typedef struct {
+    _Alignas(WS_DEQUE_CACHE_LINE) long items;
+    long divisible;             // items divisible by 6
+    long long sum;              // of the values, every number is produced exactly once
+} aggregate_t;
+
+aggregate_t* aggregates = NULL;
+
+// Per-consumer scratch space for the batch stage
+typedef struct {
+    int* values;
+    unsigned char* divisible;
+    char* text;
+    aggregate_t* totals;        // this consumer's accumulator in aggregation mode
+} batch_buffers_t;
+
+/*
+ * Thread placement (--placement=...), none by default:
+ *  - PLACE_COMPACT: producers then consumers fill the CPUs in compact order, so the threads
+ *                   share cores and packages as much as possible.
+ *  - PLACE_SCATTER: the same over the scatter order, one thread per core and alternating
+ *                   packages before any core gets a second thread.
+ *  - PLACE_PAIR:    producer i and consumer i share a pair of neighbouring CPUs in compact
+ *                   order, i.e. SMT siblings of one core where the machine has them.
+ * Threads beyond the CPU count (or pair count) wrap around.
+ */
+typedef enum { PLACE_NONE, PLACE_COMPACT, PLACE_SCATTER, PLACE_PAIR } placement_t;
+placement_t placement = PLACE_NONE;
+static const char* placement_names[] = { "none", "compact", "scatter", "pair" };
+int* placement_cpus = NULL;
+int placement_count = 0;
+
 // Synchronization for the queue
 ticket_lock queue_lock;
 condition_variable is_empty;
+condition_variable not_full;
 
 
 // Counters and termination flag
-atomic_int produced_count = 0; // number of items produced
+/*
+ * Number of items produced, with MAX_NUM as its threshold. Producers poll the
+ * 'reached' flag instead of re-reading a counter every other producer writes to.
+ */
+sharded_counter produced_count;
 atomic_int stop_flag = 0;      // 1 = stop consumers
 
 // Lock for synchronized printing
 ticket_lock print_lock;
 
-condition_variable produced_done;
-
 pthread_t* prod_threads = NULL;
 pthread_t* cons_threads = NULL;
 int global_num_producers = 0;
@@ -66,6 +205,86 @@ void* producer_thread(void* arg);
  */
 void* consumer_thread(void* arg);
 
+/*
+ * Flat-combining producer and consumer thread functions (QUEUE_FC mode).
+ *
+ * 'arg' carries the thread's index among the producers or consumers.
+ */
+void* fc_producer_thread(void* arg);
+void* fc_consumer_thread(void* arg);
+
+/*
+ * Work-stealing consumer thread function (QUEUE_WS mode).
+ *
+ * 'arg' carries the consumer index. The consumer pops from its own deque, refills it from its
+ * inbox, and only when both are empty steals from the other consumers.
+ */
+void* ws_consumer_thread(void* arg);
+
+/*
+ * Priority-lane consumer thread function (QUEUE_PRIO mode).
+ *
+ * 'arg' carries the consumer index, which selects its cursor and latency histograms.
+ */
+void* prio_consumer_thread(void* arg);
+
+/*
+ * CPU for producer or consumer 'index' under the selected placement.
+ */
+static int placement_cpu(int is_consumer, int index) {
+    if (placement == PLACE_PAIR) {
+        int pairs = placement_count > 1 ? placement_count / 2 : 1;
+        int slot = 2 * (index % pairs) + is_consumer;
+        return placement_cpus[slot % placement_count];
+    }
+    int thread = is_consumer ? global_num_producers + index : index;
+    return placement_cpus[thread % placement_count];
+}
+
+/*
+ * Report where every thread will run, before any of them starts.
+ */
+static void print_placement(void) {
+    fflush(stdout);
+    fprintf(stderr, "  Placement: %s over %d CPUs\n", placement_names[placement], placement_count);
+    for (int is_consumer = 0; is_consumer <= 1; is_consumer++) {
+        int count = is_consumer ? global_num_consumers : global_num_producers;
+        for (int i = 0; i < count; i++) {
+            int cpu = placement_cpu(is_consumer, i);
+            fprintf(stderr, "  %s %d -> cpu %d (node %d, package %d, core %d)\n",
+                    is_consumer ? "consumer" : "producer", i, cpu, topology_node_of_cpu(cpu),
+                    topology_package_of_cpu(cpu), topology_core_of_cpu(cpu));
+        }
+    }
+}
+
+/*
+ * Create producer or consumer 'index' already bound to its CPU, so it never runs anywhere
+ * else. If the bound create fails the thread is left to the scheduler.
+ */
+static void create_thread(pthread_t* thread, void* (*fn)(void*), int is_consumer, int index) {
+    const char* role = is_consumer ? "consumer" : "producer";
+    int err = -1;                   // not created yet
+    if (placement != PLACE_NONE) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (topology_bind_attr(&attr, placement_cpu(is_consumer, index)) == 0) {
+            err = pthread_create(thread, &attr, fn, (void*)(intptr_t)index);
+        }
+        pthread_attr_destroy(&attr);
+        if (err != 0) {
+            fprintf(stderr, "  %s %d: bind failed, left to the scheduler\n", role, index);
+        }
+    }
+    if (err != 0) {
+        err = pthread_create(thread, NULL, fn, (void*)(intptr_t)index);
+    }
+    if (err != 0) {
+        fprintf(stderr, "Error creating %s thread %d (code %d)\n", role, index, err);
+        exit(1);
+    }
+}
+
 /*
  * Start the producer-consumer process.
  *
@@ -89,7 +308,17 @@ void start_consumers_producers(int consumers, int producers, int seed) {
     ticketlock_init(&queue_lock);         // for synchronizing queue access
     ticketlock_init(&print_lock);         // for synchronized printing
     condition_variable_init(&is_empty);   // for waking consumers when queue is not empty
-    condition_variable_init(&produced_done);
+    condition_variable_init(&not_full);   // for waking producers when the bounded queue has room
+    lock_stats_set_name(&queue_lock, "queue_lock");
+    lock_stats_set_name(&print_lock, "print_lock");
+    lock_stats_set_name(&is_empty, "is_empty");
+    lock_stats_set_name(&not_full, "not_full");
+
+    if (sharded_counter_init(&produced_count, 0) != 0) {
+        fprintf(stderr, "Failed to allocate memory for the produced counter\n");
+        exit(1);
+    }
+    sharded_counter_set_threshold(&produced_count, MAX_NUM);
 
     global_num_producers = producers;
     global_num_consumers = consumers;
@@ -108,23 +337,161 @@ void start_consumers_producers(int consumers, int producers, int seed) {
         exit(1);
     }
 
-    // Create producer threads
-    for (int i = 0; i < producers; i++) {
-        int err = pthread_create(&prod_threads[i], NULL, producer_thread, NULL);
-        if (err != 0) {
-            fprintf(stderr, "Error creating producer thread %d (code %d)\n", i, err);
+    if (queue_capacity > 0) {
+        ring = malloc(sizeof(int) * queue_capacity);
+        if (ring == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the bounded queue\n");
             exit(1);
         }
     }
 
-    // Create consumer threads
-    for (int i = 0; i < consumers; i++) {
-        int err = pthread_create(&cons_threads[i], NULL, consumer_thread, NULL);
-        if (err != 0) {
-            fprintf(stderr, "Error creating consumer thread %d (code %d)\n", i, err);
+    if (queue_mode == QUEUE_WS) {
+        size_t size = sizeof(consumer_state_t) * consumers;
+        consumer_states = aligned_alloc(WS_DEQUE_CACHE_LINE, size);
+        if (consumer_states == NULL) {
+            fprintf(stderr, "Failed to allocate memory for consumer deques\n");
             exit(1);
         }
+        memset(consumer_states, 0, size);
+        for (int i = 0; i < consumers; i++) {
+            if (ws_deque_init(&consumer_states[i].deque, 1024) != 0) {
+                fprintf(stderr, "Failed to allocate memory for consumer deques\n");
+                exit(1);
+            }
+            ws_inbox_init(&consumer_states[i].inbox);
+            atomic_init(&consumer_states[i].consumed, 0);
+        }
+    }
+
+    if (queue_mode == QUEUE_FC) {
+        if (fc_init(&queue_fc, producers + consumers + 1, queue_apply, NULL) != 0) {
+            fprintf(stderr, "Failed to allocate memory for the combining slots\n");
+            exit(1);
+        }
+        wait_policy_default(&fc_wait_policy);
+    }
+
+    if (queue_mode == QUEUE_PRIO) {
+        if (prio_queue_init(&prio, prio_lanes, PRIO_LANE_CAPACITY, prio_quota) != 0) {
+            fprintf(stderr, "Failed to allocate memory for the priority lanes\n");
+            exit(1);
+        }
+        prio_states = aligned_alloc(PRIO_CACHE_LINE, sizeof(prio_consumer_t) * consumers);
+        if (prio_states == NULL) {
+            fprintf(stderr, "Failed to allocate memory for consumer lane state\n");
+            exit(1);
+        }
+        for (int i = 0; i < consumers; i++) {
+            prio_cursor_init(&prio_states[i].cursor);
+            prio_states[i].hist = calloc(prio_lanes, sizeof(prio_hist));
+            if (prio_states[i].hist == NULL) {
+                fprintf(stderr, "Failed to allocate memory for latency histograms\n");
+                exit(1);
+            }
+            atomic_init(&prio_states[i].consumed, 0);
+        }
+        wait_policy_default(&prio_wait_policy);
+    }
+
+    if (aggregate) {
+        size_t size = sizeof(aggregate_t) * consumers;
+        aggregates = aligned_alloc(WS_DEQUE_CACHE_LINE, size);
+        if (aggregates == NULL) {
+            fprintf(stderr, "Failed to allocate memory for consumer accumulators\n");
+            exit(1);
+        }
+        memset(aggregates, 0, size);
+    }
+
+    if (placement != PLACE_NONE) {
+        int max_cpus = (int)sysconf(_SC_NPROCESSORS_CONF);
+        placement_cpus = malloc(sizeof(int) * max_cpus);
+        if (placement_cpus == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the placement\n");
+            exit(1);
+        }
+        int order = placement == PLACE_SCATTER ? TOPOLOGY_SCATTER : TOPOLOGY_COMPACT;
+        placement_count = topology_cpu_order(order, placement_cpus, max_cpus);
+        if (placement_count == 0) {
+            fprintf(stderr, "Failed to read the CPUs available for placement\n");
+            exit(1);
+        }
+        print_placement();
+    }
+
+    // Create producer threads
+    for (int i = 0; i < producers; i++) {
+        void* (*fn)(void*) = (queue_mode == QUEUE_FC) ? fc_producer_thread : producer_thread;
+        create_thread(&prod_threads[i], fn, 0, i);
+    }
+
+    // Create consumer threads
+    for (int i = 0; i < consumers; i++) {
+        void* (*fn)(void*) = (queue_mode == QUEUE_WS) ? ws_consumer_thread
+                           : (queue_mode == QUEUE_FC) ? fc_consumer_thread
+                           : (queue_mode == QUEUE_PRIO) ? prio_consumer_thread : consumer_thread;
+        create_thread(&cons_threads[i], fn, 1, i);
+    }
+}
+
+// Monotonic time in nanoseconds, for the lane latencies
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/*
+ * Queue helpers for QUEUE_LIST mode. All of them must be called with queue_lock held.
+ */
+static int queue_empty(void) {
+    return queue_capacity > 0 ? ring_size == 0 : queue_head == NULL;
+}
+
+static int queue_full(void) {
+    return queue_capacity > 0 && ring_size >= queue_capacity;
+}
+
+static void queue_push(int num) {
+    if (queue_capacity > 0) {
+        ring[(ring_head + ring_size) % queue_capacity] = num;
+        ring_size++;
+        return;
+    }
+
+    node_t* new_node = malloc(sizeof(node_t));
+    if (!new_node) {
+        fprintf(stderr, "malloc failed\n");
+        exit(1);
+    }
+
+    new_node->value = num;
+    new_node->next = NULL;
+
+    if (queue_tail) {
+        queue_tail->next = new_node;
+    } else {
+        queue_head = new_node;
+    }
+    queue_tail = new_node;
+}
+
+// The caller frees the returned node outside the lock, NULL in bounded mode
+static node_t* queue_pop(int* num) {
+    if (queue_capacity > 0) {
+        *num = ring[ring_head];
+        ring_head = (ring_head + 1) % queue_capacity;
+        ring_size--;
+        return NULL;
     }
+
+    node_t* node = queue_head;
+    *num = node->value;
+    queue_head = node->next;
+    if (queue_head == NULL) {
+        queue_tail = NULL;
+    }
+    return node;
 }
 
 /*
@@ -134,36 +501,64 @@ void start_consumers_producers(int consumers, int producers, int seed) {
  * The producer stops when the maximum number of items has been produced.
  */
 void* producer_thread(void* arg){
+    int next_consumer = (int)(intptr_t)arg; // round-robin target in QUEUE_WS mode
 
-    while ((atomic_load(&produced_count) < MAX_NUM)){
+    while (!sharded_counter_reached(&produced_count)){
         int num = rand() % MAX_NUM;
 
         ticketlock_acquire(&queue_lock);
 
+        // backpressure: block while the bounded queue is full
+        while (queue_full() && !sharded_counter_reached(&produced_count)) {
+            condition_variable_wait(&not_full, &queue_lock);
+        }
+        if (sharded_counter_reached(&produced_count)) {
+            condition_variable_signal(&not_full); // pass the wakeup on to the next blocked producer
+            ticketlock_release(&queue_lock);
+            break;
+        }
+
         if (!seen[num]) {
             seen[num] = 1;
 
-            printf("Producer %lu generated number: %d\n", (unsigned long)pthread_self(), num);
+            if (!aggregate) {
+                printf("Producer %lu generated number: %d\n", (unsigned long)pthread_self(), num);
+            }
 
-            node_t* new_node = malloc(sizeof(node_t));
-            if (!new_node) {
-                fprintf(stderr, "malloc failed\n");
-                exit(1);
+            if (queue_mode == QUEUE_WS) {
+                sharded_counter_add(&produced_count, 1); // reaching MAX_NUM wakes the main thread
+                ticketlock_release(&queue_lock);
+
+                // hand off outside the lock, the inbox is lock-free
+                ws_node_t* ws_node = malloc(sizeof(ws_node_t));
+                if (!ws_node) {
+                    fprintf(stderr, "malloc failed\n");
+                    exit(1);
+                }
+                ws_node->value = num;
+                next_consumer = (next_consumer + 1) % global_num_consumers;
+                ws_inbox_push(&consumer_states[next_consumer].inbox, &ws_node->link);
+                continue;
             }
 
-            new_node->value = num;
-            new_node->next = NULL;
+            if (queue_mode == QUEUE_PRIO) {
+                sharded_counter_add(&produced_count, 1);
+                ticketlock_release(&queue_lock);
 
-            if (queue_tail) {
-                queue_tail->next = new_node;
-            } else {
-                queue_head = new_node;
+                // the lanes are lock-free; a full lane is backpressure, wait for a consumer
+                wait_state ws = WAIT_STATE_INIT;
+                while (prio_queue_push(&prio, num % prio_lanes, num, now_ns()) != 0) {
+                    wait_pause(&prio_wait_policy, &ws, NULL, 0, NULL);
+                }
+                atomic_fetch_add(&prio_signal, 1);
+                wait_wake(&prio_wait_policy, &prio_signal, &prio_parked, 1);
+                continue;
             }
-            queue_tail = new_node;
 
-            int prev = atomic_fetch_add(&produced_count, 1);
-            if (prev + 1 == MAX_NUM) {
-                condition_variable_signal(&produced_done);
+            queue_push(num);
+
+            if (sharded_counter_add(&produced_count, 1)) {
+                condition_variable_signal(&not_full); // release producers blocked on a full queue
             }
 
             condition_variable_signal(&is_empty);
@@ -176,6 +571,86 @@ void* producer_thread(void* arg){
     return NULL;
 }   
 
+/*
+ * Check whether 'num' is divisible by 6 and print the result.
+ */
+static void check_number(int num) {
+    char buffer[100];
+    snprintf(buffer, sizeof(buffer),
+        "Consumer %lu checked %d. Is it divisible by 6? %s",
+        (unsigned long)pthread_self(), num,
+        (num % 6 == 0) ? "True" : "False");
+
+    print_msg(buffer);
+}
+
+/*
+ * Print a block of complete lines with synchronized access.
+ */
+static void print_block(const char* buf, size_t len) {
+    ticketlock_acquire(&print_lock);
+    fwrite(buf, 1, len, stdout);
+    ticketlock_release(&print_lock);
+}
+
+/*
+ * Check 'count' numbers and add them to the consumer's accumulator. Only the owner writes
+ * to it, and the main thread reads it after joining the consumers.
+ */
+static void aggregate_numbers(batch_buffers_t* b, int count) {
+    aggregate_t* totals = b->totals;
+    long divisible = 0;
+    long long sum = 0;
+    if (count == 1) {
+        divisible = b->values[0] % 6 == 0;
+        sum = b->values[0];
+    } else {
+        batch_check_div6(b->values, b->divisible, count);
+        for (int i = 0; i < count; i++) {
+            divisible += b->divisible[i];
+            sum += b->values[i];
+        }
+    }
+    totals->items += count;
+    totals->divisible += divisible;
+    totals->sum += sum;
+}
+
+/*
+ * Check and print 'count' numbers stored in b->values.
+ * Single items keep the original snprintf path, batches go through the SIMD stage.
+ */
+static void check_numbers(batch_buffers_t* b, int count) {
+    if (aggregate) {
+        aggregate_numbers(b, count);
+        return;
+    }
+    if (count == 1) {
+        check_number(b->values[0]);
+        return;
+    }
+    batch_check_div6(b->values, b->divisible, count);
+    size_t len = batch_format(b->text, (unsigned long)pthread_self(), b->values, b->divisible, count);
+    print_block(b->text, len);
+}
+
+static void batch_buffers_alloc(batch_buffers_t* b, int consumer) {
+    b->values = malloc(sizeof(int) * batch_size);
+    b->divisible = malloc(batch_size);
+    b->text = malloc((size_t)batch_size * BATCH_LINE_MAX);
+    if (b->values == NULL || b->divisible == NULL || b->text == NULL) {
+        fprintf(stderr, "Failed to allocate memory for consumer batch buffers\n");
+        exit(1);
+    }
+    b->totals = aggregate ? &aggregates[consumer] : NULL;
+}
+
+static void batch_buffers_free(batch_buffers_t* b) {
+    free(b->values);
+    free(b->divisible);
+    free(b->text);
+}
+
 /*
  * Consumer thread function.
  *
@@ -183,39 +658,292 @@ void* producer_thread(void* arg){
  * The consumer stops when the stop flag is set and the queue is empty.
  */
 void* consumer_thread(void* arg) {
+    batch_buffers_t b;
+    batch_buffers_alloc(&b, (int)(intptr_t)arg);
+
     while (1) {
         ticketlock_acquire(&queue_lock);
 
-        while (queue_head == NULL) {
+        while (queue_empty()) {
             if (atomic_load(&stop_flag)) {
                 ticketlock_release(&queue_lock);
+                batch_buffers_free(&b);
                 return NULL;
             }
             condition_variable_wait(&is_empty, &queue_lock);
         }
 
-        // dequeue
-        node_t* node = queue_head;
-        int num = node->value;
-        queue_head = node->next;
-        if (queue_head == NULL) {
-            queue_tail = NULL;
+        // dequeue up to batch_size items under one lock acquisition
+        int count = 0;
+        node_t* to_free = NULL;
+        while (count < batch_size && !queue_empty()) {
+            node_t* node = queue_pop(&b.values[count++]);
+            if (node != NULL) {
+                node->next = to_free;
+                to_free = node;
+            }
+        }
+        // one wakeup per freed slot; signals sent before a producer wakes would merge into one
+        if (queue_capacity > 0 && count > 1) {
+            condition_variable_broadcast(&not_full);
+        } else if (queue_capacity > 0) {
+            condition_variable_signal(&not_full);
         }
 
         ticketlock_release(&queue_lock);
+        while (to_free != NULL) {
+            node_t* next = to_free->next;
+            free(to_free);
+            to_free = next;
+        }
+
+        check_numbers(&b, count);
+    }
+}
+
+/*
+ * Flat-combining apply function: runs on the combiner thread with exclusive access to the
+ * list, seen[] and produced_count, for requests of every producer and consumer.
+ */
+static intptr_t queue_apply(void* state, int op, intptr_t arg) {
+    (void)state;
+    switch (op) {
+    case FC_OP_PRODUCE: {
+        int num = (int)arg;
+        if (sharded_counter_reached(&produced_count)) {
+            return FC_DONE;
+        }
+        if (seen[num]) {
+            return FC_REJECTED;
+        }
+        seen[num] = 1;
+        queue_push(num);
+        sharded_counter_add(&produced_count, 1);
+        atomic_fetch_add(&fc_signal, 1);
+        wait_wake(&fc_wait_policy, &fc_signal, &fc_parked, 1);
+        return FC_PRODUCED;
+    }
+    case FC_OP_TAKE: {
+        if (queue_empty()) {
+            return FC_DONE;
+        }
+        int num;
+        free(queue_pop(&num));
+        return num;
+    }
+    case FC_OP_EMPTY:
+        return queue_empty();
+    }
+    return FC_DONE;
+}
+
+/*
+ * Producer thread function for QUEUE_FC mode.
+ *
+ * The uniqueness check and the enqueue are one combined request. The message is printed
+ * after the request returns, so it is no longer serialized by the queue.
+ */
+void* fc_producer_thread(void* arg) {
+    int slot = (int)(intptr_t)arg;
+
+    while (!sharded_counter_reached(&produced_count)) {
+        int num = rand() % MAX_NUM;
+        if (fc_execute(&queue_fc, slot, FC_OP_PRODUCE, num) == FC_PRODUCED && !aggregate) {
+            printf("Producer %lu generated number: %d\n", (unsigned long)pthread_self(), num);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Consumer thread function for QUEUE_FC mode.
+ *
+ * Takes up to batch_size items with one request each. With nothing to take it waits on
+ * fc_signal, read before the attempt so that an item queued in between is not missed.
+ */
+void* fc_consumer_thread(void* arg) {
+    int slot = global_num_producers + (int)(intptr_t)arg;
+    batch_buffers_t b;
+    batch_buffers_alloc(&b, (int)(intptr_t)arg);
+    wait_state ws = WAIT_STATE_INIT;
+
+    while (1) {
+        int signal = atomic_load(&fc_signal);
+        int count = 0;
+        intptr_t num;
+        while (count < batch_size && (num = fc_execute(&queue_fc, slot, FC_OP_TAKE, 0)) != FC_DONE) {
+            b.values[count++] = (int)num;
+        }
+        if (count > 0) {
+            check_numbers(&b, count);
+            wait_state fresh = WAIT_STATE_INIT;
+            ws = fresh;
+            continue;
+        }
+        if (atomic_load(&stop_flag)) {
+            batch_buffers_free(&b);
+            return NULL;
+        }
+        wait_pause(&fc_wait_policy, &ws, &fc_signal, signal, &fc_parked);
+    }
+}
+
+/*
+ * Move every node waiting in 'inbox' into the calling consumer's deque.
+ * Returns the number of items moved.
+ */
+static int ws_refill(consumer_state_t* me, ws_inbox* inbox) {
+    int moved = 0;
+    ws_inbox_node* node = ws_inbox_take_all(inbox);
+    while (node != NULL) {
+        ws_inbox_node* next = node->next;
+        if (ws_deque_push(&me->deque, ((ws_node_t*)node)->value) != 0) {
+            fprintf(stderr, "Failed to grow consumer deque\n");
+            exit(1);
+        }
         free(node);
+        node = next;
+        moved++;
+    }
+    return moved;
+}
+
+/*
+ * Find the next number for consumer 'self': own deque first, then own inbox,
+ * then the other consumers' deques and inboxes. Returns 1 if a number was found.
+ */
+static int ws_next_number(int self, int* num) {
+    consumer_state_t* me = &consumer_states[self];
+    intptr_t value;
+
+    if (ws_deque_pop(&me->deque, &value) == WS_DEQUE_OK) {
+        *num = (int)value;
+        return 1;
+    }
+    if (ws_refill(me, &me->inbox) > 0 && ws_deque_pop(&me->deque, &value) == WS_DEQUE_OK) {
+        *num = (int)value;
+        return 1;
+    }
+
+    for (int i = 1; i < global_num_consumers; i++) {
+        consumer_state_t* victim = &consumer_states[(self + i) % global_num_consumers];
+        if (ws_deque_steal(&victim->deque, &value) == WS_DEQUE_OK) {
+            *num = (int)value;
+            return 1;
+        }
+        // a busy peer may not have drained its inbox yet, take the whole batch
+        if (ws_refill(me, &victim->inbox) > 0 && ws_deque_pop(&me->deque, &value) == WS_DEQUE_OK) {
+            *num = (int)value;
+            return 1;
+        }
+    }
+    return 0;
+}
 
-        // check and print
-        char buffer[100];
-        snprintf(buffer, sizeof(buffer),
-            "Consumer %lu checked %d. Is it divisible by 6? %s",
-            (unsigned long)pthread_self(), num,
-            (num % 6 == 0) ? "True" : "False");
+/*
+ * Work-stealing consumer thread function.
+ *
+ * The common path touches only the consumer's own deque and counter. The consumer
+ * exits once the stop flag is set and there is nothing left to pop or steal.
+ */
+void* ws_consumer_thread(void* arg) {
+    int self = (int)(intptr_t)arg;
+    consumer_state_t* me = &consumer_states[self];
+    batch_buffers_t b;
+    batch_buffers_alloc(&b, self);
 
-        print_msg(buffer);
+    while (1) {
+        int count = 0;
+        while (count < batch_size && ws_next_number(self, &b.values[count])) {
+            count++;
+        }
+        if (count > 0) {
+            check_numbers(&b, count);
+            // only this thread writes the counter, no read-modify-write needed
+            atomic_store_explicit(&me->consumed,
+                atomic_load_explicit(&me->consumed, memory_order_relaxed) + count, memory_order_release);
+            continue;
+        }
+        if (atomic_load(&stop_flag)) {
+            batch_buffers_free(&b);
+            return NULL;
+        }
+        sched_yield();
     }
 }
 
+/*
+ * Priority-lane consumer thread function.
+ *
+ * Pops items one at a time in priority order, so an urgent item that arrives while a batch
+ * is being collected still goes first. Waits on prio_signal, read before the attempt, when
+ * every lane is empty.
+ */
+void* prio_consumer_thread(void* arg) {
+    prio_consumer_t* me = &prio_states[(int)(intptr_t)arg];
+    batch_buffers_t b;
+    batch_buffers_alloc(&b, (int)(intptr_t)arg);
+    wait_state ws = WAIT_STATE_INIT;
+
+    while (1) {
+        int signal = atomic_load(&prio_signal);
+        int count = 0;
+        int lane;
+        long enqueued;
+        while (count < batch_size && prio_queue_pop(&prio, &me->cursor, &b.values[count], &lane, &enqueued)) {
+            prio_hist_record(&me->hist[lane], now_ns() - enqueued);
+            count++;
+        }
+        if (count > 0) {
+            check_numbers(&b, count);
+            atomic_store_explicit(&me->consumed,
+                atomic_load_explicit(&me->consumed, memory_order_relaxed) + count, memory_order_release);
+            wait_state fresh = WAIT_STATE_INIT;
+            ws = fresh;
+            continue;
+        }
+        if (atomic_load(&stop_flag)) {
+            batch_buffers_free(&b);
+            return NULL;
+        }
+        wait_pause(&prio_wait_policy, &ws, &prio_signal, signal, &prio_parked);
+    }
+}
+
+/*
+ * Print the queueing delay percentiles of every lane, merged over all consumers.
+ */
+static void print_lane_latencies(FILE* out) {
+    for (int lane = 0; lane < prio_lanes; lane++) {
+        prio_hist total = {0};
+        for (int i = 0; i < global_num_consumers; i++) {
+            prio_hist_merge(&total, &prio_states[i].hist[lane]);
+        }
+        fprintf(out, "  Lane %d: %ld items, latency us p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+                lane, total.count, prio_hist_percentile(&total, 50) / 1e3,
+                prio_hist_percentile(&total, 90) / 1e3, prio_hist_percentile(&total, 99) / 1e3,
+                prio_hist_percentile(&total, 99.9) / 1e3, total.max_ns / 1e3);
+    }
+}
+
+/*
+ * Merge the consumers' accumulators and print the totals and each consumer's share.
+ */
+static void print_aggregate(FILE* out, double elapsed) {
+    aggregate_t total = {0};
+    for (int i = 0; i < global_num_consumers; i++) {
+        total.items += aggregates[i].items;
+        total.divisible += aggregates[i].divisible;
+        total.sum += aggregates[i].sum;
+    }
+    fprintf(out, "  Items: %ld, divisible by 6: %ld, sum: %lld\n", total.items, total.divisible, total.sum);
+    for (int i = 0; i < global_num_consumers; i++) {
+        fprintf(out, "  Consumer %d: %ld items (%.1f%%), %ld divisible by 6\n", i, aggregates[i].items,
+                total.items ? 100.0 * aggregates[i].items / total.items : 0.0, aggregates[i].divisible);
+    }
+    fprintf(out, "  Throughput: %.0f items/sec\n", total.items / elapsed);
+}
+
 /*
  * Stop all consumer threads.
  *
@@ -224,6 +952,14 @@ void* consumer_thread(void* arg) {
 void stop_consumers() {
     atomic_store(&stop_flag, 1);
     condition_variable_broadcast(&is_empty); 
+    if (queue_mode == QUEUE_FC) {
+        atomic_fetch_add(&fc_signal, 1);
+        wait_wake(&fc_wait_policy, &fc_signal, &fc_parked, INT_MAX);
+    }
+    if (queue_mode == QUEUE_PRIO) {
+        atomic_fetch_add(&prio_signal, 1);
+        wait_wake(&prio_wait_policy, &prio_signal, &prio_parked, INT_MAX);
+    }
 }
 
 /*
@@ -246,11 +982,7 @@ void print_msg(const char* msg) {
  * This function blocks until all numbers between 0 and MAX_NUM have been produced by the producers.
  */
 void wait_until_producers_produced_all_numbers() {
-    ticketlock_acquire(&queue_lock);
-    while (atomic_load(&produced_count) < MAX_NUM) {
-        condition_variable_wait(&produced_done, &queue_lock);
-    }
-    ticketlock_release(&queue_lock);
+    sharded_counter_wait(&produced_count);
 }
 
 /*
@@ -260,10 +992,45 @@ void wait_until_producers_produced_all_numbers() {
  * it returns immediately.
  */
 void wait_consumers_queue_empty() {
+    if (queue_mode == QUEUE_WS) {
+        // every item is counted by the consumer that processed it
+        while (1) {
+            long consumed = 0;
+            for (int i = 0; i < global_num_consumers; i++) {
+                consumed += atomic_load_explicit(&consumer_states[i].consumed, memory_order_acquire);
+            }
+            if (consumed == MAX_NUM) {
+                return;
+            }
+            sched_yield();
+        }
+    }
+
+    if (queue_mode == QUEUE_PRIO) {
+        while (1) {
+            long consumed = 0;
+            for (int i = 0; i < global_num_consumers; i++) {
+                consumed += atomic_load_explicit(&prio_states[i].consumed, memory_order_acquire);
+            }
+            if (consumed == MAX_NUM) {
+                return;
+            }
+            sched_yield();
+        }
+    }
+
+    if (queue_mode == QUEUE_FC) {
+        int slot = global_num_producers + global_num_consumers;
+        while (!fc_execute(&queue_fc, slot, FC_OP_EMPTY, 0) || !sharded_counter_reached(&produced_count)) {
+            sched_yield();
+        }
+        return;
+    }
+
     while (1) {
         ticketlock_acquire(&queue_lock);
 
-        if (queue_head == NULL && atomic_load(&produced_count) == MAX_NUM) {
+        if (queue_empty() && sharded_counter_reached(&produced_count)) {
             ticketlock_release(&queue_lock);
             return; // All work is done and queue is empty
         }
@@ -274,6 +1041,100 @@ void wait_consumers_queue_empty() {
 
 }
 
+/*
+ * Print the usage message and exit.
+ */
+static void usage(void) {
+    fprintf(stderr, "usage: cp pattern [consumers] [producers] [seed] [--queue=list|ws|fc|prio] [--capacity=N] [--batch=N]\n"
+                    "                  [--lanes=K] [--quota=N] [--placement=compact|scatter|pair] [--aggregate]\n");
+    exit(1);
+}
+
+/*
+ * Parse the optional arguments that follow the three positional ones.
+ */
+static void parse_options(int argc, char* argv[]) {
+    int lane_options = 0;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--queue=list") == 0) {
+            queue_mode = QUEUE_LIST;
+        } else if (strcmp(argv[i], "--queue=ws") == 0) {
+            queue_mode = QUEUE_WS;
+        } else if (strcmp(argv[i], "--queue=fc") == 0) {
+            queue_mode = QUEUE_FC;
+        } else if (strcmp(argv[i], "--queue=prio") == 0) {
+            queue_mode = QUEUE_PRIO;
+        } else if (strcmp(argv[i], "--aggregate") == 0) {
+            aggregate = 1;
+        } else if (strcmp(argv[i], "--placement=compact") == 0) {
+            placement = PLACE_COMPACT;
+        } else if (strcmp(argv[i], "--placement=scatter") == 0) {
+            placement = PLACE_SCATTER;
+        } else if (strcmp(argv[i], "--placement=pair") == 0) {
+            placement = PLACE_PAIR;
+        } else if (strncmp(argv[i], "--lanes=", 8) == 0) {
+            prio_lanes = atoi(argv[i] + 8);
+            lane_options = 1;
+            if (prio_lanes <= 0 || prio_lanes > PRIO_MAX_LANES) {
+                usage();
+            }
+        } else if (strncmp(argv[i], "--quota=", 8) == 0) {
+            prio_quota = atoi(argv[i] + 8);
+            lane_options = 1;
+            if (prio_quota <= 0) {
+                usage();
+            }
+        } else if (strncmp(argv[i], "--batch=", 8) == 0) {
+            batch_size = atoi(argv[i] + 8);
+            if (batch_size <= 0) {
+                usage();
+            }
+        } else if (strncmp(argv[i], "--capacity=", 11) == 0) {
+            queue_capacity = atoi(argv[i] + 11);
+            if (queue_capacity <= 0) {
+                usage();
+            }
+        } else {
+            usage();
+        }
+    }
+
+    // the work-stealing deques grow on demand, only the lock-guarded list can be bounded
+    if (queue_mode != QUEUE_LIST && queue_capacity > 0) {
+        fprintf(stderr, "--capacity is only supported with --queue=list\n");
+        exit(1);
+    }
+    if (queue_mode != QUEUE_PRIO && lane_options) {
+        fprintf(stderr, "--lanes and --quota are only supported with --queue=prio\n");
+        exit(1);
+    }
+}
+
+/*
+ * Write the lock trace to the file named by LOCK_TRACE_OUT, if set.
+ * Convert it with tools/trace2chrome to inspect queue_lock convoys.
+ */
+static void write_trace(void) {
+    const char* path = getenv("LOCK_TRACE_OUT");
+    if (path == NULL) {
+        return;
+    }
+    FILE* out = fopen(path, "wb");
+    if (out == NULL || lock_trace_write(out) != 0) {
+        fprintf(stderr, "Failed to write lock trace to %s\n", path);
+    }
+    if (out != NULL) {
+        fclose(out);
+    }
+}
+
+// Monotonic wall-clock time in seconds
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 /*
  * Main function.
  *
@@ -288,20 +1149,20 @@ void wait_consumers_queue_empty() {
  *  - Exit status code.
  */
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "usage: cp pattern [consumers] [producers] [seed]\n");
-        exit(1);
+    if (argc < 4) {
+        usage();
     }
+    parse_options(argc, argv);
     
     int consumers = atoi(argv[1]);
     int producers = atoi(argv[2]);
     int seed = atoi(argv[3]);
 
     if (consumers <= 0 || producers <= 0 || seed <= 0) {
-        fprintf(stderr, "usage: cp pattern [consumers] [producers] [seed]\n");
-        exit(1);
+        usage();
     }
 
+    double start = now_sec();
     start_consumers_producers(consumers, producers, seed);
     wait_until_producers_produced_all_numbers();
     wait_consumers_queue_empty();
@@ -315,5 +1176,41 @@ int main(int argc, char* argv[]) {
         pthread_join(cons_threads[i], NULL);
     }
 
+    // reported on stderr so that capacity sweeps can discard the per-item output
+    double elapsed = now_sec() - start;
+    fprintf(stderr, "  Elapsed: %.3f s, throughput: %.0f items/sec, capacity: %d\n",
+            elapsed, MAX_NUM / elapsed, queue_capacity);
+
+    if (queue_mode == QUEUE_PRIO) {
+        print_lane_latencies(stderr);
+    }
+    if (aggregate) {
+        print_aggregate(stdout, elapsed);
+    }
+
+    lock_stats_dump(stderr, LOCK_STATS_TEXT); // no-op unless built with -DLOCK_STATS
+    write_trace();                            // no-op unless built with -DLOCK_TRACE
+
+    free(ring);
+    free(placement_cpus);
+    free(aggregates);
+    if (consumer_states != NULL) {
+        for (int i = 0; i < global_num_consumers; i++) {
+            ws_deque_destroy(&consumer_states[i].deque);
+        }
+        free(consumer_states);
+    }
+    if (queue_mode == QUEUE_FC) {
+        fc_destroy(&queue_fc);
+    }
+    if (prio_states != NULL) {
+        for (int i = 0; i < global_num_consumers; i++) {
+            free(prio_states[i].hist);
+        }
+        free(prio_states);
+        prio_queue_destroy(&prio);
+    }
+    sharded_counter_destroy(&produced_count);
+
     return 0;
 }
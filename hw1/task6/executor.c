@@ -0,0 +1,334 @@
+/*
+ * executor.c
+ *
+ * Implementation of the thread-pool executor.
+ *
+ * Idle workers park on 'work_seq' with the usual handshake: a worker reads the sequence
+ * before looking for work and parks only while it is unchanged, a submitter publishes the
+ * task before bumping it. A task submitted while a worker searched is never missed. The
+ * bump is a release and the worker's read an acquire, which is all this handshake needs.
+ *
+ * A submitter reads the slot states (in pick_worker) before it pushes to the chosen inbox,
+ * so there is no handshake with a retiring worker: the worker can leave RUNNING, find its
+ * inbox empty and exit, and the task lands in the dead slot's inbox afterwards. What makes
+ * this safe is only that every worker that runs out of local work also takes its peers'
+ * inboxes, as cp_pattern's work-stealing consumers do, dead slots included, and that the
+ * submission bumps 'work_seq' and wakes one of them. At least min_workers stay live, so such
+ * a task is always picked up by somebody else. The slots' 'state' and the 'live' count keep
+ * sequentially consistent accesses, but nothing above relies on them being more than
+ * atomic.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "executor.h"
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXECUTOR_DEQUE_CAPACITY 64
+
+static __thread executor_worker* current_worker = NULL;
+
+static executor_task* task_of(executor_future* future) {
+    return (executor_task*)((char*)future - offsetof(executor_task, future));
+}
+
+static void task_release(executor_task* task) {
+    if (atomic_fetch_sub_explicit(&task->future.refs, 1, ORDER_ACQ_REL) == 1) {
+        free(task);
+    }
+}
+
+static void run_task(executor* ex, executor_task* task) {
+    executor_future* future = &task->future;
+    future->result = task->fn(task->arg);
+    atomic_store_explicit(&future->done, 1, ORDER_RELEASE);
+    wait_wake(&future->policy, &future->done, &future->parked, INT_MAX);
+    task_release(task);
+
+    if (atomic_fetch_sub_explicit(&ex->pending, 1, ORDER_RELEASE) == 1) {
+        wait_wake(&ex->policy, &ex->pending, &ex->pending_parked, INT_MAX);
+    }
+}
+
+// Moves every task in 'inbox' into the calling worker's deque, returns 1 if there was any
+static int refill(executor_worker* self, ws_inbox* inbox) {
+    ws_inbox_node* node = ws_inbox_take_all(inbox);
+    if (node == NULL) {
+        return 0;
+    }
+    while (node != NULL) {
+        ws_inbox_node* next = node->next;
+        if (ws_deque_push(&self->deque, (intptr_t)node) != 0) {
+            fprintf(stderr, "Failed to grow worker deque\n");
+            exit(1);
+        }
+        node = next;
+    }
+    return 1;
+}
+
+/*
+ * find_task
+ *
+ * Own deque, then own inbox, then each peer's deque and inbox in turn.
+ */
+static executor_task* find_task(executor* ex, executor_worker* self) {
+    intptr_t value;
+    if (ws_deque_pop(&self->deque, &value) == WS_DEQUE_OK) {
+        return (executor_task*)value;
+    }
+    if (refill(self, &self->inbox) && ws_deque_pop(&self->deque, &value) == WS_DEQUE_OK) {
+        return (executor_task*)value;
+    }
+
+    int id = (int)(self - ex->workers);
+    for (int i = 1; i < ex->max_workers; i++) {
+        executor_worker* victim = &ex->workers[(id + i) % ex->max_workers];
+        int rc;
+        while ((rc = ws_deque_steal(&victim->deque, &value)) == WS_DEQUE_ABORT) {
+            wait_cpu_relax();
+        }
+        if (rc == WS_DEQUE_OK) {
+            return (executor_task*)value;
+        }
+        if (refill(self, &victim->inbox) && ws_deque_pop(&self->deque, &value) == WS_DEQUE_OK) {
+            return (executor_task*)value;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * try_retire
+ *
+ * Gives up the worker's slot if more than min_workers are live. The last look at the
+ * inbox happens after the slot stopped being RUNNING, so a task already there keeps the
+ * worker alive. A submitter may still have picked this slot earlier and push after that
+ * look; such a task waits in the dead slot's inbox until a peer drains it.
+ * Returns 1 if the worker should exit.
+ */
+static int try_retire(executor* ex, executor_worker* self) {
+    int live = atomic_load(&ex->live);
+    do {
+        if (live <= ex->min_workers) {
+            return 0;
+        }
+    } while (!atomic_compare_exchange_weak(&ex->live, &live, live - 1));
+
+    atomic_store(&self->state, EXECUTOR_SLOT_RETIRING);
+    if (refill(self, &self->inbox)) {
+        atomic_fetch_add(&ex->live, 1);
+        atomic_store(&self->state, EXECUTOR_SLOT_RUNNING);
+        return 0;
+    }
+    atomic_store(&self->state, EXECUTOR_SLOT_FREE);
+    return 1;
+}
+
+static void* worker_main(void* arg) {
+    executor_worker* self = (executor_worker*)arg;
+    executor* ex = self->owner;
+    current_worker = self;
+
+    // the slot must not become FREE, and be reused, before start_worker has filled it in
+    wait_state started_ws = WAIT_STATE_INIT;
+    while (!atomic_load_explicit(&self->started, ORDER_ACQUIRE)) {
+        wait_pause(&ex->policy, &started_ws, NULL, 0, NULL);
+    }
+
+    while (1) {
+        int seq = atomic_load_explicit(&ex->work_seq, ORDER_ACQUIRE);
+        executor_task* task = find_task(ex, self);
+        if (task != NULL) {
+            run_task(ex, task);
+            continue;
+        }
+        if (atomic_load_explicit(&ex->stop, ORDER_ACQUIRE)) {
+            return NULL;
+        }
+
+        wait_state ws = WAIT_STATE_INIT;
+        int timed_out = 0;
+        while (atomic_load_explicit(&ex->work_seq, ORDER_ACQUIRE) == seq && !timed_out) {
+            if (ex->max_workers == ex->min_workers) {
+                wait_pause(&ex->policy, &ws, &ex->work_seq, seq, &ex->work_parked);
+            } else {
+                timed_out = wait_pause_timed(&ex->policy, &ws, &ex->work_seq, seq,
+                                             &ex->work_parked, ex->idle_ms) != 0;
+            }
+        }
+        if (timed_out && try_retire(ex, self)) {
+            return NULL;
+        }
+    }
+}
+
+/*
+ * Starts a thread on a slot the caller has just claimed, joining the slot's previous thread.
+ * The new thread waits for 'started' so that it cannot retire the slot before 'tid' and
+ * 'has_thread' are written; whoever claims the slot next reads them.
+ */
+static void start_worker(executor_worker* w) {
+    if (w->has_thread) {
+        pthread_join(w->tid, NULL);
+    }
+    atomic_store_explicit(&w->started, 0, ORDER_RELAXED);
+    if (pthread_create(&w->tid, NULL, worker_main, w) != 0) {
+        fprintf(stderr, "Error creating executor worker\n");
+        exit(1);
+    }
+    w->has_thread = 1;
+    atomic_store_explicit(&w->started, 1, ORDER_RELEASE);
+}
+
+// Elastic mode: start one more worker while unfinished tasks outnumber the workers
+static void maybe_grow(executor* ex) {
+    int live = atomic_load(&ex->live);
+    if (live >= ex->max_workers || atomic_load(&ex->pending) <= live || !atomic_compare_exchange_strong(&ex->live, &live, live + 1)) {
+        return;
+    }
+    for (int i = 0; i < ex->max_workers; i++) {
+        int expected = EXECUTOR_SLOT_FREE;
+        if (atomic_compare_exchange_strong(&ex->workers[i].state, &expected, EXECUTOR_SLOT_RUNNING)) {
+            start_worker(&ex->workers[i]);
+            return;
+        }
+    }
+    atomic_fetch_sub(&ex->live, 1); // every slot is still retiring
+}
+
+int executor_init(executor* ex, int min_workers, int max_workers) {
+    if (min_workers <= 0 || max_workers < min_workers) {
+        return -1;
+    }
+    ex->workers = aligned_alloc(WS_DEQUE_CACHE_LINE, sizeof(executor_worker) * max_workers);
+    if (ex->workers == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < max_workers; i++) {
+        executor_worker* w = &ex->workers[i];
+        if (ws_deque_init(&w->deque, EXECUTOR_DEQUE_CAPACITY) != 0) {
+            for (int j = 0; j < i; j++) {
+                ws_deque_destroy(&ex->workers[j].deque);
+            }
+            free(ex->workers);
+            return -1;
+        }
+        ws_inbox_init(&w->inbox);
+        atomic_init(&w->state, i < min_workers ? EXECUTOR_SLOT_RUNNING : EXECUTOR_SLOT_FREE);
+        w->has_thread = 0;
+        atomic_init(&w->started, 0);
+        w->owner = ex;
+    }
+
+    ex->min_workers = min_workers;
+    ex->max_workers = max_workers;
+    ex->idle_ms = EXECUTOR_IDLE_MS;
+    wait_policy_default(&ex->policy);
+    atomic_init(&ex->work_seq, 0);
+    atomic_init(&ex->work_parked, 0);
+    atomic_init(&ex->live, min_workers);
+    atomic_init(&ex->next_worker, 0);
+    atomic_init(&ex->stop, 0);
+    atomic_init(&ex->pending, 0);
+    atomic_init(&ex->pending_parked, 0);
+
+    for (int i = 0; i < min_workers; i++) {
+        start_worker(&ex->workers[i]);
+    }
+    return 0;
+}
+
+void executor_destroy(executor* ex) {
+    executor_wait_all(ex);
+    atomic_store_explicit(&ex->stop, 1, ORDER_RELEASE);
+    atomic_fetch_add_explicit(&ex->work_seq, 1, ORDER_RELEASE);
+    wait_wake(&ex->policy, &ex->work_seq, &ex->work_parked, INT_MAX);
+    for (int i = 0; i < ex->max_workers; i++) {
+        if (ex->workers[i].has_thread) {
+            pthread_join(ex->workers[i].tid, NULL);
+        }
+        ws_deque_destroy(&ex->workers[i].deque);
+    }
+    free(ex->workers);
+    ex->workers = NULL;
+}
+
+// Round-robin over the running workers
+static executor_worker* pick_worker(executor* ex) {
+    int start = atomic_fetch_add_explicit(&ex->next_worker, 1, memory_order_relaxed);
+    for (int i = 0; i < ex->max_workers; i++) {
+        executor_worker* w = &ex->workers[(unsigned int)(start + i) % ex->max_workers];
+        if (atomic_load(&w->state) == EXECUTOR_SLOT_RUNNING) {
+            return w;
+        }
+    }
+    return &ex->workers[0];
+}
+
+/*
+ * executor_submit
+ *
+ * A worker pushes to its own deque without touching shared lines, anybody else goes
+ * through a worker's inbox. One parked worker is woken either way so the task can be
+ * stolen if the chosen worker is busy.
+ */
+executor_future* executor_submit(executor* ex, executor_fn fn, void* arg) {
+    executor_task* task = malloc(sizeof(executor_task));
+    if (task == NULL) {
+        fprintf(stderr, "Failed to allocate memory for a task\n");
+        exit(1);
+    }
+    task->fn = fn;
+    task->arg = arg;
+    atomic_init(&task->future.done, 0);
+    atomic_init(&task->future.parked, 0);
+    atomic_init(&task->future.refs, 2);
+    task->future.result = NULL;
+    task->future.policy = ex->policy;
+
+    atomic_fetch_add_explicit(&ex->pending, 1, ORDER_RELAXED);
+    if (current_worker != NULL && current_worker->owner == ex) {
+        if (ws_deque_push(&current_worker->deque, (intptr_t)task) != 0) {
+            fprintf(stderr, "Failed to grow worker deque\n");
+            exit(1);
+        }
+    } else {
+        ws_inbox_push(&pick_worker(ex)->inbox, &task->link);
+    }
+
+    atomic_fetch_add_explicit(&ex->work_seq, 1, ORDER_RELEASE);
+    wait_wake(&ex->policy, &ex->work_seq, &ex->work_parked, 1);
+    if (ex->max_workers > ex->min_workers) {
+        maybe_grow(ex);
+    }
+    return &task->future;
+}
+
+void executor_wait_all(executor* ex) {
+    wait_state ws = WAIT_STATE_INIT;
+    int pending;
+    while ((pending = atomic_load_explicit(&ex->pending, ORDER_ACQUIRE)) != 0) {
+        wait_pause(&ex->policy, &ws, &ex->pending, pending, &ex->pending_parked);
+    }
+}
+
+void* executor_future_wait(executor_future* future) {
+    wait_state ws = WAIT_STATE_INIT;
+    while (!atomic_load_explicit(&future->done, ORDER_ACQUIRE)) {
+        wait_pause(&future->policy, &ws, &future->done, 0, &future->parked);
+    }
+    return future->result;
+}
+
+int executor_future_ready(executor_future* future) {
+    return atomic_load_explicit(&future->done, ORDER_ACQUIRE);
+}
+
+void executor_future_release(executor_future* future) {
+    task_release(task_of(future));
+}
@@ -0,0 +1,122 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "ws_deque.h"
+#include "../common/wait_policy.h"
+
+#define EXECUTOR_IDLE_MS 100   // default idle time after which an elastic worker above the minimum exits
+
+/*
+ * Task function run by a worker; its return value is the future's result.
+ */
+typedef void* (*executor_fn)(void* arg);
+
+/*
+ * Result of one submitted task. Owned jointly by the submitter and the worker; the
+ * submitter gives up its share with executor_future_release.
+ */
+typedef struct {
+    atomic_int done;
+    atomic_int parked;
+    atomic_int refs;
+    void* result;
+    wait_policy policy;
+} executor_future;
+
+/*
+ * A task and its future in one allocation. 'link' must stay the first member.
+ */
+typedef struct {
+    ws_inbox_node link;
+    executor_fn fn;
+    void* arg;
+    executor_future future;
+} executor_task;
+
+/*
+ * Life cycle of a worker slot.
+ */
+enum { EXECUTOR_SLOT_FREE, EXECUTOR_SLOT_RUNNING, EXECUTOR_SLOT_RETIRING };
+
+/*
+ * One worker: its deque, which only it pushes to, and its inbox, which other threads
+ * submit to. Slots outlive their threads, so an elastic executor reuses them.
+ */
+typedef struct executor_worker {
+    ws_deque deque;
+    ws_inbox inbox;
+    _Alignas(WS_DEQUE_CACHE_LINE) atomic_int state;
+    int has_thread;             // 'tid' still has to be joined
+    pthread_t tid;
+    atomic_int started;         // set once 'tid' and 'has_thread' are filled in
+    struct executor* owner;
+} executor_worker;
+
+/*
+ * Define the executor type.
+ *
+ * A long-lived pool of between 'min_workers' and 'max_workers' threads. Submitters hand
+ * tasks to the workers' inboxes round-robin, or to their own deque when they are workers of
+ * the same executor. A worker runs its own deque first, refills it from its inbox, then
+ * steals from the others, and parks on 'work_seq' when there is nothing to do.
+ *
+ * With max_workers > min_workers the pool is elastic: a submission that leaves more
+ * unfinished tasks than workers starts another one, and a worker idle for 'idle_ms' exits
+ * while more than min_workers remain. A leaving worker's inbox is picked up by the others.
+ */
+typedef struct executor {
+    int min_workers;
+    int max_workers;
+    long idle_ms;
+    executor_worker* workers;
+    wait_policy policy;
+    _Alignas(WS_DEQUE_CACHE_LINE) atomic_int work_seq;  // bumped on every submission
+    atomic_int work_parked;
+    atomic_int live;            // workers running or starting
+    atomic_int next_worker;     // round-robin submission target
+    atomic_int stop;
+    _Alignas(WS_DEQUE_CACHE_LINE) atomic_int pending;   // submitted tasks not yet finished
+    atomic_int pending_parked;
+} executor;
+
+/*
+ * Initializes the executor and starts 'min_workers' threads. 'max_workers' == min_workers
+ * gives a fixed pool. Returns 0 on success, -1 on bad arguments or if memory could not be
+ * allocated.
+ */
+int executor_init(executor* ex, int min_workers, int max_workers);
+
+/*
+ * Waits for every submitted task, stops the workers and frees the executor's memory.
+ * Futures not yet released stay valid until they are.
+ */
+void executor_destroy(executor* ex);
+
+/*
+ * Submits fn(arg) and returns its future. Safe to call from any thread, including workers.
+ */
+executor_future* executor_submit(executor* ex, executor_fn fn, void* arg);
+
+/*
+ * Blocks until every task submitted so far has finished. Must not be called from a worker.
+ */
+void executor_wait_all(executor* ex);
+
+/*
+ * Blocks until the task has finished and returns its result.
+ */
+void* executor_future_wait(executor_future* future);
+
+/*
+ * Returns 1 if the task has finished, 0 otherwise.
+ */
+int executor_future_ready(executor_future* future);
+
+/*
+ * Gives up the submitter's reference. The future must not be used afterwards.
+ */
+void executor_future_release(executor_future* future);
+
+#endif // EXECUTOR_H
@@ -0,0 +1,94 @@
+/*
+ * flat_combining.c
+ *
+ * Implementation of the flat-combining executor (Hendler, Incze, Shavit, Tzafrir).
+ *
+ * Waiting threads watch their own slot and retry the lock between pauses. They never
+ * park: a request published just after the combiner's last scan is only served once its
+ * owner takes the lock itself, so the owner has to stay runnable to do that.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "flat_combining.h"
+#include <stdlib.h>
+#include <string.h>
+
+int fc_init(fc_executor* fc, int nslots, fc_apply_fn apply, void* state) {
+    fc->slots = aligned_alloc(FC_CACHE_LINE, sizeof(fc_slot) * nslots);
+    if (fc->slots == NULL) {
+        return -1;
+    }
+    memset(fc->slots, 0, sizeof(fc_slot) * nslots);
+    for (int i = 0; i < nslots; i++) {
+        atomic_init(&fc->slots[i].pending, 0);
+    }
+    atomic_init(&fc->lock, 0);
+    fc->nslots = nslots;
+    fc->apply = apply;
+    fc->state = state;
+    wait_policy_default(&fc->policy);
+    fc->sessions = 0;
+    fc->combined = 0;
+    return 0;
+}
+
+void fc_destroy(fc_executor* fc) {
+    free(fc->slots);
+    fc->slots = NULL;
+}
+
+/*
+ * combine
+ *
+ * Scans the slots until a pass finds nothing to do, or FC_MAX_PASSES passes were made
+ * so one combiner is not stuck serving everybody forever. Called with fc->lock held.
+ */
+static void combine(fc_executor* fc) {
+    for (int pass = 0; pass < FC_MAX_PASSES; pass++) {
+        int served = 0;
+        for (int i = 0; i < fc->nslots; i++) {
+            fc_slot* s = &fc->slots[i];
+            if (atomic_load_explicit(&s->pending, memory_order_acquire)) {
+                s->result = fc->apply(fc->state, s->op, s->arg);
+                atomic_store_explicit(&s->pending, 0, memory_order_release);
+                served++;
+            }
+        }
+        fc->combined += served;
+        if (served == 0) {
+            break;
+        }
+    }
+    fc->sessions++;
+}
+
+/*
+ * fc_execute
+ *
+ * Publishes the request, then alternates between checking whether a combiner served it
+ * and trying to become the combiner. The combiner's own request is in its slot too, so
+ * it is served by the same scan.
+ */
+intptr_t fc_execute(fc_executor* fc, int slot, int op, intptr_t arg) {
+    fc_slot* s = &fc->slots[slot];
+    s->op = op;
+    s->arg = arg;
+    atomic_store_explicit(&s->pending, 1, memory_order_release);
+
+    wait_state ws = WAIT_STATE_INIT;
+    while (1) {
+        if (!atomic_load_explicit(&s->pending, memory_order_acquire)) {
+            return s->result;
+        }
+        int expected = 0;
+        if (atomic_load_explicit(&fc->lock, memory_order_relaxed) == 0 &&
+            atomic_compare_exchange_strong_explicit(&fc->lock, &expected, 1, memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            combine(fc);
+            atomic_store_explicit(&fc->lock, 0, memory_order_release);
+            continue; // our request was pending during the scan, so it has been served
+        }
+        wait_pause(&fc->policy, &ws, NULL, 0, NULL);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef FLAT_COMBINING_H
+#define FLAT_COMBINING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "../common/wait_policy.h"
+
+#define FC_CACHE_LINE 64
+#define FC_MAX_PASSES 4   // scans of the slot array per combining session
+
+/*
+ * Operation applied by the combiner to the protected structure. 'state' is the pointer
+ * given to fc_init, 'op' and 'arg' come from the request, the return value is handed
+ * back to the requesting thread.
+ */
+typedef intptr_t (*fc_apply_fn)(void* state, int op, intptr_t arg);
+
+/*
+ * One publication slot per participating thread, each on its own cache line.
+ * 'pending' is set by the owner after filling op/arg and cleared by the combiner after
+ * writing 'result'.
+ */
+typedef struct {
+    _Alignas(FC_CACHE_LINE) atomic_int pending;
+    int op;
+    intptr_t arg;
+    intptr_t result;
+} fc_slot;
+
+/*
+ * Define the flat-combining executor type.
+ * Instead of every thread taking the lock to run its own short critical section, threads
+ * publish requests in their slot. Whichever thread gets the lock becomes the combiner and
+ * applies every pending request in one pass, so the structure's cache lines stay with one
+ * core and the lock changes hands once per batch instead of once per operation.
+ */
+typedef struct {
+    _Alignas(FC_CACHE_LINE) atomic_int lock;
+    int nslots;
+    fc_slot* slots;
+    fc_apply_fn apply;
+    void* state;
+    wait_policy policy;
+    long sessions;   // combining sessions so far (written by the combiner only)
+    long combined;   // requests applied so far (written by the combiner only)
+} fc_executor;
+
+/*
+ * Initializes the executor for threads using slot ids in [0, nslots).
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int fc_init(fc_executor* fc, int nslots, fc_apply_fn apply, void* state);
+
+/*
+ * Frees the slots. No thread may be inside fc_execute.
+ */
+void fc_destroy(fc_executor* fc);
+
+/*
+ * Runs apply(state, op, arg) under the executor's mutual exclusion and returns its result.
+ * 'slot' identifies the caller and must not be used by two threads at the same time.
+ */
+intptr_t fc_execute(fc_executor* fc, int slot, int op, intptr_t arg);
+
+#endif // FLAT_COMBINING_H
@@ -0,0 +1,249 @@
+/*
+ * pipeline.c
+ *
+ * Implementation of the multi-stage pipeline and its batch queue.
+ *
+ * Wakeups are passed on rather than broadcast: a push signals one consumer, and a consumer
+ * that leaves items behind signals the next one, the same way blocked producers are
+ * released in cp_pattern. Only closing a queue wakes everybody.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "pipeline.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int batch_queue_init(batch_queue* q, int capacity, int writers) {
+    q->ring = malloc(sizeof(intptr_t) * capacity);
+    if (q->ring == NULL) {
+        return -1;
+    }
+    ticketlock_init(&q->lock);
+    condition_variable_init(&q->not_empty);
+    condition_variable_init(&q->not_full);
+    q->capacity = capacity;
+    q->head = 0;
+    q->size = 0;
+    q->writers = writers;
+    return 0;
+}
+
+void batch_queue_destroy(batch_queue* q) {
+    free(q->ring);
+    q->ring = NULL;
+}
+
+/*
+ * batch_queue_push
+ *
+ * Copies as much as fits in one go, with at most two memcpy calls for the wrap-around.
+ * A batch larger than the free space is pushed in parts as consumers make room.
+ */
+void batch_queue_push(batch_queue* q, const intptr_t* items, int count) {
+    ticketlock_acquire(&q->lock);
+    while (count > 0) {
+        while (q->size == q->capacity) {
+            condition_variable_wait(&q->not_full, &q->lock);
+        }
+        int n = q->capacity - q->size < count ? q->capacity - q->size : count;
+        int tail = (q->head + q->size) % q->capacity;
+        int first = q->capacity - tail < n ? q->capacity - tail : n;
+        memcpy(&q->ring[tail], items, sizeof(intptr_t) * first);
+        memcpy(q->ring, items + first, sizeof(intptr_t) * (n - first));
+        q->size += n;
+        items += n;
+        count -= n;
+        condition_variable_signal(&q->not_empty);
+    }
+    if (q->size < q->capacity) {
+        condition_variable_signal(&q->not_full); // pass the wakeup on to the next producer
+    }
+    ticketlock_release(&q->lock);
+}
+
+int batch_queue_pop(batch_queue* q, intptr_t* out, int max) {
+    ticketlock_acquire(&q->lock);
+    while (q->size == 0 && q->writers > 0) {
+        condition_variable_wait(&q->not_empty, &q->lock);
+    }
+    int n = q->size < max ? q->size : max;
+    int first = q->capacity - q->head < n ? q->capacity - q->head : n;
+    memcpy(out, &q->ring[q->head], sizeof(intptr_t) * first);
+    memcpy(out + first, q->ring, sizeof(intptr_t) * (n - first));
+    q->head = (q->head + n) % q->capacity;
+    q->size -= n;
+    if (n > 0) {
+        condition_variable_signal(&q->not_full);
+    }
+    if (q->size > 0) {
+        condition_variable_signal(&q->not_empty); // pass the wakeup on to the next consumer
+    }
+    ticketlock_release(&q->lock);
+    return n;
+}
+
+void batch_queue_close(batch_queue* q) {
+    ticketlock_acquire(&q->lock);
+    if (--q->writers == 0) {
+        condition_variable_broadcast(&q->not_empty);
+    }
+    ticketlock_release(&q->lock);
+}
+
+void pipeline_init(pipeline* p, int queue_capacity) {
+    p->nstages = 0;
+    p->queue_capacity = queue_capacity;
+    p->start = 0;
+    p->elapsed = 0;
+}
+
+int pipeline_add_stage(pipeline* p, const char* name, pipeline_stage_fn fn, void* ctx,
+                       int threads, int batch) {
+    if (p->nstages == PIPELINE_MAX_STAGES || fn == NULL || threads <= 0 || batch <= 0) {
+        return -1;
+    }
+    pipeline_stage* s = &p->stages[p->nstages++];
+    s->name = name;
+    s->fn = fn;
+    s->ctx = ctx;
+    s->threads = threads;
+    s->batch = batch;
+    s->in = NULL;
+    s->out = NULL;
+    s->tids = NULL;
+    return 0;
+}
+
+/*
+ * stage_worker
+ *
+ * Pops a batch, runs the stage function on it and pushes the results downstream as one
+ * batch. The source has no input and stops on PIPELINE_END, every other stage stops once
+ * its input is closed and drained. Either way the worker then closes its output.
+ */
+static void* stage_worker(void* arg) {
+    pipeline_stage* s = (pipeline_stage*)arg;
+    intptr_t* in = s->in != NULL ? malloc(sizeof(intptr_t) * s->batch) : NULL;
+    intptr_t* out = malloc(sizeof(intptr_t) * s->batch);
+    if ((s->in != NULL && in == NULL) || out == NULL) {
+        fprintf(stderr, "Failed to allocate memory for stage '%s' buffers\n", s->name);
+        exit(1);
+    }
+
+    double busy = 0;
+    while (1) {
+        int count = 0;
+        if (s->in != NULL && (count = batch_queue_pop(s->in, in, s->batch)) == 0) {
+            break;
+        }
+
+        double t0 = now_sec();
+        int produced = s->fn(s->ctx, in, count, out, s->batch);
+        busy += now_sec() - t0;
+
+        if (s->in == NULL && produced == PIPELINE_END) {
+            break;
+        }
+        if (produced < 0 || produced > s->batch) {
+            fprintf(stderr, "Stage '%s' returned %d items for a batch of %d\n", s->name, produced, s->batch);
+            exit(1);
+        }
+        sharded_counter_add(&s->items_in, count);
+        sharded_counter_add(&s->items_out, produced);
+        atomic_fetch_add_explicit(&s->batches, 1, memory_order_relaxed);
+        if (s->out != NULL && produced > 0) {
+            batch_queue_push(s->out, out, produced);
+        }
+    }
+
+    if (s->out != NULL) {
+        batch_queue_close(s->out);
+    }
+    ticketlock_acquire(&s->stats_lock);
+    s->busy_sec += busy;
+    ticketlock_release(&s->stats_lock);
+    free(in);
+    free(out);
+    return NULL;
+}
+
+int pipeline_start(pipeline* p) {
+    if (p->nstages == 0) {
+        return -1;
+    }
+    for (int i = 0; i < p->nstages; i++) {
+        pipeline_stage* s = &p->stages[i];
+        if (i + 1 < p->nstages) {
+            if (batch_queue_init(&p->queues[i], p->queue_capacity, s->threads) != 0) {
+                return -1;
+            }
+            s->out = &p->queues[i];
+        }
+        s->in = i > 0 ? &p->queues[i - 1] : NULL;
+        s->tids = malloc(sizeof(pthread_t) * s->threads);
+        if (s->tids == NULL || sharded_counter_init(&s->items_in, 0) != 0 ||
+            sharded_counter_init(&s->items_out, 0) != 0) {
+            return -1;
+        }
+        atomic_init(&s->batches, 0);
+        s->busy_sec = 0;
+        ticketlock_init(&s->stats_lock);
+    }
+
+    p->start = now_sec();
+    for (int i = 0; i < p->nstages; i++) {
+        pipeline_stage* s = &p->stages[i];
+        for (int t = 0; t < s->threads; t++) {
+            if (pthread_create(&s->tids[t], NULL, stage_worker, s) != 0) {
+                fprintf(stderr, "Error creating thread %d of stage '%s'\n", t, s->name);
+                exit(1);
+            }
+        }
+    }
+    return 0;
+}
+
+void pipeline_wait(pipeline* p) {
+    for (int i = 0; i < p->nstages; i++) {
+        for (int t = 0; t < p->stages[i].threads; t++) {
+            pthread_join(p->stages[i].tids[t], NULL);
+        }
+    }
+    p->elapsed = now_sec() - p->start;
+}
+
+void pipeline_print_stats(pipeline* p, FILE* out) {
+    fprintf(out, "stage,threads,batch,items_in,items_out,batches,items_per_sec,busy_pct\n");
+    for (int i = 0; i < p->nstages; i++) {
+        pipeline_stage* s = &p->stages[i];
+        long items_in = sharded_counter_read(&s->items_in);
+        long items_out = sharded_counter_read(&s->items_out);
+        long items = i == 0 ? items_out : items_in;   // the source has no input
+        double wall = p->elapsed > 0 ? p->elapsed : 1e-9;
+        fprintf(out, "%s,%d,%d,%ld,%ld,%ld,%.0f,%.1f\n", s->name, s->threads, s->batch,
+                items_in, items_out, atomic_load_explicit(&s->batches, memory_order_relaxed),
+                items / wall, 100.0 * s->busy_sec / (s->threads * wall));
+    }
+}
+
+void pipeline_destroy(pipeline* p) {
+    for (int i = 0; i < p->nstages; i++) {
+        pipeline_stage* s = &p->stages[i];
+        if (s->out != NULL) {
+            batch_queue_destroy(s->out);
+        }
+        sharded_counter_destroy(&s->items_in);
+        sharded_counter_destroy(&s->items_out);
+        free(s->tids);
+        s->tids = NULL;
+    }
+    p->nstages = 0;
+}
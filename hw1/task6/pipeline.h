@@ -0,0 +1,138 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../task3/cond_var.h"
+#include "../common/sharded_counter.h"
+
+#define PIPELINE_MAX_STAGES 16
+#define PIPELINE_END -1   // returned by a source stage whose worker has nothing left to produce
+
+/*
+ * Define the bounded batch queue that links two stages.
+ * A ring of items guarded by a ticket lock, like cp_pattern's bounded mode, except that
+ * push and pop move whole batches under one lock acquisition. The queue is closed once
+ * every upstream worker has finished; consumers then drain it and stop.
+ */
+typedef struct {
+    ticket_lock lock;
+    condition_variable not_empty;
+    condition_variable not_full;
+    intptr_t* ring;
+    int capacity;
+    int head;
+    int size;
+    int writers;       // upstream workers still running
+} batch_queue;
+
+/*
+ * Work done by one stage on a batch.
+ *
+ * The first stage of a pipeline is its source: it is called with in == NULL and count == 0,
+ * fills up to 'out_cap' items and returns how many, or PIPELINE_END when the calling worker
+ * should stop. Every other stage gets 'count' items from the previous stage and returns the
+ * number of items it wrote to 'out' (at most 'out_cap'; fewer filters, zero aggregates).
+ * Items of the last stage are only counted. Runs concurrently on all threads of the stage.
+ */
+typedef int (*pipeline_stage_fn)(void* ctx, const intptr_t* in, int count, intptr_t* out, int out_cap);
+
+/*
+ * One stage: a function, its own pool of threads and its throughput counters.
+ */
+typedef struct {
+    const char* name;
+    pipeline_stage_fn fn;
+    void* ctx;
+    int threads;
+    int batch;                  // items per handoff in both directions
+    batch_queue* in;            // NULL for the source
+    batch_queue* out;           // NULL for the last stage
+    pthread_t* tids;
+    sharded_counter items_in;
+    sharded_counter items_out;
+    atomic_long batches;
+    double busy_sec;            // summed over the stage's threads
+    ticket_lock stats_lock;
+} pipeline_stage;
+
+/*
+ * Define the pipeline type: stages in order, linked by one batch queue each.
+ */
+typedef struct {
+    int nstages;
+    int queue_capacity;
+    pipeline_stage stages[PIPELINE_MAX_STAGES];
+    batch_queue queues[PIPELINE_MAX_STAGES - 1];
+    double start;
+    double elapsed;             // wall time of the last run, set by pipeline_wait
+} pipeline;
+
+/*
+ * Initializes a batch queue holding up to 'capacity' items that 'writers' upstream threads
+ * will close. Returns 0 on success, -1 if memory could not be allocated.
+ */
+int batch_queue_init(batch_queue* q, int capacity, int writers);
+
+/*
+ * Frees the ring. No thread may be using the queue.
+ */
+void batch_queue_destroy(batch_queue* q);
+
+/*
+ * Appends all 'count' items, blocking while the queue is full.
+ */
+void batch_queue_push(batch_queue* q, const intptr_t* items, int count);
+
+/*
+ * Removes up to 'max' items into 'out', blocking while the queue is empty and open.
+ * Returns the number of items, 0 once the queue is closed and drained.
+ */
+int batch_queue_pop(batch_queue* q, intptr_t* out, int max);
+
+/*
+ * Called by each upstream thread when it is done. The last one wakes every consumer.
+ */
+void batch_queue_close(batch_queue* q);
+
+/*
+ * Initializes an empty pipeline whose queues hold up to 'queue_capacity' items each.
+ */
+void pipeline_init(pipeline* p, int queue_capacity);
+
+/*
+ * Appends a stage run by 'threads' threads handing over 'batch' items at a time.
+ * 'name' must outlive the pipeline. Returns 0 on success, -1 on bad arguments or if
+ * PIPELINE_MAX_STAGES stages already exist.
+ */
+int pipeline_add_stage(pipeline* p, const char* name, pipeline_stage_fn fn, void* ctx,
+                       int threads, int batch);
+
+/*
+ * Creates the queues and every stage's threads. Needs at least one stage.
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int pipeline_start(pipeline* p);
+
+/*
+ * Waits until the source is exhausted and every stage has drained its input.
+ */
+void pipeline_wait(pipeline* p);
+
+/*
+ * Prints one CSV line per stage to 'out' (header included):
+ *   stage,threads,batch,items_in,items_out,batches,items_per_sec,busy_pct
+ * items_per_sec is the items a stage took in (produced, for the source) over the
+ * pipeline's wall time, busy_pct the share of the stage threads' time spent inside the
+ * stage function.
+ */
+void pipeline_print_stats(pipeline* p, FILE* out);
+
+/*
+ * Frees the queues and counters. The pipeline must have been waited for.
+ */
+void pipeline_destroy(pipeline* p);
+
+#endif // PIPELINE_H
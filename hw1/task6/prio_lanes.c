@@ -0,0 +1,204 @@
+/*
+ * prio_lanes.c
+ *
+ * Implementation of the multi-lane priority queue.
+ *
+ * Each lane is D. Vyukov's bounded MPMC queue: slot i starts with seq = i. A producer may
+ * fill position p when its slot's seq is p and publishes it with seq = p + 1; a consumer
+ * may drain p when seq is p + 1 and hands the slot back to the next round with
+ * seq = p + capacity. The seq store is the release and its load the acquire, which
+ * orders the payload; the head and tail counters themselves only need relaxed CASes.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "prio_lanes.h"
+#include <stdlib.h>
+
+static int lane_init(prio_lane* lane, long capacity) {
+    size_t size = 1;
+    while (size < (size_t)capacity) {
+        size <<= 1;
+    }
+    lane->cells = malloc(sizeof(prio_cell) * size);
+    if (lane->cells == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&lane->cells[i].seq, i);
+    }
+    lane->mask = size - 1;
+    atomic_init(&lane->tail, 0);
+    atomic_init(&lane->head, 0);
+    return 0;
+}
+
+int prio_queue_init(prio_queue* q, int lanes, long capacity, int quota) {
+    if (lanes < 1 || lanes > PRIO_MAX_LANES || capacity < 1 || quota < 1) {
+        return -1;
+    }
+    q->lanes = lanes;
+    q->quota = quota;
+    for (int i = 0; i < lanes; i++) {
+        if (lane_init(&q->lane[i], capacity) != 0) {
+            q->lanes = i;
+            prio_queue_destroy(q);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void prio_queue_destroy(prio_queue* q) {
+    for (int i = 0; i < q->lanes; i++) {
+        free(q->lane[i].cells);
+    }
+    q->lanes = 0;
+}
+
+/*
+ * prio_queue_push
+ *
+ * A slot whose seq is behind the position still holds an item from the previous round:
+ * the lane is full. One that is ahead was claimed by another producer, so reload the tail.
+ */
+int prio_queue_push(prio_queue* q, int lane, int value, long now_ns) {
+    prio_lane* l = &q->lane[lane];
+    size_t pos = atomic_load_explicit(&l->tail, memory_order_relaxed);
+    prio_cell* cell;
+    while (1) {
+        cell = &l->cells[pos & l->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        long diff = (long)(seq - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&l->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&l->tail, memory_order_relaxed);
+        }
+    }
+    cell->value = value;
+    cell->enqueued_ns = now_ns;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+// Takes the oldest item of one lane, 0 if it is empty
+static int lane_pop(prio_lane* l, int* value, long* enqueued_ns) {
+    size_t pos = atomic_load_explicit(&l->head, memory_order_relaxed);
+    prio_cell* cell;
+    while (1) {
+        cell = &l->cells[pos & l->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        long diff = (long)(seq - (pos + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&l->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&l->head, memory_order_relaxed);
+        }
+    }
+    *value = cell->value;
+    *enqueued_ns = cell->enqueued_ns;
+    atomic_store_explicit(&cell->seq, pos + l->mask + 1, memory_order_release);
+    return 1;
+}
+
+void prio_cursor_init(prio_cursor* cursor) {
+    cursor->since_quota = 0;
+    cursor->next_low = 1;
+}
+
+/*
+ * prio_queue_pop
+ *
+ * Strict priority, except that every quota-th pop first tries the lower lanes, starting
+ * with the one after the lane served by the last such turn. An empty lower lane gives its
+ * turn back to the strict order, so the quota never idles a consumer.
+ */
+int prio_queue_pop(prio_queue* q, prio_cursor* cursor, int* value, int* lane, long* enqueued_ns) {
+    if (q->lanes > 1 && ++cursor->since_quota >= q->quota) {
+        cursor->since_quota = 0;
+        for (int i = 0; i < q->lanes - 1; i++) {
+            int low = cursor->next_low;
+            cursor->next_low = low + 1 < q->lanes ? low + 1 : 1;
+            if (lane_pop(&q->lane[low], value, enqueued_ns)) {
+                *lane = low;
+                return 1;
+            }
+        }
+    }
+    for (int i = 0; i < q->lanes; i++) {
+        if (lane_pop(&q->lane[i], value, enqueued_ns)) {
+            *lane = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+long prio_queue_size(prio_queue* q) {
+    long size = 0;
+    for (int i = 0; i < q->lanes; i++) {
+        size_t tail = atomic_load_explicit(&q->lane[i].tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&q->lane[i].head, memory_order_relaxed);
+        size += tail > head ? (long)(tail - head) : 0;
+    }
+    return size;
+}
+
+// Buckets 0-15 are exact, then 16 steps per power of two
+static int hist_bucket(long ns) {
+    if (ns < 16) {
+        return ns < 0 ? 0 : (int)ns;
+    }
+    int msb = 63 - __builtin_clzl((unsigned long)ns);
+    int bucket = (msb - 3) * 16 + (int)((ns >> (msb - 4)) & 15);
+    return bucket < PRIO_HIST_BUCKETS ? bucket : PRIO_HIST_BUCKETS - 1;
+}
+
+static long bucket_floor(int bucket) {
+    if (bucket < 16) {
+        return bucket;
+    }
+    int msb = bucket / 16 + 3;
+    return (long)(16 + bucket % 16) << (msb - 4);
+}
+
+void prio_hist_record(prio_hist* h, long ns) {
+    h->buckets[hist_bucket(ns)]++;
+    h->count++;
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+}
+
+void prio_hist_merge(prio_hist* into, const prio_hist* from) {
+    for (int i = 0; i < PRIO_HIST_BUCKETS; i++) {
+        into->buckets[i] += from->buckets[i];
+    }
+    into->count += from->count;
+    if (from->max_ns > into->max_ns) {
+        into->max_ns = from->max_ns;
+    }
+}
+
+long prio_hist_percentile(const prio_hist* h, double pct) {
+    long rank = (long)(h->count * pct / 100.0);
+    long seen = 0;
+    for (int i = 0; i < PRIO_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            return bucket_floor(i);
+        }
+    }
+    return h->max_ns;
+}
@@ -0,0 +1,99 @@
+#ifndef PRIO_LANES_H
+#define PRIO_LANES_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define PRIO_MAX_LANES 16
+#define PRIO_CACHE_LINE 64
+#define PRIO_HIST_BUCKETS 512   // 16 linear steps per power of two, up to ~17 s in ns
+
+/*
+ * One slot of a lane. 'seq' tells producers and consumers whose turn the slot is.
+ */
+typedef struct {
+    atomic_size_t seq;
+    int value;
+    long enqueued_ns;
+} prio_cell;
+
+/*
+ * A bounded lock-free multi-producer multi-consumer FIFO (Vyukov's array queue). Producers
+ * and consumers each claim a position with one CAS on their own end, so a lane has no lock
+ * and the two ends do not share a cache line.
+ */
+typedef struct {
+    size_t mask;                // capacity - 1, capacity is a power of two
+    prio_cell* cells;
+    _Alignas(PRIO_CACHE_LINE) atomic_size_t tail;   // next position to fill
+    _Alignas(PRIO_CACHE_LINE) atomic_size_t head;   // next position to drain
+} prio_lane;
+
+/*
+ * Define the priority queue type: 'lanes' FIFOs, lane 0 being the most urgent.
+ *
+ * Consumers take from the highest non-empty lane. Every 'quota'-th pop is instead offered
+ * to the lower lanes in turn, so under a steady stream of urgent items each lower lane still
+ * gets at least one pop in quota * (lanes - 1) from every consumer.
+ */
+typedef struct {
+    int lanes;
+    int quota;
+    prio_lane lane[PRIO_MAX_LANES];
+} prio_queue;
+
+/*
+ * Per-consumer position in the anti-starvation rotation.
+ */
+typedef struct {
+    int since_quota;            // pops since the last turn of a lower lane
+    int next_low;               // lower lane whose turn is next
+} prio_cursor;
+
+/*
+ * Latency histogram, one per consumer and lane, merged at the end.
+ */
+typedef struct {
+    long count;
+    long max_ns;
+    long buckets[PRIO_HIST_BUCKETS];
+} prio_hist;
+
+/*
+ * Initializes 'lanes' lanes of at least 'capacity' items each.
+ * Returns 0 on success, -1 on bad arguments or if memory could not be allocated.
+ */
+int prio_queue_init(prio_queue* q, int lanes, long capacity, int quota);
+
+/*
+ * Frees the lanes. No thread may be using the queue.
+ */
+void prio_queue_destroy(prio_queue* q);
+
+/*
+ * Appends 'value' to 'lane', stamped with 'now_ns'. Returns 0, or -1 if the lane is full.
+ */
+int prio_queue_push(prio_queue* q, int lane, int value, long now_ns);
+
+/*
+ * Takes the next item for the consumer owning 'cursor'. Returns 1 and fills the outputs,
+ * or 0 if every lane was empty.
+ */
+int prio_queue_pop(prio_queue* q, prio_cursor* cursor, int* value, int* lane, long* enqueued_ns);
+
+/*
+ * Approximate number of items in all lanes.
+ */
+long prio_queue_size(prio_queue* q);
+
+void prio_cursor_init(prio_cursor* cursor);
+
+/*
+ * Histogram operations. Percentiles are reported as the lower bound of their bucket,
+ * which is within 1/16 of the true value.
+ */
+void prio_hist_record(prio_hist* h, long ns);
+void prio_hist_merge(prio_hist* into, const prio_hist* from);
+long prio_hist_percentile(const prio_hist* h, double pct);
+
+#endif // PRIO_LANES_H
@@ -0,0 +1,194 @@
+/*
+ * ws_deque.c
+ *
+ * Implementation of the Chase-Lev work-stealing deque and a lock-free MPSC inbox.
+ *
+ * The deque follows the C11 formulation by Le, Pop, Cohen and Zappa Nardelli ("Correct and
+ * Efficient Work-Stealing for Weak Memory Models", PPoPP 2013). The orderings below are the
+ * ones proven in that paper; do not relax them further.
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "ws_deque.h"
+#include <stdlib.h>
+
+// Allocates a buffer of 'size' slots (size is a power of two)
+static ws_deque_array* array_new(long size) {
+    ws_deque_array* a = malloc(sizeof(ws_deque_array) + size * sizeof(_Atomic intptr_t));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->size = size;
+    a->prev = NULL;
+    return a;
+}
+
+// Doubles the buffer, copying the live range [top, bottom)
+static ws_deque_array* array_grow(ws_deque_array* a, long top, long bottom) {
+    ws_deque_array* bigger = array_new(a->size * 2);
+    if (bigger == NULL) {
+        return NULL;
+    }
+    for (long i = top; i < bottom; i++) {
+        intptr_t v = atomic_load_explicit(&a->buffer[i & (a->size - 1)], memory_order_relaxed);
+        atomic_store_explicit(&bigger->buffer[i & (bigger->size - 1)], v, memory_order_relaxed);
+    }
+    bigger->prev = a;
+    return bigger;
+}
+
+/*
+ * ws_deque_init
+ *
+ * Rounds the capacity up to a power of two and allocates the first buffer.
+ */
+int ws_deque_init(ws_deque* dq, long capacity) {
+    long size = 16;
+    while (size < capacity) {
+        size *= 2;
+    }
+    ws_deque_array* a = array_new(size);
+    if (a == NULL) {
+        return -1;
+    }
+    atomic_init(&dq->top, 0);
+    atomic_init(&dq->bottom, 0);
+    atomic_init(&dq->array, a);
+    return 0;
+}
+
+/*
+ * ws_deque_destroy
+ *
+ * Frees the current buffer and every older one it replaced.
+ */
+void ws_deque_destroy(ws_deque* dq) {
+    ws_deque_array* a = atomic_load_explicit(&dq->array, memory_order_relaxed);
+    while (a != NULL) {
+        ws_deque_array* prev = a->prev;
+        free(a);
+        a = prev;
+    }
+    atomic_store_explicit(&dq->array, NULL, memory_order_relaxed);
+}
+
+/*
+ * ws_deque_push
+ *
+ * Writes the slot, then publishes it by moving bottom with release ordering.
+ */
+int ws_deque_push(ws_deque* dq, intptr_t value) {
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    ws_deque_array* a = atomic_load_explicit(&dq->array, memory_order_relaxed);
+
+    if (b - t > a->size - 1) {
+        a = array_grow(a, t, b);
+        if (a == NULL) {
+            return -1;
+        }
+        atomic_store_explicit(&dq->array, a, memory_order_release);
+    }
+    atomic_store_explicit(&a->buffer[b & (a->size - 1)], value, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+/*
+ * ws_deque_pop
+ *
+ * Reserves the bottom slot first, then checks for a thief. Only when a single item
+ * is left do owner and thieves race for it through a CAS on top.
+ */
+int ws_deque_pop(ws_deque* dq, intptr_t* out) {
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    ws_deque_array* a = atomic_load_explicit(&dq->array, memory_order_relaxed);
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+    if (t > b) {
+        // deque was already empty
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return WS_DEQUE_EMPTY;
+    }
+
+    *out = atomic_load_explicit(&a->buffer[b & (a->size - 1)], memory_order_relaxed);
+    if (t == b) {
+        // last item, race the thieves for it
+        int won = atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                          memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+        return won ? WS_DEQUE_OK : WS_DEQUE_EMPTY;
+    }
+    return WS_DEQUE_OK;
+}
+
+/*
+ * ws_deque_steal
+ *
+ * Reads top, then bottom, then claims the item at top with a CAS.
+ */
+int ws_deque_steal(ws_deque* dq, intptr_t* out) {
+    long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    if (t >= b) {
+        return WS_DEQUE_EMPTY;
+    }
+
+    ws_deque_array* a = atomic_load_explicit(&dq->array, memory_order_acquire);
+    intptr_t value = atomic_load_explicit(&a->buffer[t & (a->size - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return WS_DEQUE_ABORT;
+    }
+    *out = value;
+    return WS_DEQUE_OK;
+}
+
+// Approximate size, may be stale by the time the caller looks at it
+long ws_deque_size(ws_deque* dq) {
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+    return b > t ? b - t : 0;
+}
+
+// Initializes the inbox as an empty stack
+void ws_inbox_init(ws_inbox* inbox) {
+    atomic_init(&inbox->head, NULL);
+}
+
+/*
+ * ws_inbox_push
+ *
+ * Treiber-stack push. Release ordering publishes the node contents to the owner.
+ */
+void ws_inbox_push(ws_inbox* inbox, ws_inbox_node* node) {
+    ws_inbox_node* head = atomic_load_explicit(&inbox->head, memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&inbox->head, &head, node,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+/*
+ * ws_inbox_take_all
+ *
+ * Swaps the whole stack out in one exchange and reverses it so the oldest node comes first.
+ * There is no ABA problem since nodes are only ever removed all at once.
+ */
+ws_inbox_node* ws_inbox_take_all(ws_inbox* inbox) {
+    ws_inbox_node* node = atomic_exchange_explicit(&inbox->head, NULL, memory_order_acquire);
+    ws_inbox_node* reversed = NULL;
+    while (node != NULL) {
+        ws_inbox_node* next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+    return reversed;
+}
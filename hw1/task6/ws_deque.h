@@ -0,0 +1,105 @@
+#ifndef WS_DEQUE_H
+#define WS_DEQUE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define WS_DEQUE_CACHE_LINE 64
+
+/*
+ * Return codes of ws_deque_pop and ws_deque_steal.
+ */
+#define WS_DEQUE_OK     1
+#define WS_DEQUE_EMPTY  0
+#define WS_DEQUE_ABORT -1   // lost a race with another thief or the owner, retry elsewhere
+
+/*
+ * Circular buffer backing the deque. Buffers are never freed while the deque is alive,
+ * a thief may still be reading an old one after the owner grew it.
+ */
+typedef struct ws_deque_array {
+    long size;                      // always a power of two
+    struct ws_deque_array* prev;    // older, smaller buffer kept until destroy
+    atomic_intptr_t buffer[];
+} ws_deque_array;
+
+/*
+ * Define the Chase-Lev work-stealing deque type.
+ * The owner pushes and pops at 'bottom' without any read-modify-write in the common case,
+ * thieves take from 'top' with a CAS. Both ends live on separate cache lines.
+ */
+typedef struct {
+    _Alignas(WS_DEQUE_CACHE_LINE) atomic_long top;
+    _Alignas(WS_DEQUE_CACHE_LINE) atomic_long bottom;
+    _Atomic(ws_deque_array*) array;
+} ws_deque;
+
+/*
+ * Intrusive node for ws_inbox. Embed it as the first member of the item struct.
+ */
+typedef struct ws_inbox_node {
+    struct ws_inbox_node* next;
+} ws_inbox_node;
+
+/*
+ * Define a multi-producer inbox (lock-free stack).
+ * Other threads cannot push to a Chase-Lev deque, so they hand items to the owner here
+ * and the owner moves them into its deque in one batch. A thief may drain a busy peer's
+ * inbox the same way.
+ */
+typedef struct {
+    _Atomic(ws_inbox_node*) head;
+} ws_inbox;
+
+/*
+ * Initializes the deque with room for at least 'capacity' items (it grows on demand).
+ * Returns 0 on success, -1 if memory could not be allocated.
+ */
+int ws_deque_init(ws_deque* dq, long capacity);
+
+/*
+ * Releases all buffers of the deque. No thread may be using it.
+ */
+void ws_deque_destroy(ws_deque* dq);
+
+/*
+ * Pushes a value at the bottom. Owner only.
+ * Returns 0 on success, -1 if the deque had to grow and memory could not be allocated.
+ */
+int ws_deque_push(ws_deque* dq, intptr_t value);
+
+/*
+ * Pops the most recently pushed value. Owner only.
+ * Returns WS_DEQUE_OK and stores the value in 'out', or WS_DEQUE_EMPTY.
+ */
+int ws_deque_pop(ws_deque* dq, intptr_t* out);
+
+/*
+ * Steals the oldest value. Safe to call from any thread.
+ * Returns WS_DEQUE_OK, WS_DEQUE_EMPTY or WS_DEQUE_ABORT.
+ */
+int ws_deque_steal(ws_deque* dq, intptr_t* out);
+
+/*
+ * Approximate number of items in the deque.
+ */
+long ws_deque_size(ws_deque* dq);
+
+/*
+ * Initializes an empty inbox.
+ */
+void ws_inbox_init(ws_inbox* inbox);
+
+/*
+ * Pushes a node into the inbox. Safe to call from any thread.
+ */
+void ws_inbox_push(ws_inbox* inbox, ws_inbox_node* node);
+
+/*
+ * Detaches every node currently in the inbox and returns them oldest first.
+ * Safe to call from any thread: the nodes are detached with one exchange, so each one
+ * goes to exactly one caller.
+ */
+ws_inbox_node* ws_inbox_take_all(ws_inbox* inbox);
+
+#endif // WS_DEQUE_H
@@ -0,0 +1,58 @@
+/*
+ * trace2chrome.c
+ *
+ * Converts a binary lock trace written by lock_trace_write into Chrome trace_event JSON
+ * that can be opened in chrome://tracing or Perfetto.
+ *
+ * Build: gcc -O2 trace2chrome.c ../common/lock_trace.c -o trace2chrome
+ * Usage: trace2chrome [trace.bin] [trace.json]
+ *
+ * Author: Noam Hasson, Asaf Ramati
+ */
+
+#include "../common/lock_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: trace2chrome [trace.bin] [trace.json]\n");
+        exit(1);
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        exit(1);
+    }
+
+    uint32_t header[2];
+    uint64_t count;
+    if (fread(header, sizeof(header), 1, in) != 1 || fread(&count, sizeof(count), 1, in) != 1 ||
+        header[0] != LOCK_TRACE_MAGIC || header[1] != LOCK_TRACE_VERSION) {
+        fprintf(stderr, "%s is not a lock trace (version %d)\n", argv[1], LOCK_TRACE_VERSION);
+        exit(1);
+    }
+
+    lock_trace_event* events = malloc(sizeof(lock_trace_event) * (count ? count : 1));
+    if (events == NULL) {
+        fprintf(stderr, "Failed to allocate memory for %llu events\n", (unsigned long long)count);
+        exit(1);
+    }
+    if (fread(events, sizeof(lock_trace_event), count, in) != count) {
+        fprintf(stderr, "%s is truncated\n", argv[1]);
+        exit(1);
+    }
+    fclose(in);
+
+    FILE* out = fopen(argv[2], "w");
+    if (out == NULL) {
+        perror(argv[2]);
+        exit(1);
+    }
+    lock_trace_events_to_chrome(events, (long)count, out);
+    fclose(out);
+
+    free(events);
+    return 0;
+}